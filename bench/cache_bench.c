@@ -0,0 +1,125 @@
+#include "cache.h"
+#include "hash.h"
+#include "hashtable.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SKEWED_OPS 2000000
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *op, size_t n, double start)
+{
+	printf("%-14s %-10s %8.1f ns/op\n", name, op,
+	       (now() - start) * 1e9 / n);
+}
+
+static void *key(size_t i) { return (void *)((i + 1) << 4); }
+
+/* every key resident, so the gets only measure the hit path */
+static void benchHitPath(size_t n)
+{
+	HashTable *htable = hashTableCreate(malloc, free);
+	setSeededHashMethod(htable, hashPointer);
+	setCompareMethod(htable, comparePointer);
+
+	Cache *lru = cacheCreate(malloc, free, n, CACHE_POLICY_LRU);
+	cacheSetSeededHashMethod(lru, hashPointer);
+	cacheSetCompareMethod(lru, comparePointer);
+
+	Cache *lfu = cacheCreate(malloc, free, n, CACHE_POLICY_LFU);
+	cacheSetSeededHashMethod(lfu, hashPointer);
+	cacheSetCompareMethod(lfu, comparePointer);
+
+	Cache *exact = cacheCreate(malloc, free, n, CACHE_POLICY_EXACT_LRU);
+	cacheSetSeededHashMethod(exact, hashPointer);
+	cacheSetCompareMethod(exact, comparePointer);
+
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		hashTableSet(htable, key(i), key(i));
+		cacheSet(lru, key(i), key(i));
+		cacheSet(lfu, key(i), key(i));
+		cacheSet(exact, key(i), key(i));
+	}
+
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		found += hashTableGet(htable, key(rand() % n)) != NULL;
+	}
+	report("HashTable", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += cacheGet(lru, key(rand() % n)) != NULL;
+	}
+	report("Cache LRU", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += cacheGet(lfu, key(rand() % n)) != NULL;
+	}
+	report("Cache LFU", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += cacheGet(exact, key(rand() % n)) != NULL;
+	}
+	report("Cache ExactLRU", "get-hit", n, start);
+
+	if (found != 4 * n) {
+		printf("unexpected %zu hits\n", found);
+	}
+
+	hashTableDestroy(htable);
+	cacheDestroy(lru);
+	cacheDestroy(lfu);
+	cacheDestroy(exact);
+}
+
+/* a cache of an eighth of the keys under a skewed get-or-set workload */
+static void benchSkewed(size_t n, int policy, const char *name)
+{
+	Cache *cache = cacheCreate(malloc, free, n / 8, policy);
+	cacheSetSeededHashMethod(cache, hashPointer);
+	cacheSetCompareMethod(cache, comparePointer);
+
+	size_t i;
+	size_t k;
+	size_t hits = 0;
+	double start = now();
+	for (i = 0; i < SKEWED_OPS; ++i) {
+		k = (size_t)rand() % n * ((size_t)rand() % n) / n;
+		if (cacheGet(cache, key(k)) != NULL) {
+			++hits;
+		} else {
+			cacheSet(cache, key(k), key(k));
+		}
+	}
+	report(name, "skewed", SKEWED_OPS, start);
+	printf("%-14s hit ratio  %8.3f\n", name, (double)hits / SKEWED_OPS);
+
+	cacheDestroy(cache);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1 << 20;
+
+	srand(1);
+	benchHitPath(n);
+	benchSkewed(n, CACHE_POLICY_LRU, "Cache LRU");
+	benchSkewed(n, CACHE_POLICY_LFU, "Cache LFU");
+	benchSkewed(n, CACHE_POLICY_EXACT_LRU, "Cache ExactLRU");
+
+	return 0;
+}
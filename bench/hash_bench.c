@@ -0,0 +1,125 @@
+#include "hash.h"
+#include "hashtable.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HASH_ROUNDS 2000000
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *op, size_t n, double start)
+{
+	printf("%-14s %-14s %8.1f ns/op\n", name, op,
+	       (now() - start) * 1e9 / n);
+}
+
+static size_t djb2(void *key)
+{
+	const unsigned char *p = key;
+	size_t hash = 5381;
+	while (*p != '\0') {
+		hash = hash * 33 + *p++;
+	}
+
+	return hash;
+}
+
+static size_t identity(void *key) { return (uintptr_t)key; }
+
+static void benchStringHash(size_t len)
+{
+	char *str = malloc(len + 1);
+	memset(str, 'x', len);
+	str[len] = '\0';
+
+	char op[32];
+	snprintf(op, sizeof(op), "%zu bytes", len);
+
+	size_t sum = 0;
+	size_t i;
+	double start = now();
+	for (i = 0; i < HASH_ROUNDS; ++i) {
+		str[i % len] = (char)i | 1;
+		sum += djb2(str);
+	}
+	report("djb2", op, HASH_ROUNDS, start);
+
+	start = now();
+	for (i = 0; i < HASH_ROUNDS; ++i) {
+		str[i % len] = (char)i | 1;
+		sum += hashString(str, 42);
+	}
+	report("hashString", op, HASH_ROUNDS, start);
+
+	if (sum == 0) {
+		printf("unexpected checksum\n");
+	}
+
+	free(str);
+}
+
+/* page-aligned pointers leave the low bits used by the bucket mask zero */
+static void benchPointerKeys(size_t n)
+{
+	HashTable *naive = hashTableCreate(malloc, free);
+	setHashMethod(naive, identity);
+	setCompareMethod(naive, comparePointer);
+
+	HashTable *seeded = hashTableCreate(malloc, free);
+	setSeededHashMethod(seeded, hashPointer);
+	setCompareMethod(seeded, comparePointer);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		hashTableSet(naive, (void *)((i + 1) << 12), (void *)1);
+	}
+	report("identity", "set", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += HashTableContains(naive, (void *)((i + 1) << 12));
+	}
+	report("identity", "get", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		hashTableSet(seeded, (void *)((i + 1) << 12), (void *)1);
+	}
+	report("hashPointer", "set", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += HashTableContains(seeded, (void *)((i + 1) << 12));
+	}
+	report("hashPointer", "get", n, start);
+
+	if (found != 2 * n) {
+		printf("unexpected %zu hits\n", found);
+	}
+
+	hashTableDestroy(naive);
+	hashTableDestroy(seeded);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+
+	benchStringHash(8);
+	benchStringHash(32);
+	benchStringHash(256);
+	benchPointerKeys(n);
+
+	return 0;
+}
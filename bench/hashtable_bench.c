@@ -0,0 +1,508 @@
+#include "concurrenthashtable.h"
+#include "flathashtable.h"
+#include "hashtable.h"
+#include "rcuhashtable.h"
+#include "typedhashtable.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONCURRENT_OPS 1000000
+#define GET_MANY_BATCH 64
+/* gets between two quiescent states of an RCU reader */
+#define QUIESCENT_INTERVAL 64
+#define SNAPSHOT_PATH "hashtable_bench.snapshot"
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t hashKey(void *key)
+{
+	uint64_t x = (uintptr_t)key;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static int compareKey(void *key1, void *key2) { return key1 != key2; }
+
+#define keyEquals(key1, key2) ((key1) == (key2))
+
+CDS_DEFINE_HASHTABLE(TypedTable, void *, void *, hashKey, keyEquals)
+
+static size_t serializeKey(void *key, void *buf, size_t cap)
+{
+	if (cap >= sizeof(key)) {
+		memcpy(buf, &key, sizeof(key));
+	}
+
+	return sizeof(key);
+}
+
+static void *deserializeKey(const void *buf, size_t len)
+{
+	void *key;
+	memcpy(&key, buf, sizeof(key));
+	return key;
+}
+
+static void report(const char *name, const char *op, size_t n, double start)
+{
+	printf("%-14s %-10s %8.1f ns/op\n", name, op,
+	       (now() - start) * 1e9 / n);
+}
+
+static void shuffle(void **keys, size_t n)
+{
+	size_t i;
+	for (i = n - 1; i > 0; --i) {
+		size_t j = rand() % (i + 1);
+		void *tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+static int countNull(void *key, void *value, void *privdata)
+{
+	*(size_t *)privdata += value == NULL;
+	return 0;
+}
+
+static void benchHashTable(void **keys, size_t n)
+{
+	HashTable *htable = hashTableCreate(malloc, free);
+	setHashMethod(htable, hashKey);
+	setCompareMethod(htable, compareKey);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		hashTableSet(htable, keys[i], keys[i]);
+	}
+	report("HashTable", "set", n, start);
+
+	start = now();
+	if (hashTableSave(htable, SNAPSHOT_PATH, serializeKey, serializeKey)) {
+		perror("hashTableSave");
+	}
+	report("HashTable", "save", n, start);
+
+	HashTable *loaded = hashTableCreate(malloc, free);
+	setHashMethod(loaded, hashKey);
+	setCompareMethod(loaded, compareKey);
+	start = now();
+	if (hashTableLoad(loaded, SNAPSHOT_PATH, deserializeKey,
+			  deserializeKey)) {
+		perror("hashTableLoad");
+	}
+	report("HashTable", "load", n, start);
+	hashTableDestroy(loaded);
+	unlink(SNAPSHOT_PATH);
+
+	HashTable *bulk = hashTableCreate(malloc, free);
+	setHashMethod(bulk, hashKey);
+	setCompareMethod(bulk, compareKey);
+	start = now();
+	hashTableSetMany(bulk, keys, keys, n);
+	report("HashTable", "set-many", n, start);
+	hashTableDestroy(bulk);
+
+	shuffle(keys, n);
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += hashTableGet(htable, keys[i]) != NULL;
+	}
+	report("HashTable", "get-hit", n, start);
+
+	void *values[GET_MANY_BATCH];
+	start = now();
+	for (i = 0; i < n; i += GET_MANY_BATCH) {
+		size_t batch = n - i < GET_MANY_BATCH ? n - i : GET_MANY_BATCH;
+		hashTableGetMany(htable, keys + i, batch, values);
+		found -= values[batch - 1] == NULL;
+	}
+	report("HashTable", "get-many", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += hashTableGet(htable, (char *)keys[i] + 1) != NULL;
+	}
+	report("HashTable", "get-miss", n, start);
+
+	size_t nulls = 0;
+	void *key;
+	void *value;
+	start = now();
+	HashTableIter *iter = hashTableIterator(htable);
+	while (hashTableIterHasNext(iter)) {
+		hashTableIterNext(iter, &key, &value);
+		nulls += value == NULL;
+	}
+	hashTableIterDestroy(iter);
+	report("HashTable", "iter", n, start);
+
+	HashTableIter stack_iter;
+	start = now();
+	hashTableForEach(htable, stack_iter, key, value) {
+		nulls += value == NULL;
+	}
+	report("HashTable", "foreach", n, start);
+
+	start = now();
+	hashTableVisit(htable, countNull, &nulls);
+	report("HashTable", "visit", n, start);
+	found += nulls;
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		hashTableRemove(htable, keys[i]);
+	}
+	report("HashTable", "remove", n, start);
+
+	if (found != n) {
+		printf("HashTable: unexpected %zu hits\n", found);
+	}
+
+	hashTableDestroy(htable);
+}
+
+static void benchFlatHashTable(void **keys, size_t n)
+{
+	FlatHashTable *htable = flatHashTableCreate(malloc, free);
+	flatHashTableSetHashMethod(htable, hashKey);
+	flatHashTableSetCompareMethod(htable, compareKey);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		flatHashTableSet(htable, keys[i], keys[i]);
+	}
+	report("FlatHashTable", "set", n, start);
+
+	shuffle(keys, n);
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += flatHashTableGet(htable, keys[i]) != NULL;
+	}
+	report("FlatHashTable", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += flatHashTableGet(htable, (char *)keys[i] + 1) != NULL;
+	}
+	report("FlatHashTable", "get-miss", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		flatHashTableRemove(htable, keys[i]);
+	}
+	report("FlatHashTable", "remove", n, start);
+
+	if (found != n) {
+		printf("FlatHashTable: unexpected %zu hits\n", found);
+	}
+
+	flatHashTableDestroy(htable);
+}
+
+typedef struct Worker {
+	pthread_t thread;
+	pthread_mutex_t *lock;
+	HashTable *htable;
+	ConcurrentHashTable *chtable;
+	RCUHashTable *rtable;
+	int *stop;
+	void **keys;
+	size_t n;
+	unsigned seed;
+} Worker;
+
+/* 90% gets and 10% sets over the shared key set */
+static void *lockedWorker(void *arg)
+{
+	Worker *worker = arg;
+	size_t i;
+	for (i = 0; i < CONCURRENT_OPS; ++i) {
+		void *key = worker->keys[rand_r(&worker->seed) % worker->n];
+		pthread_mutex_lock(worker->lock);
+		if (i % 10 == 0) {
+			hashTableSet(worker->htable, key, key);
+		} else {
+			hashTableGet(worker->htable, key);
+		}
+		pthread_mutex_unlock(worker->lock);
+	}
+
+	return NULL;
+}
+
+static void *concurrentWorker(void *arg)
+{
+	Worker *worker = arg;
+	size_t i;
+	for (i = 0; i < CONCURRENT_OPS; ++i) {
+		void *key = worker->keys[rand_r(&worker->seed) % worker->n];
+		if (i % 10 == 0) {
+			concurrentHashTableSet(worker->chtable, key, key);
+		} else {
+			concurrentHashTableGet(worker->chtable, key);
+		}
+	}
+
+	return NULL;
+}
+
+/* read-mostly workload: one writer updates until every reader is done */
+static void *concurrentWriter(void *arg)
+{
+	Worker *worker = arg;
+	while (!__atomic_load_n(worker->stop, __ATOMIC_RELAXED)) {
+		void *key = worker->keys[rand_r(&worker->seed) % worker->n];
+		concurrentHashTableSet(worker->chtable, key, key);
+	}
+
+	return NULL;
+}
+
+static void *concurrentReader(void *arg)
+{
+	Worker *worker = arg;
+	size_t i;
+	for (i = 0; i < CONCURRENT_OPS; ++i) {
+		void *key = worker->keys[rand_r(&worker->seed) % worker->n];
+		concurrentHashTableGet(worker->chtable, key);
+	}
+
+	return NULL;
+}
+
+static void *rcuWriter(void *arg)
+{
+	Worker *worker = arg;
+	while (!__atomic_load_n(worker->stop, __ATOMIC_RELAXED)) {
+		void *key = worker->keys[rand_r(&worker->seed) % worker->n];
+		rcuHashTableSet(worker->rtable, key, key);
+	}
+
+	return NULL;
+}
+
+static void *rcuReader(void *arg)
+{
+	Worker *worker = arg;
+	RCUHashTableReader *reader = rcuHashTableRegisterReader(worker->rtable);
+	size_t i;
+	for (i = 0; i < CONCURRENT_OPS; ++i) {
+		void *key = worker->keys[rand_r(&worker->seed) % worker->n];
+		rcuHashTableGet(worker->rtable, key);
+		if (i % QUIESCENT_INTERVAL == 0) {
+			rcuHashTableQuiescent(reader);
+		}
+	}
+
+	rcuHashTableUnregisterReader(reader);
+	return NULL;
+}
+
+static void runWorkers(Worker *workers, size_t threads,
+		       void *(*routine)(void *))
+{
+	size_t i;
+	for (i = 0; i < threads; ++i) {
+		workers[i].seed = i + 1;
+		pthread_create(&workers[i].thread, NULL, routine, workers + i);
+	}
+
+	for (i = 0; i < threads; ++i) {
+		pthread_join(workers[i].thread, NULL);
+	}
+}
+
+static void benchTypedHashTable(void **keys, size_t n)
+{
+	TypedTable *table = TypedTableCreate(malloc, free);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		TypedTableSet(table, keys[i], keys[i]);
+	}
+	report("TypedTable", "set", n, start);
+
+	shuffle(keys, n);
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += TypedTableGet(table, keys[i]) != NULL;
+	}
+	report("TypedTable", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += TypedTableGet(table, (char *)keys[i] + 1) != NULL;
+	}
+	report("TypedTable", "get-miss", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		TypedTableRemove(table, keys[i], NULL);
+	}
+	report("TypedTable", "remove", n, start);
+
+	if (found != n) {
+		printf("TypedTable: unexpected %zu hits\n", found);
+	}
+
+	TypedTableDestroy(table);
+}
+
+static void benchConcurrentHashTable(void **keys, size_t n)
+{
+	size_t cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t max_threads = cores < 4 ? 4 : cores;
+	Worker *workers = malloc(sizeof(Worker) * max_threads);
+
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	HashTable *htable = hashTableCreate(malloc, free);
+	setHashMethod(htable, hashKey);
+	setCompareMethod(htable, compareKey);
+
+	ConcurrentHashTable *chtable =
+	    concurrentHashTableCreate(malloc, free, max_threads * 4);
+	concurrentHashTableSetHashMethod(chtable, hashKey);
+	concurrentHashTableSetCompareMethod(chtable, compareKey);
+
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		hashTableSet(htable, keys[i], keys[i]);
+		concurrentHashTableSet(chtable, keys[i], keys[i]);
+	}
+
+	for (i = 0; i < max_threads; ++i) {
+		workers[i].lock = &lock;
+		workers[i].htable = htable;
+		workers[i].chtable = chtable;
+		workers[i].keys = keys;
+		workers[i].n = n;
+	}
+
+	size_t threads;
+	char name[32];
+	for (threads = 1; threads <= max_threads; threads <<= 1) {
+		double start = now();
+		runWorkers(workers, threads, lockedWorker);
+		snprintf(name, sizeof(name), "mutex x%zu", threads);
+		report(name, "mixed", threads * CONCURRENT_OPS, start);
+
+		start = now();
+		runWorkers(workers, threads, concurrentWorker);
+		snprintf(name, sizeof(name), "sharded x%zu", threads);
+		report(name, "mixed", threads * CONCURRENT_OPS, start);
+	}
+
+	hashTableDestroy(htable);
+	concurrentHashTableDestroy(chtable);
+	free(workers);
+}
+
+static void runReadMostly(Worker *workers, size_t threads,
+			  void *(*writer)(void *), void *(*reader)(void *))
+{
+	int stop = 0;
+	size_t i;
+	for (i = 0; i <= threads; ++i) {
+		workers[i].seed = i + 1;
+		workers[i].stop = &stop;
+	}
+
+	pthread_create(&workers[threads].thread, NULL, writer,
+		       workers + threads);
+	runWorkers(workers, threads, reader);
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+	pthread_join(workers[threads].thread, NULL);
+}
+
+static void benchReadMostly(void **keys, size_t n)
+{
+	size_t cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t max_threads = cores < 4 ? 4 : cores;
+	Worker *workers = malloc(sizeof(Worker) * (max_threads + 1));
+
+	ConcurrentHashTable *chtable =
+	    concurrentHashTableCreate(malloc, free, max_threads * 4);
+	concurrentHashTableSetHashMethod(chtable, hashKey);
+	concurrentHashTableSetCompareMethod(chtable, compareKey);
+
+	RCUHashTable *rtable = rcuHashTableCreate(malloc, free);
+	rcuHashTableSetHashMethod(rtable, hashKey);
+	rcuHashTableSetCompareMethod(rtable, compareKey);
+
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		concurrentHashTableSet(chtable, keys[i], keys[i]);
+		rcuHashTableSet(rtable, keys[i], keys[i]);
+	}
+
+	for (i = 0; i <= max_threads; ++i) {
+		workers[i].chtable = chtable;
+		workers[i].rtable = rtable;
+		workers[i].keys = keys;
+		workers[i].n = n;
+	}
+
+	size_t threads;
+	char name[32];
+	for (threads = 1; threads <= max_threads; threads <<= 1) {
+		double start = now();
+		runReadMostly(workers, threads, concurrentWriter,
+			      concurrentReader);
+		snprintf(name, sizeof(name), "sharded x%zu", threads);
+		report(name, "read", threads * CONCURRENT_OPS, start);
+
+		start = now();
+		runReadMostly(workers, threads, rcuWriter, rcuReader);
+		snprintf(name, sizeof(name), "rcu x%zu", threads);
+		report(name, "read", threads * CONCURRENT_OPS, start);
+	}
+
+	concurrentHashTableDestroy(chtable);
+	rcuHashTableDestroy(rtable);
+	free(workers);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1 << 20;
+	void **keys = malloc(sizeof(void *) * n);
+
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		keys[i] = (void *)((i + 1) << 4);
+	}
+
+	srand(1);
+	shuffle(keys, n);
+	benchHashTable(keys, n);
+	benchFlatHashTable(keys, n);
+	benchTypedHashTable(keys, n);
+	benchConcurrentHashTable(keys, n);
+	benchReadMostly(keys, n);
+
+	free(keys);
+	return 0;
+}
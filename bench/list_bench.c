@@ -0,0 +1,414 @@
+#include "deque.h"
+#include "intrusivelist.h"
+#include "list.h"
+#include "skiplist.h"
+#include "typedlist.h"
+#include "unrolledlist.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONTAINS_ROUNDS 2000
+#define INDEX_ROUNDS 2000
+#define MOVE_BATCH 16
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *op, size_t n, double start)
+{
+	printf("%-14s %-10s %8.1f ns/op\n", name, op,
+	       (now() - start) * 1e9 / n);
+}
+
+static int compareValue(void *value1, void *value2)
+{
+	return value1 != value2;
+}
+
+static int compareOrder(void *value1, void *value2)
+{
+	return value1 < value2 ? -1 : value1 > value2;
+}
+
+static int countNull(void *value, void *privdata)
+{
+	*(size_t *)privdata += value == NULL;
+	return 0;
+}
+
+#define valueEquals(value1, value2) ((value1) == (value2))
+
+CDS_DEFINE_LIST(TypedList, uintptr_t, valueEquals)
+
+/* contains is reported per visited node, searches hit on average halfway */
+static void benchList(size_t n)
+{
+	List *list = listCreate(malloc, free);
+	listSetCompareMethod(list, compareValue);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		listPushTail(list, (void *)i);
+	}
+	report("List", "push", n, start);
+
+	start = now();
+	for (i = 0; i < CONTAINS_ROUNDS; ++i) {
+		found += listContains(list, (void *)(rand() % (2 * n)));
+	}
+	report("List", "contains", CONTAINS_ROUNDS * n, start);
+
+	start = now();
+	ListIter *iter = listIterator(list);
+	while (listIterHasNext(iter)) {
+		found += listIterNext(iter) == NULL;
+	}
+	listIterDestroy(iter);
+	report("List", "scan", n, start);
+
+	start = now();
+	ListNode *node;
+	listForEach(list, node) {
+		found += node->value == NULL;
+	}
+	report("List", "foreach", n, start);
+
+	start = now();
+	listVisit(list, countNull, &found);
+	report("List", "visit", n, start);
+
+	start = now();
+	for (i = 0; i < INDEX_ROUNDS; ++i) {
+		found += listIndex(list, rand() % n) == NULL;
+	}
+	report("List", "index", INDEX_ROUNDS, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		listPopHead(list);
+	}
+	report("List", "pop", n, start);
+
+	printf("List: %zu hits\n", found);
+	listDestroy(list);
+}
+
+static void fillRandom(List *list, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		listPushTail(list, (void *)(uintptr_t)rand());
+	}
+}
+
+/* sorts are reported per element */
+static void benchListSort(size_t n)
+{
+	size_t threads = sysconf(_SC_NPROCESSORS_ONLN);
+	/* one pool for both, so the merge relinks instead of copying */
+	Pool *pool = poolCreate(malloc, free, sizeof(ListNode),
+				POOL_DEFAULT_SLAB_NODES);
+	List *list = listCreateWithPool(malloc, free, pool);
+	List *other = listCreateWithPool(malloc, free, pool);
+	poolDestroy(pool);
+	listSetCompareMethod(list, compareOrder);
+	listSetCompareMethod(other, compareOrder);
+
+	fillRandom(list, n);
+	double start = now();
+	listSort(list);
+	report("List", "sort", n, start);
+
+	listClear(list);
+	fillRandom(list, n);
+	start = now();
+	listSortParallel(list, threads);
+	report("List", "psort", n, start);
+
+	fillRandom(other, n);
+	listSort(other);
+	start = now();
+	listMerge(list, other);
+	report("List", "merge", 2 * n, start);
+
+	start = now();
+	listUnique(list);
+	report("List", "unique", 2 * n, start);
+
+	printf("List: %zu unique of %zu\n", listLength(list), 2 * n);
+	listDestroy(other);
+	listDestroy(list);
+}
+
+/* drains one list into another in batches, reported per element */
+static void benchListMove(size_t n)
+{
+	List *from = listCreate(malloc, free);
+	List *to = listCreate(malloc, free);
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		listPushTail(from, (void *)i);
+	}
+
+	double start = now();
+	while (listLength(from) > 0) {
+		listPushTail(to, listPopHead(from));
+	}
+	report("List", "pop+push", n, start);
+
+	start = now();
+	while (listLength(to) > 0) {
+		size_t count = listLength(to) < MOVE_BATCH ? listLength(to)
+							   : MOVE_BATCH;
+		ListNode *last = listHead(to);
+		for (i = 1; i < count; ++i) {
+			last = listNodeNext(last);
+		}
+
+		listMoveRange(from, listTail(from), to, listHead(to), last,
+			      count);
+	}
+	report("List", "moverange", n, start);
+
+	listDestroy(to);
+	listDestroy(from);
+}
+
+static void benchTypedList(size_t n)
+{
+	TypedList *list = TypedListCreate(malloc, free);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		TypedListPushTail(list, i);
+	}
+	report("TypedList", "push", n, start);
+
+	start = now();
+	for (i = 0; i < CONTAINS_ROUNDS; ++i) {
+		found += TypedListContains(list, rand() % (2 * n));
+	}
+	report("TypedList", "contains", CONTAINS_ROUNDS * n, start);
+
+	uintptr_t value;
+	start = now();
+	for (i = 0; i < n; ++i) {
+		TypedListPopHead(list, &value);
+	}
+	report("TypedList", "pop", n, start);
+
+	printf("TypedList: %zu hits\n", found);
+	TypedListDestroy(list);
+}
+
+static void benchUnrolledList(size_t n)
+{
+	UnrolledList *list = unrolledListCreate(malloc, free);
+	unrolledListSetCompareMethod(list, compareValue);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		unrolledListPushTail(list, (void *)i);
+	}
+	report("UnrolledList", "push", n, start);
+	size_t memory = unrolledListMemory(list);
+
+	start = now();
+	for (i = 0; i < CONTAINS_ROUNDS; ++i) {
+		found += unrolledListContains(list, (void *)(rand() % (2 * n)));
+	}
+	report("UnrolledList", "contains", CONTAINS_ROUNDS * n, start);
+
+	start = now();
+	UnrolledListIter *iter = unrolledListIterator(list);
+	while (unrolledListIterHasNext(iter)) {
+		found += unrolledListIterNext(iter) == NULL;
+	}
+	unrolledListIterDestroy(iter);
+	report("UnrolledList", "scan", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		unrolledListPopHead(list);
+	}
+	report("UnrolledList", "pop", n, start);
+
+	printf("UnrolledList: %zu hits, %.1f bytes/value\n", found,
+	       (double)memory / n);
+	unrolledListDestroy(list);
+}
+
+static void benchSkipList(size_t n)
+{
+	SkipList *list = skipListCreate(malloc, free, compareOrder);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		skipListInsert(list, (void *)(uintptr_t)rand());
+	}
+	report("SkipList", "insert", n, start);
+
+	start = now();
+	for (i = 0; i < INDEX_ROUNDS; ++i) {
+		found += skipListIndex(list, rand() % n) == NULL;
+	}
+	report("SkipList", "index", INDEX_ROUNDS, start);
+
+	start = now();
+	for (i = 0; i < INDEX_ROUNDS; ++i) {
+		void *value = skipListIndex(list, rand() % n);
+		found += skipListRank(list, value) != SKIPLIST_NOT_FOUND;
+	}
+	report("SkipList", "index+rank", INDEX_ROUNDS, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		skipListRemove(list, rand() % (n - i));
+	}
+	report("SkipList", "remove", n, start);
+
+	printf("SkipList: %zu hits\n", found);
+	skipListDestroy(list);
+}
+
+/* scans the spans directly, a loop the compiler can vectorize */
+static size_t dequeSum(Deque *deque)
+{
+	void **spans[2];
+	size_t lengths[2];
+	dequeSpans(deque, &spans[0], &lengths[0], &spans[1], &lengths[1]);
+
+	size_t sum = 0;
+	size_t span;
+	size_t i;
+	for (span = 0; span < 2; ++span) {
+		for (i = 0; i < lengths[span]; ++i) {
+			sum += (uintptr_t)spans[span][i];
+		}
+	}
+
+	return sum;
+}
+
+static void benchDeque(size_t n)
+{
+	Deque *deque = dequeCreate(malloc, free);
+	dequeSetCompareMethod(deque, compareValue);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		dequePushTail(deque, (void *)i);
+	}
+	report("Deque", "push", n, start);
+
+	start = now();
+	for (i = 0; i < CONTAINS_ROUNDS; ++i) {
+		found += dequeContains(deque, (void *)(rand() % (2 * n)));
+	}
+	report("Deque", "contains", CONTAINS_ROUNDS * n, start);
+
+	start = now();
+	DequeIter *iter = dequeIterator(deque);
+	while (dequeIterHasNext(iter)) {
+		found += dequeIterNext(iter) == NULL;
+	}
+	dequeIterDestroy(iter);
+	report("Deque", "scan", n, start);
+
+	start = now();
+	found += dequeSum(deque) == 0;
+	report("Deque", "span-scan", n, start);
+
+	start = now();
+	for (i = 0; i < INDEX_ROUNDS; ++i) {
+		found += dequeIndex(deque, rand() % n) == NULL;
+	}
+	report("Deque", "index", INDEX_ROUNDS, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		dequePopHead(deque);
+	}
+	report("Deque", "pop", n, start);
+
+	printf("Deque: %zu hits\n", found);
+	dequeDestroy(deque);
+}
+
+typedef struct Item {
+	uintptr_t value;
+	ListLink link;
+} Item;
+
+static void benchIntrusiveList(size_t n)
+{
+	Item *items = malloc(sizeof(Item) * n);
+	IntrusiveList list;
+	intrusiveListInit(&list);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		items[i].value = i;
+		intrusiveLinkInit(&items[i].link);
+		intrusiveListPushTail(&list, &items[i].link);
+	}
+	report("IntrusiveList", "push", n, start);
+
+	start = now();
+	ListLink *link;
+	intrusiveListForEach(&list, link) {
+		found += containerOf(link, Item, link)->value == 0;
+	}
+	report("IntrusiveList", "scan", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		intrusiveListPopHead(&list);
+	}
+	report("IntrusiveList", "pop", n, start);
+
+	printf("IntrusiveList: %zu hits\n", found);
+	free(items);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+
+	srand(1);
+	benchList(n);
+	srand(1);
+	benchListSort(n);
+	benchListMove(n);
+	srand(1);
+	benchTypedList(n);
+	srand(1);
+	benchUnrolledList(n);
+	srand(1);
+	benchSkipList(n);
+	benchIntrusiveList(n);
+	srand(1);
+	benchDeque(n);
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+#include "list.h"
+#include "queue.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define QUEUE_OPS 1000000
+#define RING_CAPACITY 1024
+#define BATCH_SIZE 16
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *op, size_t n, double start)
+{
+	printf("%-22s %-10s %8.1f ns/op\n", name, op,
+	       (now() - start) * 1e9 / n);
+}
+
+typedef struct Worker {
+	pthread_t thread;
+	pthread_mutex_t *lock;
+	List *list;
+	Queue *queue;
+	size_t ops;
+	size_t batch;
+	/* items the consumers still have to pop */
+	size_t *remaining;
+} Worker;
+
+static void *lockedProducer(void *arg)
+{
+	Worker *worker = arg;
+	size_t i;
+	for (i = 0; i < worker->ops; ++i) {
+		pthread_mutex_lock(worker->lock);
+		listPushTail(worker->list, (void *)(i + 1));
+		pthread_mutex_unlock(worker->lock);
+	}
+
+	return NULL;
+}
+
+static void *lockedConsumer(void *arg)
+{
+	Worker *worker = arg;
+	while (__atomic_load_n(worker->remaining, __ATOMIC_RELAXED) > 0) {
+		void *value = NULL;
+		pthread_mutex_lock(worker->lock);
+		if (listLength(worker->list) > 0) {
+			value = listPopHead(worker->list);
+		}
+		pthread_mutex_unlock(worker->lock);
+
+		if (value != NULL) {
+			__atomic_sub_fetch(worker->remaining, 1,
+					   __ATOMIC_RELAXED);
+		} else {
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void *queueProducer(void *arg)
+{
+	Worker *worker = arg;
+	QueueHandle *handle = queueRegister(worker->queue);
+	void *values[BATCH_SIZE];
+	size_t i = 0;
+	while (i < worker->ops) {
+		size_t n = worker->ops - i < worker->batch ? worker->ops - i
+							   : worker->batch;
+		size_t j;
+		for (j = 0; j < n; ++j) {
+			values[j] = (void *)(i + j + 1);
+		}
+
+		size_t pushed = queuePushTailMany(handle, values, n);
+		if (pushed == 0) {
+			sched_yield();
+		}
+
+		i += pushed;
+	}
+
+	queueUnregister(handle);
+	return NULL;
+}
+
+static void *queueConsumer(void *arg)
+{
+	Worker *worker = arg;
+	QueueHandle *handle = queueRegister(worker->queue);
+	void *values[BATCH_SIZE];
+	while (__atomic_load_n(worker->remaining, __ATOMIC_RELAXED) > 0) {
+		size_t popped =
+		    queuePopHeadMany(handle, values, worker->batch);
+		if (popped > 0) {
+			__atomic_sub_fetch(worker->remaining, popped,
+					   __ATOMIC_RELAXED);
+		} else {
+			sched_yield();
+		}
+	}
+
+	queueUnregister(handle);
+	return NULL;
+}
+
+/* pairs producers and consumers, every producer pushing QUEUE_OPS items */
+static void runPairs(Worker *workers, size_t pairs, const char *name,
+		     void *(*producer)(void *), void *(*consumer)(void *))
+{
+	size_t remaining = pairs * QUEUE_OPS;
+	size_t i;
+	for (i = 0; i < 2 * pairs; ++i) {
+		workers[i].ops = QUEUE_OPS;
+		workers[i].remaining = &remaining;
+	}
+
+	double start = now();
+	for (i = 0; i < pairs; ++i) {
+		pthread_create(&workers[i].thread, NULL, producer, workers + i);
+		pthread_create(&workers[pairs + i].thread, NULL, consumer,
+			       workers + pairs + i);
+	}
+
+	for (i = 0; i < 2 * pairs; ++i) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	char label[64];
+	snprintf(label, sizeof(label), "%s %zux%zu", name, pairs, pairs);
+	report(label, "handoff", pairs * QUEUE_OPS, start);
+}
+
+static void benchQueue(Queue *queue, const char *name, size_t max_pairs,
+		       Worker *workers)
+{
+	size_t pairs;
+	size_t i;
+	char label[32];
+	for (pairs = 1; pairs <= max_pairs; pairs <<= 1) {
+		for (i = 0; i < 2 * pairs; ++i) {
+			workers[i].queue = queue;
+			workers[i].batch = 1;
+		}
+		runPairs(workers, pairs, name, queueProducer, queueConsumer);
+
+		for (i = 0; i < 2 * pairs; ++i) {
+			workers[i].batch = BATCH_SIZE;
+		}
+		snprintf(label, sizeof(label), "%s batch", name);
+		runPairs(workers, pairs, label, queueProducer, queueConsumer);
+	}
+
+	queueDestroy(queue);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t max_pairs = argc > 1 ? strtoul(argv[1], NULL, 10)
+				    : (cores > 1 ? cores / 2 : 1);
+	Worker *workers = malloc(sizeof(Worker) * 2 * max_pairs);
+
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	List *list = listCreatePooled(malloc, free);
+	size_t pairs;
+	size_t i;
+	for (pairs = 1; pairs <= max_pairs; pairs <<= 1) {
+		for (i = 0; i < 2 * pairs; ++i) {
+			workers[i].lock = &lock;
+			workers[i].list = list;
+		}
+		runPairs(workers, pairs, "mutex List", lockedProducer,
+			 lockedConsumer);
+	}
+	listDestroy(list);
+
+	benchQueue(queueCreateBounded(malloc, free, RING_CAPACITY), "ring",
+		   max_pairs, workers);
+	benchQueue(queueCreate(malloc, free), "linked", max_pairs, workers);
+
+	free(workers);
+	return 0;
+}
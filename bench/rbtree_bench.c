@@ -0,0 +1,374 @@
+#include "btree.h"
+#include "intrusiverbtree.h"
+#include "rbtree.h"
+#include "typedrbtree.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RANGE_QUERIES 100000
+/* keys are multiples of 16, so a range query spans RANGE_KEYS keys */
+#define RANGE_KEYS 16
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *op, size_t n, double start)
+{
+	printf("%-14s %-10s %8.1f ns/op\n", name, op,
+	       (now() - start) * 1e9 / n);
+}
+
+static void shuffle(void **keys, size_t n)
+{
+	size_t i;
+	for (i = n - 1; i > 0; --i) {
+		size_t j = rand() % (i + 1);
+		void *tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+static int compareKey(void *key1, void *key2)
+{
+	return ((uintptr_t)key1 > (uintptr_t)key2) -
+	       ((uintptr_t)key1 < (uintptr_t)key2);
+}
+
+#define keyCompare(key1, key2) (((key1) > (key2)) - ((key1) < (key2)))
+
+CDS_DEFINE_RBTREE(TypedTree, uintptr_t, uintptr_t, keyCompare)
+
+static int countNull(void *key, void *value, void *privdata)
+{
+	*(size_t *)privdata += value == NULL;
+	return 0;
+}
+
+static void benchRBTree(void **keys, size_t n)
+{
+	RBTree *tree = rbtreeCreate(malloc, free);
+	rbtreeSetCompareMethod(tree, compareKey);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		rbtreeSet(tree, keys[i], keys[i]);
+	}
+	report("RBTree", "set", n, start);
+
+	shuffle(keys, n);
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += rbtreeGet(tree, keys[i]) != NULL;
+	}
+	report("RBTree", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += rbtreeGet(tree, (char *)keys[i] + 1) != NULL;
+	}
+	report("RBTree", "get-miss", n, start);
+
+	size_t nulls = 0;
+	void *key;
+	void *value;
+	start = now();
+	RBTreeIter *iter = rbtreeIterator(tree);
+	while (rbtreeIterHasNext(iter)) {
+		rbtreeIterNext(iter, &key, &value);
+		nulls += value == NULL;
+	}
+	rbtreeIterDestroy(iter);
+	report("RBTree", "iter", n, start);
+
+	start = now();
+	RBTreeNode *node;
+	rbtreeForEach(tree, node) {
+		nulls += node->value == NULL;
+	}
+	report("RBTree", "foreach", n, start);
+
+	start = now();
+	rbtreeVisit(tree, countNull, &nulls);
+	report("RBTree", "visit", n, start);
+	found += nulls;
+
+	size_t scanned = 0;
+	start = now();
+	for (i = 0; i < RANGE_QUERIES; ++i) {
+		RBTreeIter range;
+		uintptr_t min = (uintptr_t)keys[i % n];
+		rbtreeRangeIterInit(tree, &range, (void *)min,
+				    (void *)(min + (RANGE_KEYS << 4)));
+		while (rbtreeIterHasNext(&range)) {
+			rbtreeIterNext(&range, &key, &value);
+			++scanned;
+		}
+	}
+	report("RBTree", "range", RANGE_QUERIES, start);
+
+	size_t counted = 0;
+	start = now();
+	for (i = 0; i < RANGE_QUERIES; ++i) {
+		uintptr_t min = (uintptr_t)keys[i % n];
+		counted += rbtreeCountRange(tree, (void *)min,
+					    (void *)(min + (RANGE_KEYS << 4)));
+	}
+	report("RBTree", "count", RANGE_QUERIES, start);
+	printf("RBTree: %zu scanned, %zu counted\n", scanned, counted);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		rbtreeRemove(tree, keys[i]);
+	}
+	report("RBTree", "remove", n, start);
+
+	if (found != n) {
+		printf("RBTree: unexpected %zu hits\n", found);
+	}
+
+	rbtreeDestroy(tree);
+}
+
+/* compares with the RBTree rows to show what keeping sizes costs */
+static void benchOrderStatistics(void **keys, size_t n)
+{
+	RBTree *tree = rbtreeCreate(malloc, free);
+	rbtreeSetCompareMethod(tree, compareKey);
+	rbtreeEnableOrderStatistics(tree);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		rbtreeSet(tree, keys[i], keys[i]);
+	}
+	report("RBTree+stats", "set", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += rbtreeSelect(tree, rand() % n) != NULL;
+	}
+	report("RBTree+stats", "select", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += rbtreeRank(tree, keys[i]) < n;
+	}
+	report("RBTree+stats", "rank", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += rbtreePercentile(tree, 99.9) != NULL;
+	}
+	report("RBTree+stats", "p99.9", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		rbtreeRemove(tree, keys[i]);
+	}
+	report("RBTree+stats", "remove", n, start);
+
+	if (found != 3 * n) {
+		printf("RBTree+stats: unexpected %zu hits\n", found);
+	}
+
+	rbtreeDestroy(tree);
+}
+
+static void benchBTree(BTree *tree, const char *name, void **keys, size_t n)
+{
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		btreeSet(tree, keys[i], keys[i]);
+	}
+	report(name, "set", n, start);
+
+	shuffle(keys, n);
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += btreeGet(tree, keys[i]) != NULL;
+	}
+	report(name, "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += btreeGet(tree, (char *)keys[i] + 1) != NULL;
+	}
+	report(name, "get-miss", n, start);
+
+	size_t nulls = 0;
+	void *key;
+	void *value;
+	BTreeIter iter;
+	start = now();
+	btreeIterInit(tree, &iter);
+	while (btreeIterHasNext(&iter)) {
+		btreeIterNext(&iter, &key, &value);
+		nulls += value == NULL;
+	}
+	report(name, "iter", n, start);
+	found += nulls;
+
+	size_t scanned = 0;
+	start = now();
+	for (i = 0; i < RANGE_QUERIES; ++i) {
+		uintptr_t min = (uintptr_t)keys[i % n];
+		btreeRangeIterInit(tree, &iter, (void *)min,
+				   (void *)(min + (RANGE_KEYS << 4)));
+		while (btreeIterHasNext(&iter)) {
+			btreeIterNext(&iter, &key, &value);
+			++scanned;
+		}
+	}
+	report(name, "range", RANGE_QUERIES, start);
+	printf("%s: %zu scanned, %zu bytes per key\n", name, scanned,
+	       btreeMemory(tree) / n);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		btreeRemove(tree, keys[i]);
+	}
+	report(name, "remove", n, start);
+
+	if (found != n) {
+		printf("%s: unexpected %zu hits\n", name, found);
+	}
+
+	btreeDestroy(tree);
+}
+
+static void benchTypedTree(void **keys, size_t n)
+{
+	TypedTree *tree = TypedTreeCreate(malloc, free);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		TypedTreeSet(tree, (uintptr_t)keys[i], (uintptr_t)keys[i]);
+	}
+	report("TypedTree", "set", n, start);
+
+	shuffle(keys, n);
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += TypedTreeContains(tree, (uintptr_t)keys[i]);
+	}
+	report("TypedTree", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += TypedTreeContains(tree, (uintptr_t)keys[i] + 1);
+	}
+	report("TypedTree", "get-miss", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		TypedTreeRemove(tree, (uintptr_t)keys[i], NULL);
+	}
+	report("TypedTree", "remove", n, start);
+
+	if (found != n) {
+		printf("TypedTree: unexpected %zu hits\n", found);
+	}
+
+	TypedTreeDestroy(tree);
+}
+
+typedef struct Item {
+	uintptr_t key;
+	RBLink link;
+} Item;
+
+static int compareItem(RBLink *link1, RBLink *link2)
+{
+	return keyCompare(containerOf(link1, Item, link)->key,
+			  containerOf(link2, Item, link)->key);
+}
+
+static int compareItemKey(void *key, RBLink *link)
+{
+	return keyCompare((uintptr_t)key, containerOf(link, Item, link)->key);
+}
+
+/* items come from one array, as objects living in the caller's slabs */
+static void benchIntrusiveTree(void **keys, size_t n)
+{
+	Item *items = malloc(sizeof(Item) * n);
+	IntrusiveRBTree tree;
+	intrusiveRBTreeInit(&tree, compareItem, compareItemKey);
+
+	size_t i;
+	size_t found = 0;
+	double start = now();
+	for (i = 0; i < n; ++i) {
+		items[i].key = (uintptr_t)keys[i];
+		intrusiveRBTreeInsert(&tree, &items[i].link);
+	}
+	report("IntrusiveTree", "set", n, start);
+
+	shuffle(keys, n);
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found += intrusiveRBTreeFind(&tree, keys[i]) != NULL;
+	}
+	report("IntrusiveTree", "get-hit", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		found +=
+		    intrusiveRBTreeFind(&tree, (char *)keys[i] + 1) != NULL;
+	}
+	report("IntrusiveTree", "get-miss", n, start);
+
+	start = now();
+	for (i = 0; i < n; ++i) {
+		intrusiveRBTreeRemove(&tree, &items[i].link);
+	}
+	report("IntrusiveTree", "unlink", n, start);
+
+	if (found != n) {
+		printf("IntrusiveTree: unexpected %zu hits\n", found);
+	}
+
+	free(items);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1 << 20;
+	void **keys = malloc(sizeof(void *) * n);
+
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		keys[i] = (void *)((i + 1) << 4);
+	}
+
+	srand(1);
+	shuffle(keys, n);
+	benchRBTree(keys, n);
+	benchOrderStatistics(keys, n);
+
+	BTree *btree = btreeCreate(malloc, free);
+	btreeSetCompareMethod(btree, compareKey);
+	benchBTree(btree, "BTree", keys, n);
+	benchBTree(btreeCreateWithIntegerKeys(malloc, free), "BTree int", keys,
+		   n);
+	benchTypedTree(keys, n);
+	benchIntrusiveTree(keys, n);
+
+	free(keys);
+	return 0;
+}
@@ -0,0 +1,341 @@
+#include "cache.h"
+#include "hash.h"
+#include "hashtable.h"
+#include "list.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* entries compared per eviction, as Redis maxmemory-samples */
+#define EVICTION_SAMPLES 5
+/* operations between two reads of the LFU decay clock */
+#define LFU_CLOCK_INTERVAL 1024
+#define LFU_INIT_VAL 5
+#define LFU_LOG_FACTOR 10
+/* counters lose one point per this many seconds without access */
+#define LFU_DECAY_SECONDS 60
+
+/*
+ * The table maps keys straight to values and keeps the eviction metadata
+ * in its entry data, so a hit costs a single lookup. As Redis, LRU and
+ * LFU are approximated by sampling a few entries at eviction: LRU stamps
+ * an operation counter on every access, LFU keeps a logarithmic access
+ * counter that decays with time. Exact LRU keeps the keys in a list, most
+ * recently used first, at the price of touching the neighbouring nodes on
+ * every hit.
+ */
+typedef struct CacheEntry {
+	size_t cost;
+	union {
+		ListNode *node;
+		size_t access;
+	};
+	uint8_t counter;
+	uint16_t access_time;
+} CacheEntry;
+
+struct Cache {
+	HashTable *table;
+	List *list;
+	size_t capacity;
+	size_t used;
+	int policy;
+	size_t clock;
+	uint16_t lfu_time;
+	size_t random;
+
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	size_t (*cost)(void *, void *);
+};
+
+Cache *cacheCreate(void *(*alloc)(size_t), void (*dealloc)(void *),
+		   size_t capacity, int policy)
+{
+	Cache *cache = alloc(sizeof(Cache));
+	memset(cache, 0, sizeof(Cache));
+	cache->alloc = alloc;
+	cache->dealloc = dealloc;
+	cache->capacity = capacity;
+	cache->policy = policy;
+	cache->random = hashRandomSeed() | 1;
+
+	cache->table =
+	    hashTableCreateWithEntryData(alloc, dealloc, sizeof(CacheEntry));
+	if (policy == CACHE_POLICY_EXACT_LRU) {
+		cache->list = listCreatePooled(alloc, dealloc);
+	}
+
+	return cache;
+}
+
+void cacheSetHashMethod(Cache *cache, size_t (*hash)(void *))
+{
+	setHashMethod(cache->table, hash);
+}
+
+void cacheSetSeededHashMethod(Cache *cache, size_t (*hash)(void *, size_t))
+{
+	setSeededHashMethod(cache->table, hash);
+}
+
+void cacheSetCompareMethod(Cache *cache, int (*compare)(void *, void *))
+{
+	setCompareMethod(cache->table, compare);
+}
+
+void cacheSetFreeKeyMethod(Cache *cache, void (*free_key)(void *))
+{
+	setFreeKeyMethod(cache->table, free_key);
+}
+
+void cacheSetFreeValueMethod(Cache *cache, void (*free_value)(void *))
+{
+	setFreeValueMethod(cache->table, free_value);
+}
+
+/* without a cost method every entry costs 1 and capacity counts entries */
+void cacheSetCostMethod(Cache *cache, size_t (*cost)(void *, void *))
+{
+	cache->cost = cost;
+}
+
+int cacheGetPolicy(Cache *cache) { return cache->policy; }
+
+size_t cacheGetCapacity(Cache *cache) { return cache->capacity; }
+
+size_t cacheSize(Cache *cache) { return hashTableSize(cache->table); }
+
+size_t cacheCost(Cache *cache) { return cache->used; }
+
+static uint16_t cacheLFUTime(Cache *cache)
+{
+	if (cache->clock % LFU_CLOCK_INTERVAL == 0) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+		cache->lfu_time = ts.tv_sec / LFU_DECAY_SECONDS;
+	}
+
+	return cache->lfu_time;
+}
+
+static double cacheRandom(Cache *cache)
+{
+	size_t x = cache->random;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	cache->random = x;
+	return (double)(x >> 11) / (double)(1ULL << 53);
+}
+
+static void cacheLFUDecay(CacheEntry *entry, uint16_t now)
+{
+	uint16_t periods = now - entry->access_time;
+	if (periods == 0) {
+		return;
+	}
+
+	entry->counter =
+	    periods > entry->counter ? 0 : entry->counter - periods;
+	entry->access_time = now;
+}
+
+/* the higher the counter the less likely an access increments it */
+static void cacheLFUIncrement(Cache *cache, CacheEntry *entry)
+{
+	if (entry->counter == UINT8_MAX) {
+		return;
+	}
+
+	double base = entry->counter > LFU_INIT_VAL
+			  ? entry->counter - LFU_INIT_VAL
+			  : 0;
+	if (cacheRandom(cache) < 1.0 / (base * LFU_LOG_FACTOR + 1)) {
+		++entry->counter;
+	}
+}
+
+static inline void cacheTouch(Cache *cache, CacheEntry *entry)
+{
+	++cache->clock;
+	switch (cache->policy) {
+	case CACHE_POLICY_LRU:
+		entry->access = cache->clock;
+		break;
+	case CACHE_POLICY_LFU:
+		cacheLFUDecay(entry, cacheLFUTime(cache));
+		cacheLFUIncrement(cache, entry);
+		break;
+	case CACHE_POLICY_EXACT_LRU:
+		listMoveToHead(cache->list, entry->node);
+		break;
+	}
+}
+
+static size_t cacheEntryCost(Cache *cache, void *key, void *value)
+{
+	return cache->cost != NULL ? cache->cost(key, value) : 1;
+}
+
+/* must run before the entry leaves the table, which frees its data */
+static void cacheUnlink(Cache *cache, CacheEntry *entry)
+{
+	if (cache->policy == CACHE_POLICY_EXACT_LRU) {
+		listRemoveNode(cache->list, entry->node);
+	}
+
+	cache->used -= entry->cost;
+}
+
+static void *cacheVictim(Cache *cache, CacheEntry **entry_ptr)
+{
+	if (cache->policy == CACHE_POLICY_EXACT_LRU) {
+		void *key = listNodeValue(listTail(cache->list));
+		hashTableGetWithData(cache->table, key, (void **)entry_ptr);
+		return key;
+	}
+
+	/* a sparse or rehashing table may yield no sample, just retry */
+	void *keys[EVICTION_SAMPLES];
+	CacheEntry *samples[EVICTION_SAMPLES];
+	size_t n;
+	do {
+		n = hashTableSampleWithData(cache->table, EVICTION_SAMPLES,
+					    keys, NULL, (void **)samples);
+	} while (n == 0);
+
+	uint16_t now = cacheLFUTime(cache);
+	size_t victim = 0;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		if (cache->policy == CACHE_POLICY_LRU) {
+			if (samples[i]->access < samples[victim]->access) {
+				victim = i;
+			}
+
+			continue;
+		}
+
+		cacheLFUDecay(samples[i], now);
+		if (samples[i]->counter < samples[victim]->counter) {
+			victim = i;
+		}
+	}
+
+	*entry_ptr = samples[victim];
+	return keys[victim];
+}
+
+static void cacheEvict(Cache *cache)
+{
+	CacheEntry *entry;
+	void *key;
+	while (cache->used > cache->capacity &&
+	       hashTableSize(cache->table) > 0) {
+		key = cacheVictim(cache, &entry);
+		cacheUnlink(cache, entry);
+		hashTableDel(cache->table, key);
+	}
+}
+
+void cacheSetCapacity(Cache *cache, size_t capacity)
+{
+	cache->capacity = capacity;
+	cacheEvict(cache);
+}
+
+int cacheContains(Cache *cache, void *key)
+{
+	void *entry;
+	hashTableGetWithData(cache->table, key, &entry);
+	return entry != NULL;
+}
+
+void *cacheGet(Cache *cache, void *key)
+{
+	CacheEntry *entry;
+	void *value = hashTableGetWithData(cache->table, key, (void **)&entry);
+	if (entry != NULL) {
+		cacheTouch(cache, entry);
+	}
+
+	return value;
+}
+
+void *cachePeek(Cache *cache, void *key)
+{
+	return hashTableGet(cache->table, key);
+}
+
+/* an existing key keeps its stored key and only gets the new value */
+void cacheSet(Cache *cache, void *key, void *value)
+{
+	size_t size = hashTableSize(cache->table);
+	CacheEntry *entry = hashTableSetWithData(cache->table, key, value);
+	if (hashTableSize(cache->table) == size) {
+		cache->used -= entry->cost;
+		entry->cost = cacheEntryCost(cache, key, value);
+		cache->used += entry->cost;
+		cacheTouch(cache, entry);
+		cacheEvict(cache);
+		return;
+	}
+
+	entry->cost = cacheEntryCost(cache, key, value);
+	entry->access = ++cache->clock;
+	entry->counter = LFU_INIT_VAL;
+	entry->access_time = cacheLFUTime(cache);
+	if (cache->policy == CACHE_POLICY_EXACT_LRU) {
+		entry->node = listPushHead(cache->list, key);
+	}
+
+	cache->used += entry->cost;
+	cacheEvict(cache);
+}
+
+void *cacheRemove(Cache *cache, void *key)
+{
+	CacheEntry *entry;
+	hashTableGetWithData(cache->table, key, (void **)&entry);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	cacheUnlink(cache, entry);
+	return hashTableRemove(cache->table, key);
+}
+
+void cacheDel(Cache *cache, void *key)
+{
+	CacheEntry *entry;
+	hashTableGetWithData(cache->table, key, (void **)&entry);
+	if (entry == NULL) {
+		return;
+	}
+
+	cacheUnlink(cache, entry);
+	hashTableDel(cache->table, key);
+}
+
+void cacheClear(Cache *cache)
+{
+	hashTableClear(cache->table);
+	if (cache->list != NULL) {
+		listClear(cache->list);
+	}
+
+	cache->used = 0;
+}
+
+void cacheDestroy(Cache *cache)
+{
+	hashTableDestroy(cache->table);
+	if (cache->list != NULL) {
+		listDestroy(cache->list);
+	}
+
+	cache->dealloc(cache);
+}
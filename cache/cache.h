@@ -0,0 +1,34 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+#define CACHE_POLICY_LRU 0
+#define CACHE_POLICY_LFU 1
+#define CACHE_POLICY_EXACT_LRU 2
+
+typedef struct Cache Cache;
+
+Cache *cacheCreate(void *(*alloc)(size_t), void (*dealloc)(void *),
+		   size_t capacity, int policy);
+void cacheSetHashMethod(Cache *cache, size_t (*hash)(void *));
+void cacheSetSeededHashMethod(Cache *cache, size_t (*hash)(void *, size_t));
+void cacheSetCompareMethod(Cache *cache, int (*compare)(void *, void *));
+void cacheSetFreeKeyMethod(Cache *cache, void (*free_key)(void *));
+void cacheSetFreeValueMethod(Cache *cache, void (*free_value)(void *));
+void cacheSetCostMethod(Cache *cache, size_t (*cost)(void *, void *));
+int cacheGetPolicy(Cache *cache);
+size_t cacheGetCapacity(Cache *cache);
+void cacheSetCapacity(Cache *cache, size_t capacity);
+size_t cacheSize(Cache *cache);
+size_t cacheCost(Cache *cache);
+int cacheContains(Cache *cache, void *key);
+void *cacheGet(Cache *cache, void *key);
+void *cachePeek(Cache *cache, void *key);
+void cacheSet(Cache *cache, void *key, void *value);
+void *cacheRemove(Cache *cache, void *key);
+void cacheDel(Cache *cache, void *key);
+void cacheClear(Cache *cache);
+void cacheDestroy(Cache *cache);
+
+#endif
@@ -0,0 +1,316 @@
+#include "concurrenthashtable.h"
+#include "hashtable.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+
+/* 2^64 / golden ratio, truncated on 32-bit targets */
+#define SHARD_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+/*
+ * Every shard is a HashTable with its own incremental rehash. Shards are
+ * line aligned and padded to whole lines, so neighbouring locks never
+ * share a cache line.
+ */
+typedef struct Shard {
+	_Alignas(CACHE_LINE_SIZE) pthread_rwlock_t lock;
+	HashTable *table;
+} Shard;
+
+struct ConcurrentHashTable {
+	Shard *shards;
+	/* what alloc returned, shards is rounded up to a line boundary */
+	void *shards_block;
+	/* shard_count always equals to 2^n */
+	size_t shard_count;
+	int shard_shift;
+
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	size_t (*hash)(void *);
+	int (*compare)(void *, void *);
+	void (*free_key)(void *);
+	void (*free_value)(void *);
+};
+
+/*
+ * The iterator holds the read lock of the shard it is walking, so the
+ * iterating thread must not write to the table until it is destroyed.
+ */
+struct ConcurrentHashTableIter {
+	ConcurrentHashTable *table;
+	size_t shard_idx;
+	HashTableIter *iter;
+	void (*dealloc)(void *);
+};
+
+ConcurrentHashTable *concurrentHashTableCreate(void *(*alloc)(size_t),
+					       void (*dealloc)(void *),
+					       size_t shards)
+{
+	ConcurrentHashTable *htable = alloc(sizeof(ConcurrentHashTable));
+	memset(htable, 0, sizeof(ConcurrentHashTable));
+	htable->alloc = alloc;
+	htable->dealloc = dealloc;
+
+	htable->shard_count = 1;
+	htable->shard_shift = sizeof(size_t) * 8;
+	while (htable->shard_count < shards) {
+		htable->shard_count <<= 1;
+		--htable->shard_shift;
+	}
+
+	htable->shards_block =
+	    alloc(sizeof(Shard) * htable->shard_count + CACHE_LINE_SIZE - 1);
+	htable->shards =
+	    (Shard *)(((uintptr_t)htable->shards_block + CACHE_LINE_SIZE - 1) &
+		      ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		pthread_rwlock_init(&htable->shards[i].lock, NULL);
+		htable->shards[i].table = hashTableCreate(alloc, dealloc);
+	}
+
+	return htable;
+}
+
+size_t (*concurrentHashTableGetHashMethod(ConcurrentHashTable *htable))(void *)
+{
+	return htable->hash;
+}
+
+void concurrentHashTableSetHashMethod(ConcurrentHashTable *htable,
+				      size_t (*hash)(void *))
+{
+	htable->hash = hash;
+
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		setHashMethod(htable->shards[i].table, hash);
+	}
+}
+
+int (*concurrentHashTableGetCompareMethod(ConcurrentHashTable *htable))(void *,
+									 void *)
+{
+	return htable->compare;
+}
+
+void concurrentHashTableSetCompareMethod(ConcurrentHashTable *htable,
+					 int (*compare)(void *, void *))
+{
+	htable->compare = compare;
+
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		setCompareMethod(htable->shards[i].table, compare);
+	}
+}
+
+void (*concurrentHashTableGetFreeKeyMethod(ConcurrentHashTable *htable))(void *)
+{
+	return htable->free_key;
+}
+
+void concurrentHashTableSetFreeKeyMethod(ConcurrentHashTable *htable,
+					 void (*free_key)(void *))
+{
+	htable->free_key = free_key;
+
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		setFreeKeyMethod(htable->shards[i].table, free_key);
+	}
+}
+
+void (*concurrentHashTableGetFreeValueMethod(ConcurrentHashTable *htable))(
+    void *)
+{
+	return htable->free_value;
+}
+
+void concurrentHashTableSetFreeValueMethod(ConcurrentHashTable *htable,
+					   void (*free_value)(void *))
+{
+	htable->free_value = free_value;
+
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		setFreeValueMethod(htable->shards[i].table, free_value);
+	}
+}
+
+size_t concurrentHashTableShards(ConcurrentHashTable *htable)
+{
+	return htable->shard_count;
+}
+
+/*
+ * HashTable picks buckets from the low bits of the hash. Shards take the
+ * high bits of the hash times an odd constant, which depend on every bit
+ * of the hash, so identity and 32-bit hashes still spread over shards.
+ */
+static Shard *concurrentHashTableGetShard(ConcurrentHashTable *htable,
+					  size_t hash)
+{
+	if (htable->shard_count == 1) {
+		return htable->shards;
+	}
+
+	hash *= (size_t)SHARD_HASH_MULTIPLIER;
+	return htable->shards + (hash >> htable->shard_shift);
+}
+
+size_t concurrentHashTableSize(ConcurrentHashTable *htable)
+{
+	size_t size = 0;
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		pthread_rwlock_rdlock(&htable->shards[i].lock);
+	}
+
+	for (i = 0; i < htable->shard_count; ++i) {
+		size += hashTableSize(htable->shards[i].table);
+	}
+
+	for (i = 0; i < htable->shard_count; ++i) {
+		pthread_rwlock_unlock(&htable->shards[i].lock);
+	}
+
+	return size;
+}
+
+int concurrentHashTableContains(ConcurrentHashTable *htable, void *key)
+{
+	return concurrentHashTableGet(htable, key) != NULL;
+}
+
+void concurrentHashTableSet(ConcurrentHashTable *htable, void *key,
+			    void *value)
+{
+	size_t hash = htable->hash(key);
+	Shard *shard = concurrentHashTableGetShard(htable, hash);
+	pthread_rwlock_wrlock(&shard->lock);
+	hashTableSetWithHash(shard->table, key, value, hash);
+	pthread_rwlock_unlock(&shard->lock);
+}
+
+void *concurrentHashTableGet(ConcurrentHashTable *htable, void *key)
+{
+	size_t hash = htable->hash(key);
+	Shard *shard = concurrentHashTableGetShard(htable, hash);
+	pthread_rwlock_rdlock(&shard->lock);
+	void *value = hashTableGetWithHash(shard->table, key, hash);
+	pthread_rwlock_unlock(&shard->lock);
+	return value;
+}
+
+void *concurrentHashTableRemove(ConcurrentHashTable *htable, void *key)
+{
+	size_t hash = htable->hash(key);
+	Shard *shard = concurrentHashTableGetShard(htable, hash);
+	pthread_rwlock_wrlock(&shard->lock);
+	void *value = hashTableRemoveWithHash(shard->table, key, hash);
+	pthread_rwlock_unlock(&shard->lock);
+	return value;
+}
+
+void concurrentHashTableDel(ConcurrentHashTable *htable, void *key)
+{
+	size_t hash = htable->hash(key);
+	Shard *shard = concurrentHashTableGetShard(htable, hash);
+	pthread_rwlock_wrlock(&shard->lock);
+	hashTableDelWithHash(shard->table, key, hash);
+	pthread_rwlock_unlock(&shard->lock);
+}
+
+void concurrentHashTableClear(ConcurrentHashTable *htable)
+{
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		pthread_rwlock_wrlock(&htable->shards[i].lock);
+	}
+
+	for (i = 0; i < htable->shard_count; ++i) {
+		hashTableClear(htable->shards[i].table);
+	}
+
+	for (i = 0; i < htable->shard_count; ++i) {
+		pthread_rwlock_unlock(&htable->shards[i].lock);
+	}
+}
+
+void concurrentHashTableDestroy(ConcurrentHashTable *htable)
+{
+	size_t i;
+	for (i = 0; i < htable->shard_count; ++i) {
+		hashTableDestroy(htable->shards[i].table);
+		pthread_rwlock_destroy(&htable->shards[i].lock);
+	}
+
+	htable->dealloc(htable->shards_block);
+	htable->dealloc(htable);
+}
+
+static ConcurrentHashTableIter *
+concurrentHashTableIterSeek(ConcurrentHashTableIter *iter)
+{
+	ConcurrentHashTable *htable = iter->table;
+	while (iter->iter == NULL || !hashTableIterHasNext(iter->iter)) {
+		if (iter->iter != NULL) {
+			hashTableIterDestroy(iter->iter);
+			iter->iter = NULL;
+			Shard *shard = htable->shards + iter->shard_idx++;
+			pthread_rwlock_unlock(&shard->lock);
+		}
+
+		if (iter->shard_idx == htable->shard_count) {
+			break;
+		}
+
+		Shard *shard = htable->shards + iter->shard_idx;
+		pthread_rwlock_rdlock(&shard->lock);
+		iter->iter = hashTableIterator(shard->table);
+	}
+
+	return iter;
+}
+
+ConcurrentHashTableIter *concurrentHashTableIterator(
+    ConcurrentHashTable *htable)
+{
+	ConcurrentHashTableIter *iter =
+	    htable->alloc(sizeof(ConcurrentHashTableIter));
+	iter->table = htable;
+	iter->shard_idx = 0;
+	iter->iter = NULL;
+	iter->dealloc = htable->dealloc;
+	return concurrentHashTableIterSeek(iter);
+}
+
+int concurrentHashTableIterHasNext(ConcurrentHashTableIter *iter)
+{
+	return iter->iter != NULL;
+}
+
+void concurrentHashTableIterNext(ConcurrentHashTableIter *iter, void **key_ptr,
+				 void **value_ptr)
+{
+	hashTableIterNext(iter->iter, key_ptr, value_ptr);
+	concurrentHashTableIterSeek(iter);
+}
+
+void concurrentHashTableIterDestroy(ConcurrentHashTableIter *iter)
+{
+	if (iter->iter != NULL) {
+		hashTableIterDestroy(iter->iter);
+		Shard *shard = iter->table->shards + iter->shard_idx;
+		pthread_rwlock_unlock(&shard->lock);
+	}
+
+	iter->dealloc(iter);
+}
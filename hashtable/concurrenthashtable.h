@@ -0,0 +1,45 @@
+#ifndef CONCURRENTHASHTABLE_H
+#define CONCURRENTHASHTABLE_H
+
+#include <stddef.h>
+
+typedef struct ConcurrentHashTable ConcurrentHashTable;
+typedef struct ConcurrentHashTableIter ConcurrentHashTableIter;
+
+ConcurrentHashTable *concurrentHashTableCreate(void *(*alloc)(size_t),
+					       void (*dealloc)(void *),
+					       size_t shards);
+size_t (*concurrentHashTableGetHashMethod(ConcurrentHashTable *htable))(void *);
+void concurrentHashTableSetHashMethod(ConcurrentHashTable *htable,
+				      size_t (*hash)(void *));
+int (*concurrentHashTableGetCompareMethod(ConcurrentHashTable *htable))(
+    void *, void *);
+void concurrentHashTableSetCompareMethod(ConcurrentHashTable *htable,
+					 int (*compare)(void *, void *));
+void (*concurrentHashTableGetFreeKeyMethod(ConcurrentHashTable *htable))(
+    void *);
+void concurrentHashTableSetFreeKeyMethod(ConcurrentHashTable *htable,
+					 void (*free_key)(void *));
+void (*concurrentHashTableGetFreeValueMethod(ConcurrentHashTable *htable))(
+    void *);
+void concurrentHashTableSetFreeValueMethod(ConcurrentHashTable *htable,
+					   void (*free_value)(void *));
+size_t concurrentHashTableShards(ConcurrentHashTable *htable);
+size_t concurrentHashTableSize(ConcurrentHashTable *htable);
+int concurrentHashTableContains(ConcurrentHashTable *htable, void *key);
+void concurrentHashTableSet(ConcurrentHashTable *htable, void *key,
+			    void *value);
+void *concurrentHashTableGet(ConcurrentHashTable *htable, void *key);
+void *concurrentHashTableRemove(ConcurrentHashTable *htable, void *key);
+void concurrentHashTableDel(ConcurrentHashTable *htable, void *key);
+void concurrentHashTableClear(ConcurrentHashTable *htable);
+void concurrentHashTableDestroy(ConcurrentHashTable *htable);
+ConcurrentHashTableIter *concurrentHashTableIterator(
+    ConcurrentHashTable *htable);
+
+int concurrentHashTableIterHasNext(ConcurrentHashTableIter *iter);
+void concurrentHashTableIterNext(ConcurrentHashTableIter *iter, void **key_ptr,
+				 void **value_ptr);
+void concurrentHashTableIterDestroy(ConcurrentHashTableIter *iter);
+
+#endif
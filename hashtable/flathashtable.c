@@ -0,0 +1,428 @@
+#include "flathashtable.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16
+
+#define CTRL_EMPTY ((signed char)0x80)
+#define CTRL_DELETED ((signed char)0xFE)
+
+#define MIN_TABLE_SIZE 16
+#define SHRINK_THRESHOLD 0.1
+
+#define NOT_FOUND ((size_t)-1)
+
+/* slots in use (including tombstones) never exceed 7/8 of the capacity */
+#define MAX_LOAD(capacity) ((capacity) / 8 * 7)
+
+#define hashGroup(hash) ((hash) >> 7)
+#define hashTag(hash) ((signed char)((hash)&0x7F))
+
+typedef struct FlatSlot {
+	void *key;
+	void *value;
+} FlatSlot;
+
+struct FlatHashTable {
+	/*
+	 * one control byte per slot: a 7-bit hash tag for full slots,
+	 * CTRL_EMPTY or CTRL_DELETED otherwise
+	 */
+	signed char *ctrl;
+	FlatSlot *slots;
+	/* capacity always equals to 2^n and is a multiple of GROUP_WIDTH */
+	size_t capacity;
+	size_t count;
+	size_t deleted;
+
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	size_t (*hash)(void *);
+	int (*compare)(void *, void *);
+	void (*free_key)(void *);
+	void (*free_value)(void *);
+};
+
+struct FlatHashTableIter {
+	FlatHashTable *table;
+	size_t next;
+	void (*dealloc)(void *);
+};
+
+#ifdef __SSE2__
+static inline unsigned groupMatch(const signed char *group, signed char tag)
+{
+	__m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl));
+}
+
+/* both CTRL_EMPTY and CTRL_DELETED have the sign bit set */
+static inline unsigned groupMatchFree(const signed char *group)
+{
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+#else
+static inline unsigned groupMatch(const signed char *group, signed char tag)
+{
+	unsigned mask = 0;
+	int i;
+	for (i = 0; i < GROUP_WIDTH; ++i) {
+		mask |= (unsigned)(group[i] == tag) << i;
+	}
+
+	return mask;
+}
+
+static inline unsigned groupMatchFree(const signed char *group)
+{
+	unsigned mask = 0;
+	int i;
+	for (i = 0; i < GROUP_WIDTH; ++i) {
+		mask |= (unsigned)(group[i] < 0) << i;
+	}
+
+	return mask;
+}
+#endif
+
+#define groupMatchEmpty(group) groupMatch((group), CTRL_EMPTY)
+
+FlatHashTable *flatHashTableCreate(void *(*alloc)(size_t),
+				   void (*dealloc)(void *))
+{
+	FlatHashTable *htable = alloc(sizeof(FlatHashTable));
+	memset(htable, 0, sizeof(FlatHashTable));
+	htable->alloc = alloc;
+	htable->dealloc = dealloc;
+	return htable;
+}
+
+size_t (*flatHashTableGetHashMethod(FlatHashTable *htable))(void *)
+{
+	return htable->hash;
+}
+
+void flatHashTableSetHashMethod(FlatHashTable *htable, size_t (*hash)(void *))
+{
+	htable->hash = hash;
+}
+
+int (*flatHashTableGetCompareMethod(FlatHashTable *htable))(void *, void *)
+{
+	return htable->compare;
+}
+
+void flatHashTableSetCompareMethod(FlatHashTable *htable,
+				   int (*compare)(void *, void *))
+{
+	htable->compare = compare;
+}
+
+void (*flatHashTableGetFreeKeyMethod(FlatHashTable *htable))(void *)
+{
+	return htable->free_key;
+}
+
+void flatHashTableSetFreeKeyMethod(FlatHashTable *htable,
+				   void (*free_key)(void *))
+{
+	htable->free_key = free_key;
+}
+
+void (*flatHashTableGetFreeValueMethod(FlatHashTable *htable))(void *)
+{
+	return htable->free_value;
+}
+
+void flatHashTableSetFreeValueMethod(FlatHashTable *htable,
+				     void (*free_value)(void *))
+{
+	htable->free_value = free_value;
+}
+
+size_t flatHashTableSize(FlatHashTable *htable) { return htable->count; }
+
+static size_t flatHashTableFind(FlatHashTable *htable, void *key, size_t hash)
+{
+	if (htable->capacity == 0) {
+		return NOT_FOUND;
+	}
+
+	size_t mask = htable->capacity / GROUP_WIDTH - 1;
+	size_t group = hashGroup(hash) & mask;
+	signed char tag = hashTag(hash);
+	size_t step = 0;
+	for (;;) {
+		const signed char *ctrl = htable->ctrl + group * GROUP_WIDTH;
+		unsigned match = groupMatch(ctrl, tag);
+		while (match != 0) {
+			size_t slot = group * GROUP_WIDTH;
+			slot += __builtin_ctz(match);
+			void *candidate = htable->slots[slot].key;
+			if (htable->compare(candidate, key) == 0) {
+				return slot;
+			}
+
+			match &= match - 1;
+		}
+
+		if (groupMatchEmpty(ctrl) != 0) {
+			return NOT_FOUND;
+		}
+
+		group = (group + ++step) & mask;
+	}
+}
+
+static size_t flatHashTableFindFree(FlatHashTable *htable, size_t hash)
+{
+	size_t mask = htable->capacity / GROUP_WIDTH - 1;
+	size_t group = hashGroup(hash) & mask;
+	size_t step = 0;
+	unsigned match;
+	while ((match = groupMatchFree(htable->ctrl + group * GROUP_WIDTH)) ==
+	       0) {
+		group = (group + ++step) & mask;
+	}
+
+	return group * GROUP_WIDTH + __builtin_ctz(match);
+}
+
+static FlatHashTable *flatHashTableResize(FlatHashTable *htable,
+					  size_t capacity)
+{
+	signed char *ctrl = htable->ctrl;
+	FlatSlot *slots = htable->slots;
+	size_t old_capacity = htable->capacity;
+
+	htable->slots =
+	    htable->alloc((sizeof(FlatSlot) + sizeof(signed char)) * capacity);
+	htable->ctrl = (signed char *)(htable->slots + capacity);
+	memset(htable->ctrl, CTRL_EMPTY, capacity);
+	htable->capacity = capacity;
+	htable->deleted = 0;
+
+	size_t i;
+	size_t slot;
+	size_t hash;
+	for (i = 0; i < old_capacity; ++i) {
+		if (ctrl[i] < 0) {
+			continue;
+		}
+
+		hash = htable->hash(slots[i].key);
+		slot = flatHashTableFindFree(htable, hash);
+		htable->ctrl[slot] = hashTag(hash);
+		htable->slots[slot] = slots[i];
+	}
+
+	if (slots != NULL) {
+		htable->dealloc(slots);
+	}
+
+	return htable;
+}
+
+static size_t flatHashTableFitCapacity(size_t count)
+{
+	size_t capacity = MIN_TABLE_SIZE;
+	while (MAX_LOAD(capacity) / 2 < count) {
+		capacity <<= 1;
+	}
+
+	return capacity;
+}
+
+void flatHashTableSet(FlatHashTable *htable, void *key, void *value)
+{
+	size_t hash = htable->hash(key);
+	size_t slot = flatHashTableFind(htable, key, hash);
+	if (slot != NOT_FOUND) {
+		if (htable->free_value != NULL) {
+			htable->free_value(htable->slots[slot].value);
+		}
+
+		htable->slots[slot].value = value;
+		return;
+	}
+
+	if (htable->count + htable->deleted + 1 > MAX_LOAD(htable->capacity)) {
+		/* drop tombstones in place unless live slots need more room */
+		size_t capacity = htable->capacity;
+		if (capacity == 0) {
+			capacity = MIN_TABLE_SIZE;
+		} else if (htable->count >= MAX_LOAD(capacity) / 2) {
+			capacity <<= 1;
+		}
+
+		flatHashTableResize(htable, capacity);
+	}
+
+	slot = flatHashTableFindFree(htable, hash);
+	if (htable->ctrl[slot] == CTRL_DELETED) {
+		--htable->deleted;
+	}
+
+	htable->ctrl[slot] = hashTag(hash);
+	htable->slots[slot].key = key;
+	htable->slots[slot].value = value;
+	++htable->count;
+}
+
+void *flatHashTableGet(FlatHashTable *htable, void *key)
+{
+	if (htable->count == 0) {
+		return NULL;
+	}
+
+	size_t slot = flatHashTableFind(htable, key, htable->hash(key));
+	if (slot == NOT_FOUND) {
+		return NULL;
+	}
+
+	return htable->slots[slot].value;
+}
+
+int flatHashTableContains(FlatHashTable *htable, void *key)
+{
+	if (htable->count == 0) {
+		return 0;
+	}
+
+	return flatHashTableFind(htable, key, htable->hash(key)) != NOT_FOUND;
+}
+
+void *flatHashTableRemove(FlatHashTable *htable, void *key)
+{
+	if (htable->count == 0) {
+		return NULL;
+	}
+
+	size_t slot = flatHashTableFind(htable, key, htable->hash(key));
+	if (slot == NOT_FOUND) {
+		return NULL;
+	}
+
+	void *value = htable->slots[slot].value;
+	if (htable->free_key != NULL) {
+		htable->free_key(htable->slots[slot].key);
+	}
+
+	/*
+	 * a probe only moves past a group that has no empty slot, so the
+	 * slot can go straight back to empty if its group still has one
+	 */
+	const signed char *group =
+	    htable->ctrl + slot / GROUP_WIDTH * GROUP_WIDTH;
+	if (groupMatchEmpty(group) != 0) {
+		htable->ctrl[slot] = CTRL_EMPTY;
+	} else {
+		htable->ctrl[slot] = CTRL_DELETED;
+		++htable->deleted;
+	}
+
+	--htable->count;
+
+	if (htable->capacity > MIN_TABLE_SIZE &&
+	    (double)htable->count / htable->capacity < SHRINK_THRESHOLD) {
+		size_t capacity = flatHashTableFitCapacity(htable->count);
+		if (capacity < htable->capacity) {
+			flatHashTableResize(htable, capacity);
+		}
+	}
+
+	return value;
+}
+
+void flatHashTableDel(FlatHashTable *htable, void *key)
+{
+	void *value = flatHashTableRemove(htable, key);
+	if (value != NULL && htable->free_value != NULL) {
+		htable->free_value(value);
+	}
+}
+
+void flatHashTableClear(FlatHashTable *htable)
+{
+	if (htable->slots == NULL) {
+		return;
+	}
+
+	size_t i;
+	for (i = 0; i < htable->capacity; ++i) {
+		if (htable->ctrl[i] < 0) {
+			continue;
+		}
+
+		if (htable->free_key != NULL) {
+			htable->free_key(htable->slots[i].key);
+		}
+
+		if (htable->free_value != NULL) {
+			htable->free_value(htable->slots[i].value);
+		}
+	}
+
+	htable->dealloc(htable->slots);
+	htable->slots = NULL;
+	htable->ctrl = NULL;
+	htable->capacity = 0;
+	htable->count = 0;
+	htable->deleted = 0;
+}
+
+void flatHashTableDestroy(FlatHashTable *htable)
+{
+	flatHashTableClear(htable);
+	htable->dealloc(htable);
+}
+
+static FlatHashTableIter *flatHashTableIterSeek(FlatHashTableIter *iter)
+{
+	FlatHashTable *htable = iter->table;
+	while (iter->next < htable->capacity && htable->ctrl[iter->next] < 0) {
+		if (iter->next % GROUP_WIDTH == 0) {
+			const signed char *group = htable->ctrl + iter->next;
+			if (groupMatchFree(group) == 0xFFFF) {
+				iter->next += GROUP_WIDTH;
+				continue;
+			}
+		}
+
+		++iter->next;
+	}
+
+	return iter;
+}
+
+FlatHashTableIter *flatHashTableIterator(FlatHashTable *htable)
+{
+	FlatHashTableIter *iter = htable->alloc(sizeof(FlatHashTableIter));
+	iter->table = htable;
+	iter->next = 0;
+	iter->dealloc = htable->dealloc;
+	return flatHashTableIterSeek(iter);
+}
+
+int flatHashTableIterHasNext(FlatHashTableIter *iter)
+{
+	return iter->next < iter->table->capacity;
+}
+
+void flatHashTableIterNext(FlatHashTableIter *iter, void **key_ptr,
+			   void **value_ptr)
+{
+	FlatSlot *slot = iter->table->slots + iter->next;
+	*key_ptr = slot->key;
+	*value_ptr = slot->value;
+
+	++iter->next;
+	flatHashTableIterSeek(iter);
+}
+
+void flatHashTableIterDestroy(FlatHashTableIter *iter) { iter->dealloc(iter); }
@@ -0,0 +1,37 @@
+#ifndef FLATHASHTABLE_H
+#define FLATHASHTABLE_H
+
+#include <stddef.h>
+
+typedef struct FlatHashTable FlatHashTable;
+typedef struct FlatHashTableIter FlatHashTableIter;
+
+FlatHashTable *flatHashTableCreate(void *(*alloc)(size_t),
+				   void (*dealloc)(void *));
+size_t (*flatHashTableGetHashMethod(FlatHashTable *htable))(void *);
+void flatHashTableSetHashMethod(FlatHashTable *htable, size_t (*hash)(void *));
+int (*flatHashTableGetCompareMethod(FlatHashTable *htable))(void *, void *);
+void flatHashTableSetCompareMethod(FlatHashTable *htable,
+				   int (*compare)(void *, void *));
+void (*flatHashTableGetFreeKeyMethod(FlatHashTable *htable))(void *);
+void flatHashTableSetFreeKeyMethod(FlatHashTable *htable,
+				   void (*free_key)(void *));
+void (*flatHashTableGetFreeValueMethod(FlatHashTable *htable))(void *);
+void flatHashTableSetFreeValueMethod(FlatHashTable *htable,
+				     void (*free_value)(void *));
+size_t flatHashTableSize(FlatHashTable *htable);
+int flatHashTableContains(FlatHashTable *htable, void *key);
+void flatHashTableSet(FlatHashTable *htable, void *key, void *value);
+void *flatHashTableGet(FlatHashTable *htable, void *key);
+void *flatHashTableRemove(FlatHashTable *htable, void *key);
+void flatHashTableDel(FlatHashTable *htable, void *key);
+void flatHashTableClear(FlatHashTable *htable);
+void flatHashTableDestroy(FlatHashTable *htable);
+FlatHashTableIter *flatHashTableIterator(FlatHashTable *htable);
+
+int flatHashTableIterHasNext(FlatHashTableIter *iter);
+void flatHashTableIterNext(FlatHashTableIter *iter, void **key_ptr,
+			   void **value_ptr);
+void flatHashTableIterDestroy(FlatHashTableIter *iter);
+
+#endif
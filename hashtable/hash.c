@@ -0,0 +1,146 @@
+#include "hash.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* wyhash (public domain, Wang Yi) default secret */
+#define SECRET0 0xa0761d6478bd642fULL
+#define SECRET1 0xe7037ed1a0b428dbULL
+#define SECRET2 0x8ebc6af09c88c6e3ULL
+#define SECRET3 0x589965cc75374cc3ULL
+
+static inline void mum(uint64_t *a, uint64_t *b)
+{
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+	mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t read3(const uint8_t *p, size_t len)
+{
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+	       p[len - 1];
+}
+
+size_t hashRandomSeed(void)
+{
+	static uint64_t counter;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	uint64_t x = __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+	x = mix(x ^ SECRET0, (uint64_t)(uintptr_t)&ts ^ SECRET1);
+	x = mix(x ^ (uint64_t)time(NULL), (uint64_t)ts.tv_nsec ^ SECRET2);
+	return x;
+}
+
+uint64_t hashMix64(uint64_t x, uint64_t seed)
+{
+	uint64_t a = x ^ SECRET0;
+	uint64_t b = seed ^ SECRET1;
+	mum(&a, &b);
+	return mix(a ^ SECRET0, b ^ SECRET1);
+}
+
+size_t hashBytes(const void *data, size_t len, size_t seed)
+{
+	const uint8_t *p = data;
+	uint64_t a;
+	uint64_t b;
+	uint64_t s = seed ^ mix(seed ^ SECRET0, SECRET1);
+
+	if (len <= 16) {
+		if (len >= 4) {
+			a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+			b = (read32(p + len - 4) << 32) |
+			    read32(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = read3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+		if (i > 48) {
+			uint64_t s1 = s;
+			uint64_t s2 = s;
+			do {
+				s = mix(read64(p) ^ SECRET1, read64(p + 8) ^ s);
+				s1 = mix(read64(p + 16) ^ SECRET2,
+					 read64(p + 24) ^ s1);
+				s2 = mix(read64(p + 32) ^ SECRET3,
+					 read64(p + 40) ^ s2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			s ^= s1 ^ s2;
+		}
+
+		while (i > 16) {
+			s = mix(read64(p) ^ SECRET1, read64(p + 8) ^ s);
+			i -= 16;
+			p += 16;
+		}
+
+		a = read64(p + i - 16);
+		b = read64(p + i - 8);
+	}
+
+	a ^= SECRET1;
+	b ^= s;
+	mum(&a, &b);
+	return mix(a ^ SECRET0 ^ len, b ^ SECRET1);
+}
+
+size_t hashInt64(void *key, size_t seed)
+{
+	return hashMix64(*(uint64_t *)key, seed);
+}
+
+size_t hashPointer(void *key, size_t seed)
+{
+	return hashMix64((uintptr_t)key, seed);
+}
+
+size_t hashString(void *key, size_t seed)
+{
+	return hashBytes(key, strlen(key), seed);
+}
+
+int compareInt64(void *key1, void *key2)
+{
+	int64_t a = *(int64_t *)key1;
+	int64_t b = *(int64_t *)key2;
+	return (a > b) - (a < b);
+}
+
+int comparePointer(void *key1, void *key2)
+{
+	return ((uintptr_t)key1 > (uintptr_t)key2) -
+	       ((uintptr_t)key1 < (uintptr_t)key2);
+}
+
+int compareString(void *key1, void *key2) { return strcmp(key1, key2); }
@@ -0,0 +1,19 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+size_t hashRandomSeed(void);
+uint64_t hashMix64(uint64_t x, uint64_t seed);
+size_t hashBytes(const void *data, size_t len, size_t seed);
+
+size_t hashInt64(void *key, size_t seed);
+size_t hashPointer(void *key, size_t seed);
+size_t hashString(void *key, size_t seed);
+
+int compareInt64(void *key1, void *key2);
+int comparePointer(void *key1, void *key2);
+int compareString(void *key1, void *key2);
+
+#endif
@@ -1,20 +1,50 @@
 #include "hashtable.h"
+#include "hash.h"
+#include "pool.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #define EXPAND_THRESHOLD 1
 #define SHRINK_THRESHOLD 0.1
 
 #define MIN_TABLE_SIZE 8
 
-typedef struct TableEntry {
-	void *key;
-	void *value;
-	struct TableEntry *next;
-} TableEntry;
+#define BATCH_SIZE 16
+
+#define DEFAULT_REHASH_STEP 1
+#define EMPTY_VISITS_PER_STEP 10
+/* buckets moved between clock checks in hashTableRehashMicroseconds */
+#define REHASH_BATCH_BUCKETS 100
+
+/* samples give up after this many bucket visits per requested entry */
+#define SAMPLE_VISITS_PER_ENTRY 10
+/* consecutive empty buckets before sampling jumps somewhere else */
+#define SAMPLE_EMPTY_JUMP 5
+
+#define SNAPSHOT_MAGIC "CDSHTAB"
+#define SNAPSHOT_VERSION 1
+/* the checksum is chained over blocks of this size */
+#define SNAPSHOT_BLOCK_SIZE (64 * 1024)
+
+#define hashTableEntryData(entry) ((void *)((entry) + 1))
+
+#ifdef HASHTABLE_COUNTERS
+#define hashTableCount(htable, counter) (++(htable)->counters.counter)
+#else
+#define hashTableCount(htable, counter) ((void)0)
+#endif
+
+typedef struct TableEntry TableEntry;
 
 typedef struct Table {
 	TableEntry **entries;
@@ -26,22 +56,51 @@ typedef struct Table {
 struct HashTable {
 	Table tables[2];
 	size_t rehash_idx;
+	size_t rehash_step;
+	/* while scans run the tables are neither moved nor resized */
+	int rehash_paused;
 
 	void *(*alloc)(size_t);
 	void (*dealloc)(void *);
 	size_t (*hash)(void *);
+	size_t (*seeded_hash)(void *, size_t);
 	int (*compare)(void *, void *);
 	void (*free_key)(void *);
 	void (*free_value)(void *);
+	size_t seed;
+	size_t sample_state;
+	Pool *pool;
+	/* bytes of caller data allocated behind every entry */
+	size_t entry_data;
+
+	HashTableCounters counters;
 };
 
-struct HashTableIter {
+/*
+ * A snapshot is the header, one record per entry and a trailing checksum,
+ * all in native byte order. A record is the cached hash followed by the
+ * key and the value, each prefixed by its serialized length.
+ */
+typedef struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t word_size;
+	uint64_t seed;
+	uint64_t buckets;
+	uint64_t count;
+} SnapshotHeader;
+
+typedef struct SnapshotWriter {
 	HashTable *table;
-	TableEntry *next;
-	size_t current_table_idx;
-	size_t current_index;
-	void (*dealloc)(void *);
-};
+	size_t (*write)(const void *buf, size_t len, void *privdata);
+	void *privdata;
+	char *block;
+	size_t len;
+	char *scratch;
+	size_t scratch_size;
+	size_t checksum;
+	int error;
+} SnapshotWriter;
 
 HashTable *hashTableCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
 {
@@ -50,6 +109,41 @@ HashTable *hashTableCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
 	htable->alloc = alloc;
 	htable->dealloc = dealloc;
 	htable->rehash_idx = -1;
+	htable->rehash_step = DEFAULT_REHASH_STEP;
+	htable->seed = hashRandomSeed();
+	return htable;
+}
+
+HashTable *hashTableCreatePooled(void *(*alloc)(size_t),
+				 void (*dealloc)(void *))
+{
+	HashTable *htable = hashTableCreate(alloc, dealloc);
+	htable->pool = poolCreate(alloc, dealloc, sizeof(TableEntry),
+				  POOL_DEFAULT_SLAB_NODES);
+	return htable;
+}
+
+/*
+ * Every entry carries size zeroed bytes for the caller right behind the
+ * entry itself, so per-key metadata shares its cache line instead of
+ * costing another pointer chase. Entries come from a pool.
+ */
+HashTable *hashTableCreateWithEntryData(void *(*alloc)(size_t),
+					void (*dealloc)(void *), size_t size)
+{
+	HashTable *htable = hashTableCreate(alloc, dealloc);
+	htable->entry_data = size;
+	htable->pool = poolCreate(alloc, dealloc, sizeof(TableEntry) + size,
+				  POOL_DEFAULT_SLAB_NODES);
+	return htable;
+}
+
+HashTable *hashTableCreateWithStringKeys(void *(*alloc)(size_t),
+					 void (*dealloc)(void *))
+{
+	HashTable *htable = hashTableCreate(alloc, dealloc);
+	htable->seeded_hash = hashString;
+	htable->compare = compareString;
 	return htable;
 }
 
@@ -58,6 +152,26 @@ size_t (*getHashMethod(HashTable *htable))(void *) { return htable->hash; }
 void setHashMethod(HashTable *htable, size_t (*hash)(void *))
 {
 	htable->hash = hash;
+	htable->seeded_hash = NULL;
+}
+
+size_t (*getSeededHashMethod(HashTable *htable))(void *, size_t)
+{
+	return htable->seeded_hash;
+}
+
+void setSeededHashMethod(HashTable *htable, size_t (*hash)(void *, size_t))
+{
+	htable->seeded_hash = hash;
+	htable->hash = NULL;
+}
+
+size_t hashTableGetSeed(HashTable *htable) { return htable->seed; }
+
+void hashTableSetSeed(HashTable *htable, size_t seed)
+{
+	assert(hashTableSize(htable) == 0);
+	htable->seed = seed;
 }
 
 int (*getCompareMethod(HashTable *htable))(void *, void *)
@@ -87,6 +201,81 @@ void setFreeValueMethod(HashTable *htable, void (*free_value)(void *))
 	htable->free_value = free_value;
 }
 
+void hashTableGetCounters(HashTable *htable, HashTableCounters *counters)
+{
+	memcpy(counters, &htable->counters, sizeof(HashTableCounters));
+}
+
+void hashTableResetCounters(HashTable *htable)
+{
+	memset(&htable->counters, 0, sizeof(HashTableCounters));
+}
+
+static void hashTableGetChains(Table *table, HashTableTableStats *stats)
+{
+	size_t i;
+	for (i = 0; i < table->size; ++i) {
+		size_t length = 0;
+		TableEntry *entry = table->entries[i];
+		while (entry != NULL) {
+			++length;
+			entry = entry->next;
+		}
+
+		if (length > 0) {
+			++stats->used_buckets;
+		}
+
+		if (length > stats->max_chain) {
+			stats->max_chain = length;
+		}
+
+		++stats->chains[length < HASHTABLE_STATS_CHAINS
+				    ? length
+				    : HASHTABLE_STATS_CHAINS - 1];
+	}
+}
+
+/*
+ * Without chains everything comes from counters kept anyway, so it is cheap
+ * enough to poll. Walking the chains visits every bucket of both tables.
+ * Entry memory is exact for pooled tables, which count whole slabs, and
+ * an estimate ignoring allocator overhead otherwise.
+ */
+void hashTableGetStats(HashTable *htable, HashTableStats *stats, int chains)
+{
+	memset(stats, 0, sizeof(HashTableStats));
+	stats->rehashing = hashTableIsRehashing(htable);
+	stats->rehash_idx = stats->rehashing ? htable->rehash_idx : 0;
+
+	size_t i;
+	for (i = 0; i < 2; ++i) {
+		Table *table = htable->tables + i;
+		HashTableTableStats *table_stats = stats->tables + i;
+		if (table->entries == NULL) {
+			continue;
+		}
+
+		table_stats->size = table->size;
+		table_stats->count = table->count;
+		table_stats->load_factor = (double)table->count / table->size;
+		stats->bucket_memory += table->size * sizeof(TableEntry *);
+		if (chains) {
+			hashTableGetChains(table, table_stats);
+		}
+	}
+
+	if (htable->pool != NULL) {
+		stats->entry_memory = poolMemory(htable->pool);
+	} else {
+		stats->entry_memory = hashTableSize(htable) *
+				      (sizeof(TableEntry) + htable->entry_data);
+	}
+
+	stats->memory =
+	    sizeof(HashTable) + stats->bucket_memory + stats->entry_memory;
+}
+
 size_t hashTableSize(HashTable *htable)
 {
 	Table *table1 = htable->tables;
@@ -101,24 +290,82 @@ size_t hashTableSize(HashTable *htable)
 	return table1->count + htable->tables[1].count;
 }
 
-static HashTable *hashTableInit(HashTable *htable)
+static HashTable *hashTableInit(HashTable *htable, size_t size)
 {
 	Table *table = htable->tables;
 	if (table->entries != NULL) {
 		return htable;
 	}
 
-	table->entries = htable->alloc(sizeof(Table *) * MIN_TABLE_SIZE);
-	memset(table->entries, 0, sizeof(Table *) * MIN_TABLE_SIZE);
+	table->entries = htable->alloc(sizeof(TableEntry *) * size);
+	memset(table->entries, 0, sizeof(TableEntry *) * size);
+	table->count = 0;
+	table->size = size;
 	return htable;
 }
 
-static HashTable *hashTableGetIndex(HashTable *htable, void *key,
+static inline TableEntry *hashTableAllocEntry(HashTable *htable)
+{
+	TableEntry *entry =
+	    htable->pool != NULL
+		? poolAlloc(htable->pool)
+		: htable->alloc(sizeof(TableEntry) + htable->entry_data);
+	if (htable->entry_data > 0) {
+		memset(hashTableEntryData(entry), 0, htable->entry_data);
+	}
+
+	return entry;
+}
+
+static inline void hashTableFreeEntry(HashTable *htable, TableEntry *entry)
+{
+	if (htable->pool != NULL) {
+		poolFree(htable->pool, entry);
+	} else {
+		htable->dealloc(entry);
+	}
+}
+
+static inline size_t hashTableHashKey(HashTable *htable, void *key)
+{
+	hashTableCount(htable, hash_calls);
+	if (htable->seeded_hash != NULL) {
+		return htable->seeded_hash(key, htable->seed);
+	}
+
+	return htable->hash(key);
+}
+
+/* entries whose cached hash differs are rejected without compare */
+static inline int hashTableEntryMatches(HashTable *htable, TableEntry *entry,
+					void *key, size_t hash)
+{
+	if (entry->hash != hash) {
+		hashTableCount(htable, compare_calls_saved);
+		return 0;
+	}
+
+	hashTableCount(htable, compare_calls);
+	return htable->compare(entry->key, key) == 0;
+}
+
+static inline TableEntry *hashTableFindEntry(HashTable *htable,
+					     TableEntry *entry, void *key,
+					     size_t hash)
+{
+	while (entry != NULL &&
+	       !hashTableEntryMatches(htable, entry, key, hash)) {
+		entry = entry->next;
+	}
+
+	return entry;
+}
+
+static HashTable *hashTableGetIndex(HashTable *htable, size_t hash,
 				    size_t *table_idx, size_t *index)
 {
-	size_t hash = htable->hash(key);
 	*index = hash & (htable->tables[0].size - 1);
-	if (*index < htable->rehash_idx) {
+	if (htable->rehash_idx != -1 && *index < htable->rehash_idx) {
 		*table_idx = 1;
 		*index = hash & (htable->tables[1].size - 1);
 	} else {
@@ -135,21 +382,59 @@ static HashTable *hashTableResize(HashTable *htable, size_t size)
 	memset(table2->entries, 0, sizeof(TableEntry *) * size);
 	table2->count = 0;
 	table2->size = size;
+	htable->rehash_idx = 0;
 	return htable;
 }
 
-static HashTable *hashTableReHash(HashTable *htable)
+/*
+ * Moves up to buckets non-empty buckets into the new table, visiting at
+ * most EMPTY_VISITS_PER_STEP empty ones per bucket so that a sparse old
+ * table can't stall a single call.
+ */
+static HashTable *hashTableReHash(HashTable *htable, size_t buckets)
 {
 	Table *table1 = htable->tables;
 	Table *table2 = htable->tables + 1;
+	if (htable->rehash_paused > 0) {
+		return htable;
+	}
 
 	assert(table1->entries != NULL);
 	assert(table2->entries != NULL);
 
-	TableEntry *entry = table1->entries[htable->rehash_idx];
-	while (entry == NULL && htable->rehash_idx < table1->size) {
+	size_t empty_visits = buckets < (size_t)-1 / EMPTY_VISITS_PER_STEP
+				  ? buckets * EMPTY_VISITS_PER_STEP
+				  : (size_t)-1;
+	while (buckets-- > 0 && htable->rehash_idx < table1->size) {
+		while (table1->entries[htable->rehash_idx] == NULL) {
+			++htable->rehash_idx;
+			if (htable->rehash_idx == table1->size ||
+			    --empty_visits == 0) {
+				break;
+			}
+		}
+
+		if (htable->rehash_idx == table1->size || empty_visits == 0) {
+			break;
+		}
+
+		TableEntry *entry = table1->entries[htable->rehash_idx];
+		table1->entries[htable->rehash_idx] = NULL;
+
+		TableEntry *tmp = NULL;
+		size_t index;
+		while (entry != NULL) {
+			index = entry->hash & (table2->size - 1);
+			hashTableCount(htable, hash_calls_saved);
+			tmp = entry;
+			entry = entry->next;
+			tmp->next = table2->entries[index];
+			table2->entries[index] = tmp;
+			--table1->count;
+			++table2->count;
+		}
+
 		++htable->rehash_idx;
-		entry = table1->entries[htable->rehash_idx];
 	}
 
 	if (htable->rehash_idx == table1->size) {
@@ -157,47 +442,36 @@ static HashTable *hashTableReHash(HashTable *htable)
 		htable->dealloc(table1->entries);
 		memcpy(table1, table2, sizeof(Table));
 		memset(table2, 0, sizeof(Table));
-		return htable;
 	}
 
-	table1->entries[htable->rehash_idx] = NULL;
-
-	TableEntry *tmp = NULL;
-	size_t index;
-	while (entry != NULL) {
-		index = htable->hash(entry->key) & (table2->size - 1);
-		tmp = entry;
-		entry = entry->next;
-		tmp->next = table2->entries[index];
-		table2->entries[index] = tmp;
-	}
-
-	++htable->rehash_idx;
-
 	return htable;
 }
 
-static HashTable *hashTableCheckThreShold(HashTable *htable)
+/* only removals shrink, so capacity from hashTableReserve survives inserts */
+static HashTable *hashTableCheckThreShold(HashTable *htable, int shrink)
 {
+	if (htable->rehash_paused > 0) {
+		return htable;
+	}
+
 	if (htable->rehash_idx != -1) {
-		hashTableReHash(htable);
+		hashTableReHash(htable, htable->rehash_step);
 		return htable;
 	}
 
 	Table *table1 = htable->tables;
-	Table *table2 = htable->tables + 1;
 
-	if (table1->size == MIN_TABLE_SIZE) {
+	double threshold = (double)table1->count / table1->size;
+
+	if (threshold > SHRINK_THRESHOLD && threshold <= EXPAND_THRESHOLD) {
 		return htable;
 	}
 
-	double threshold = (double)table1->count / table1->size;
-
-	if (threshold > SHRINK_THRESHOLD && threshold < EXPAND_THRESHOLD) {
+	if (threshold <= SHRINK_THRESHOLD && !shrink) {
 		return htable;
 	}
 
-	size_t size = 2;
+	size_t size = MIN_TABLE_SIZE;
 	while (size < table1->count) {
 		size <<= 1;
 	}
@@ -206,29 +480,26 @@ static HashTable *hashTableCheckThreShold(HashTable *htable)
 		size <<= 1;
 	}
 
-	size = size < MIN_TABLE_SIZE ? MIN_TABLE_SIZE : size;
+	if (size == table1->size) {
+		return htable;
+	}
 
 	hashTableResize(htable, size);
-	hashTableReHash(htable);
+	hashTableReHash(htable, htable->rehash_step);
 
 	return htable;
 }
 
-void hashTableSet(HashTable *htable, void *key, void *value)
+static TableEntry *hashTablePut(HashTable *htable, void *key, void *value,
+				size_t hash)
 {
-	if (htable->tables[0].entries == NULL) {
-		hashTableInit(htable);
-	}
-
-	size_t table_idx = 0;
-	if (htable->rehash_idx != -1) {
-		table_idx = 1;
-	}
+	size_t index;
+	size_t table_idx;
+	hashTableGetIndex(htable, hash, &table_idx, &index);
 
-	size_t index = htable->hash(key) & (htable->tables[table_idx].size - 1);
 	TableEntry *entry = htable->tables[table_idx].entries[index];
 	while (entry != NULL) {
-		if (htable->compare(entry->key, key) == 0) {
+		if (hashTableEntryMatches(htable, entry, key, hash)) {
 			if (htable->free_value != NULL) {
 				htable->free_value(entry->value);
 			}
@@ -241,15 +512,117 @@ void hashTableSet(HashTable *htable, void *key, void *value)
 	}
 
 	if (entry == NULL) {
-		entry = htable->alloc(sizeof(TableEntry));
+		entry = hashTableAllocEntry(htable);
 		entry->key = key;
 		entry->value = value;
+		entry->hash = hash;
 		entry->next = htable->tables[table_idx].entries[index];
 		htable->tables[table_idx].entries[index] = entry;
 		++htable->tables[table_idx].count;
 	}
 
-	hashTableCheckThreShold(htable);
+	return entry;
+}
+
+int hashTableIsRehashing(HashTable *htable) { return htable->rehash_idx != -1; }
+
+size_t hashTableGetRehashStep(HashTable *htable) { return htable->rehash_step; }
+
+void hashTableSetRehashStep(HashTable *htable, size_t buckets)
+{
+	htable->rehash_step = buckets;
+}
+
+int hashTableRehash(HashTable *htable, size_t buckets)
+{
+	if (htable->rehash_idx == -1) {
+		return 0;
+	}
+
+	hashTableReHash(htable, buckets);
+	return htable->rehash_idx != -1;
+}
+
+int hashTableRehashMicroseconds(HashTable *htable, size_t us)
+{
+	if (htable->rehash_paused > 0) {
+		return hashTableIsRehashing(htable);
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	long long deadline = ts.tv_sec * 1000000LL + ts.tv_nsec / 1000 + us;
+
+	while (hashTableRehash(htable, REHASH_BATCH_BUCKETS)) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		if (ts.tv_sec * 1000000LL + ts.tv_nsec / 1000 >= deadline) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void hashTableReserve(HashTable *htable, size_t size)
+{
+	size_t buckets = MIN_TABLE_SIZE;
+	while (buckets < size) {
+		buckets <<= 1;
+	}
+
+	if (htable->tables[0].entries == NULL) {
+		hashTableInit(htable, buckets);
+		return;
+	}
+
+	hashTableRehash(htable, (size_t)-1);
+	if (buckets <= htable->tables[0].size || htable->rehash_paused > 0) {
+		return;
+	}
+
+	hashTableResize(htable, buckets);
+	hashTableReHash(htable, (size_t)-1);
+}
+
+/*
+ * The WithHash calls take a hash the caller already computed with the
+ * table's hash method, so a table layered on HashTable hashes once.
+ */
+void hashTableSetWithHash(HashTable *htable, void *key, void *value,
+			  size_t hash)
+{
+	if (htable->tables[0].entries == NULL) {
+		hashTableInit(htable, MIN_TABLE_SIZE);
+	}
+
+	hashTablePut(htable, key, value, hash);
+	hashTableCheckThreShold(htable, 0);
+}
+
+void hashTableSet(HashTable *htable, void *key, void *value)
+{
+	hashTableSetWithHash(htable, key, value, hashTableHashKey(htable, key));
+}
+
+static inline TableEntry *hashTableLookup(HashTable *htable, void *key,
+					  size_t hash)
+{
+	size_t index;
+	size_t table_idx;
+	hashTableGetIndex(htable, hash, &table_idx, &index);
+
+	return hashTableFindEntry(
+	    htable, htable->tables[table_idx].entries[index], key, hash);
+}
+
+void *hashTableGetWithHash(HashTable *htable, void *key, size_t hash)
+{
+	if (htable->tables[0].entries == NULL) {
+		return NULL;
+	}
+
+	TableEntry *entry = hashTableLookup(htable, key, hash);
+	return entry != NULL ? entry->value : NULL;
 }
 
 void *hashTableGet(HashTable *htable, void *key)
@@ -258,36 +631,170 @@ void *hashTableGet(HashTable *htable, void *key)
 		return NULL;
 	}
 
+	TableEntry *entry =
+	    hashTableLookup(htable, key, hashTableHashKey(htable, key));
+	return entry != NULL ? entry->value : NULL;
+}
+
+void *hashTableGetWithData(HashTable *htable, void *key, void **data_ptr)
+{
+	TableEntry *entry = NULL;
+	if (htable->tables[0].entries != NULL) {
+		entry = hashTableLookup(htable, key,
+					hashTableHashKey(htable, key));
+	}
+
+	if (entry == NULL) {
+		*data_ptr = NULL;
+		return NULL;
+	}
+
+	*data_ptr = hashTableEntryData(entry);
+	return entry->value;
+}
+
+/* returns the entry data of key, left as it was if key already existed */
+void *hashTableSetWithData(HashTable *htable, void *key, void *value)
+{
+	if (htable->tables[0].entries == NULL) {
+		hashTableInit(htable, MIN_TABLE_SIZE);
+	}
+
+	TableEntry *entry =
+	    hashTablePut(htable, key, value, hashTableHashKey(htable, key));
+	hashTableCheckThreShold(htable, 0);
+	return hashTableEntryData(entry);
+}
+
+int HashTableContains(HashTable *htable, void *key)
+{
+	return hashTableGet(htable, key) != NULL;
+}
+
+/*
+ * Group prefetching: every window of keys is hashed first, then the
+ * bucket heads and the first entries are prefetched in separate passes
+ * so that their cache misses overlap before any chain is walked.
+ */
+static HashTable *hashTablePrefetchBatch(HashTable *htable, void **keys,
+					 size_t n, size_t *hashes,
+					 TableEntry ***buckets)
+{
+	size_t i;
 	size_t index;
 	size_t table_idx;
-	hashTableGetIndex(htable, key, &table_idx, &index);
+	for (i = 0; i < n; ++i) {
+		hashes[i] = hashTableHashKey(htable, keys[i]);
+		hashTableGetIndex(htable, hashes[i], &table_idx, &index);
+		buckets[i] = htable->tables[table_idx].entries + index;
+		__builtin_prefetch(buckets[i]);
+	}
 
-	TableEntry *entry = htable->tables[table_idx].entries[index];
-	while (entry != NULL) {
-		if (htable->compare(entry->key, key) == 0) {
-			return entry->value;
+	for (i = 0; i < n; ++i) {
+		__builtin_prefetch(*buckets[i]);
+	}
+
+	return htable;
+}
+
+void hashTableGetMany(HashTable *htable, void **keys, size_t n, void **values)
+{
+	size_t hashes[BATCH_SIZE];
+	TableEntry **buckets[BATCH_SIZE];
+
+	if (htable->tables[0].entries == NULL) {
+		memset(values, 0, sizeof(void *) * n);
+		return;
+	}
+
+	size_t i;
+	size_t j;
+	size_t batch;
+	TableEntry *entry;
+	for (i = 0; i < n; i += batch) {
+		batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+		hashTablePrefetchBatch(htable, keys + i, batch, hashes,
+				       buckets);
+
+		for (j = 0; j < batch; ++j) {
+			entry = hashTableFindEntry(htable, *buckets[j],
+						   keys[i + j], hashes[j]);
+
+			values[i + j] = entry != NULL ? entry->value : NULL;
 		}
 	}
+}
+
+void hashTableContainsMany(HashTable *htable, void **keys, size_t n,
+			   int *results)
+{
+	size_t hashes[BATCH_SIZE];
+	TableEntry **buckets[BATCH_SIZE];
+
+	if (htable->tables[0].entries == NULL) {
+		memset(results, 0, sizeof(int) * n);
+		return;
+	}
+
+	size_t i;
+	size_t j;
+	size_t batch;
+	TableEntry *entry;
+	for (i = 0; i < n; i += batch) {
+		batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+		hashTablePrefetchBatch(htable, keys + i, batch, hashes,
+				       buckets);
+
+		for (j = 0; j < batch; ++j) {
+			entry = hashTableFindEntry(htable, *buckets[j],
+						   keys[i + j], hashes[j]);
 
-	return NULL;
+			results[i + j] = entry != NULL && entry->value != NULL;
+		}
+	}
 }
 
-int HashTableContains(HashTable *htable, void *key)
+/*
+ * The table is sized for every key up front, so the batch is inserted
+ * without threshold checks and no rehash can move the prefetched buckets.
+ */
+void hashTableSetMany(HashTable *htable, void **keys, void **values, size_t n)
 {
-	return hashTableGet(htable, key) != NULL;
+	size_t hashes[BATCH_SIZE];
+	TableEntry **buckets[BATCH_SIZE];
+
+	hashTableReserve(htable, hashTableSize(htable) + n);
+
+	size_t i;
+	size_t j;
+	size_t batch;
+	for (i = 0; i < n; i += batch) {
+		batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+		hashTablePrefetchBatch(htable, keys + i, batch, hashes,
+				       buckets);
+
+		for (j = 0; j < batch; ++j) {
+			hashTablePut(htable, keys[i + j], values[i + j],
+				     hashes[j]);
+		}
+	}
 }
 
-void *hashTableRemove(HashTable *htable, void *key)
+void *hashTableRemoveWithHash(HashTable *htable, void *key, size_t hash)
 {
+	if (htable->tables[0].entries == NULL) {
+		return NULL;
+	}
+
 	size_t index;
 	size_t table_idx;
-	hashTableGetIndex(htable, key, &table_idx, &index);
+	hashTableGetIndex(htable, hash, &table_idx, &index);
 
 	TableEntry **entry_ptr = htable->tables[table_idx].entries + index;
 	TableEntry *entry = *entry_ptr;
 	void *value = NULL;
 	while (entry != NULL) {
-		if (htable->compare(entry->key, key) == 0) {
+		if (hashTableEntryMatches(htable, entry, key, hash)) {
 			break;
 		}
 
@@ -302,20 +809,577 @@ void *hashTableRemove(HashTable *htable, void *key)
 		}
 
 		*entry_ptr = entry->next;
-		htable->dealloc(entry);
+		hashTableFreeEntry(htable, entry);
+		--htable->tables[table_idx].count;
 	}
 
-	hashTableCheckThreShold(htable);
+	hashTableCheckThreShold(htable, 1);
 
 	return value;
 }
 
+void *hashTableRemove(HashTable *htable, void *key)
+{
+	if (htable->tables[0].entries == NULL) {
+		return NULL;
+	}
+
+	return hashTableRemoveWithHash(htable, key,
+				       hashTableHashKey(htable, key));
+}
+
+void hashTableDelWithHash(HashTable *htable, void *key, size_t hash)
+{
+	void *value = hashTableRemoveWithHash(htable, key, hash);
+	if (value != NULL && htable->free_value != NULL) {
+		htable->free_value(value);
+	}
+}
+
 void hashTableDel(HashTable *htable, void *key)
 {
-	hashTableRemove(htable, key);
+	void *value = hashTableRemove(htable, key);
+	if (value != NULL && htable->free_value != NULL) {
+		htable->free_value(value);
+	}
+}
+
+static size_t hashTableRandom(HashTable *htable)
+{
+	size_t x = htable->sample_state;
+	if (x == 0) {
+		x = htable->seed | 1;
+	}
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	htable->sample_state = x;
+	return x;
+}
+
+/*
+ * Collects up to n entries starting from a random bucket and walking the
+ * following ones, jumping again after a run of empty buckets (as Redis
+ * dictGetSomeKeys). Entries are not uniformly distributed and fewer
+ * than n, even none, may be returned from a sparse table. Any of keys,
+ * values and datas may be NULL.
+ */
+size_t hashTableSampleWithData(HashTable *htable, size_t n, void **keys,
+			       void **values, void **datas)
+{
+	size_t size = hashTableSize(htable);
+	if (size == 0) {
+		return 0;
+	}
+
+	n = n < size ? n : size;
+
+	/* as Redis, sampling helps a pending rehash along */
+	hashTableRehash(htable, n);
+
+	int rehashing = htable->rehash_idx != -1;
+	size_t mask = htable->tables[0].size - 1;
+	if (rehashing && htable->tables[1].size > htable->tables[0].size) {
+		mask = htable->tables[1].size - 1;
+	}
+
+	size_t visits = n * SAMPLE_VISITS_PER_ENTRY;
+	size_t index = hashTableRandom(htable) & mask;
+	size_t empty = 0;
+	size_t stored = 0;
+	size_t i;
+	TableEntry *entry;
+	while (stored < n && visits-- > 0) {
+		for (i = 0; i <= rehashing && stored < n; ++i) {
+			Table *table = htable->tables + i;
+			if (index >= table->size) {
+				continue;
+			}
+
+			entry = table->entries[index];
+			if (entry == NULL) {
+				if (++empty >= SAMPLE_EMPTY_JUMP && empty > n) {
+					index = hashTableRandom(htable) & mask;
+					empty = 0;
+				}
+
+				continue;
+			}
+
+			empty = 0;
+			while (entry != NULL && stored < n) {
+				if (keys != NULL) {
+					keys[stored] = entry->key;
+				}
+
+				if (values != NULL) {
+					values[stored] = entry->value;
+				}
+
+				if (datas != NULL) {
+					datas[stored] =
+					    hashTableEntryData(entry);
+				}
+
+				entry = entry->next;
+				++stored;
+			}
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	return stored;
+}
+
+size_t hashTableSample(HashTable *htable, size_t n, void **keys,
+		       void **values)
+{
+	return hashTableSampleWithData(htable, n, keys, values, NULL);
+}
+
+static size_t reverseBits(size_t v)
+{
+	size_t s = sizeof(v) * 8;
+	size_t mask = ~(size_t)0;
+	while ((s >>= 1) > 0) {
+		mask ^= mask << s;
+		v = ((v >> s) & mask) | ((v << s) & ~mask);
+	}
+
+	return v;
+}
+
+/* increments the cursor from its highest masked bit down */
+static size_t nextCursor(size_t cursor, size_t mask)
+{
+	cursor |= ~mask;
+	cursor = reverseBits(cursor);
+	++cursor;
+	return reverseBits(cursor);
+}
+
+static void hashTableScanBucket(TableEntry *entry,
+				void (*fn)(void *, void *, void *),
+				void *privdata)
+{
+	TableEntry *next = NULL;
+	while (entry != NULL) {
+		next = entry->next;
+		fn(entry->key, entry->value, privdata);
+		entry = next;
+	}
+}
+
+/*
+ * Reverse binary cursor scan (as in Redis SCAN): the cursor walks bucket
+ * indexes by incrementing their reversed bits, so buckets already visited
+ * map onto visited buckets after the table doubles or halves. During a
+ * rehash every bucket of the smaller table is visited together with all
+ * of its expansions in the larger one. Elements present for the whole
+ * scan are reported at least once; some may be reported twice.
+ *
+ * fn may set keys and remove the key it is called with, as an expiry
+ * sweep does, but no other key. Rehashing and resizing are paused until
+ * the call returns, so such writes never move the buckets being walked.
+ */
+size_t hashTableScan(HashTable *htable, size_t cursor, size_t buckets,
+		     void (*fn)(void *key, void *value, void *privdata),
+		     void *privdata)
+{
+	if (htable->tables[0].entries == NULL) {
+		return 0;
+	}
+
+	Table *small = htable->tables;
+	Table *large = htable->tables + 1;
+	if (htable->rehash_idx != -1 && small->size > large->size) {
+		small = htable->tables + 1;
+		large = htable->tables;
+	}
+
+	size_t small_mask = small->size - 1;
+	size_t large_mask = large->size - 1;
+	++htable->rehash_paused;
+	while (buckets-- > 0) {
+		hashTableScanBucket(small->entries[cursor & small_mask], fn,
+				    privdata);
+
+		if (htable->rehash_idx != -1) {
+			do {
+				hashTableScanBucket(
+				    large->entries[cursor & large_mask], fn,
+				    privdata);
+				cursor = nextCursor(cursor, large_mask);
+			} while (cursor & (small_mask ^ large_mask));
+		} else {
+			cursor = nextCursor(cursor, small_mask);
+		}
+
+		if (cursor == 0) {
+			break;
+		}
+	}
+
+	--htable->rehash_paused;
+	return cursor;
+}
+
+static void snapshotFlush(SnapshotWriter *writer)
+{
+	if (writer->len == 0 || writer->error) {
+		return;
+	}
+
+	writer->checksum =
+	    hashBytes(writer->block, writer->len, writer->checksum);
+	if (writer->write(writer->block, writer->len, writer->privdata) !=
+	    writer->len) {
+		writer->error = 1;
+	}
+
+	writer->len = 0;
+}
+
+static void snapshotPut(SnapshotWriter *writer, const void *data, size_t len)
+{
+	const char *p = data;
+	size_t n;
+	while (len > 0) {
+		n = SNAPSHOT_BLOCK_SIZE - writer->len;
+		n = n < len ? n : len;
+		memcpy(writer->block + writer->len, p, n);
+		writer->len += n;
+		p += n;
+		len -= n;
+
+		if (writer->len == SNAPSHOT_BLOCK_SIZE) {
+			snapshotFlush(writer);
+		}
+	}
 }
 
-HashTable *hashTableDestroyEntryList(HashTable *htable, TableEntry *head)
+/*
+ * Objects are serialized straight into the block when they fit behind
+ * their length, and through a scratch buffer grown on demand otherwise.
+ */
+static void snapshotPutObject(SnapshotWriter *writer, void *obj,
+			      size_t (*serialize)(void *, void *, size_t))
+{
+	uint32_t size;
+	size_t n;
+	char *buf = writer->block + writer->len;
+	size_t room = SNAPSHOT_BLOCK_SIZE - writer->len;
+	if (room > sizeof(size)) {
+		room -= sizeof(size);
+		n = serialize(obj, buf + sizeof(size), room);
+		if (n <= room) {
+			assert(n <= UINT32_MAX);
+			size = n;
+			memcpy(buf, &size, sizeof(size));
+			writer->len += sizeof(size) + n;
+			if (writer->len == SNAPSHOT_BLOCK_SIZE) {
+				snapshotFlush(writer);
+			}
+
+			return;
+		}
+	}
+
+	n = serialize(obj, writer->scratch, writer->scratch_size);
+	if (n > writer->scratch_size) {
+		HashTable *htable = writer->table;
+		if (writer->scratch != NULL) {
+			htable->dealloc(writer->scratch);
+		}
+
+		writer->scratch = htable->alloc(n);
+		writer->scratch_size = n;
+		n = serialize(obj, writer->scratch, writer->scratch_size);
+	}
+
+	assert(n <= UINT32_MAX);
+	size = n;
+	snapshotPut(writer, &size, sizeof(size));
+	snapshotPut(writer, writer->scratch, n);
+}
+
+/*
+ * Entries are streamed through a single block, so saving never holds a
+ * second copy of the table. The bucket count written is the one the
+ * table is rehashing into, so a load never needs to grow.
+ */
+int hashTableSaveStream(HashTable *htable,
+			size_t (*write)(const void *buf, size_t len,
+					void *privdata),
+			void *privdata,
+			size_t (*serialize_key)(void *key, void *buf,
+						size_t cap),
+			size_t (*serialize_value)(void *value, void *buf,
+						  size_t cap))
+{
+	SnapshotWriter writer;
+	memset(&writer, 0, sizeof(SnapshotWriter));
+	writer.table = htable;
+	writer.write = write;
+	writer.privdata = privdata;
+	writer.block = htable->alloc(SNAPSHOT_BLOCK_SIZE);
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(SnapshotHeader));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.word_size = sizeof(size_t);
+	header.seed = htable->seed;
+	header.buckets = htable->rehash_idx != -1 ? htable->tables[1].size
+						  : htable->tables[0].size;
+	header.count = hashTableSize(htable);
+	snapshotPut(&writer, &header, sizeof(SnapshotHeader));
+
+	size_t i;
+	size_t j;
+	uint64_t hash;
+	TableEntry *entry;
+	for (i = 0; i < 2 && !writer.error; ++i) {
+		Table *table = htable->tables + i;
+		for (j = 0; j < table->size && !writer.error; ++j) {
+			for (entry = table->entries[j]; entry != NULL;
+			     entry = entry->next) {
+				hash = entry->hash;
+				snapshotPut(&writer, &hash, sizeof(hash));
+				snapshotPutObject(&writer, entry->key,
+						  serialize_key);
+				snapshotPutObject(&writer, entry->value,
+						  serialize_value);
+			}
+		}
+	}
+
+	snapshotFlush(&writer);
+	uint64_t checksum = writer.checksum;
+	if (!writer.error &&
+	    write(&checksum, sizeof(checksum), privdata) != sizeof(checksum)) {
+		writer.error = 1;
+	}
+
+	htable->dealloc(writer.block);
+	if (writer.scratch != NULL) {
+		htable->dealloc(writer.scratch);
+	}
+
+	return writer.error ? -1 : 0;
+}
+
+static size_t snapshotWriteFile(const void *buf, size_t len, void *privdata)
+{
+	int fd = *(int *)privdata;
+	const char *p = buf;
+	size_t written = 0;
+	ssize_t n;
+	while (written < len) {
+		n = write(fd, p + written, len - written);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+
+		if (n <= 0) {
+			break;
+		}
+
+		written += n;
+	}
+
+	return written;
+}
+
+/* written to path.tmp and renamed, so path always holds a whole snapshot */
+int hashTableSave(HashTable *htable, const char *path,
+		  size_t (*serialize_key)(void *key, void *buf, size_t cap),
+		  size_t (*serialize_value)(void *value, void *buf, size_t cap))
+{
+	size_t len = strlen(path);
+	char *tmp = htable->alloc(len + sizeof(".tmp"));
+	memcpy(tmp, path, len);
+	memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		htable->dealloc(tmp);
+		return -1;
+	}
+
+	int ret = hashTableSaveStream(htable, snapshotWriteFile, &fd,
+				      serialize_key, serialize_value);
+	if (ret == 0) {
+		ret = fsync(fd);
+	}
+
+	if (close(fd) != 0) {
+		ret = -1;
+	}
+
+	if (ret == 0) {
+		ret = rename(tmp, path);
+	}
+
+	if (ret != 0) {
+		unlink(tmp);
+	}
+
+	htable->dealloc(tmp);
+	return ret;
+}
+
+static const char *snapshotGetObject(const char *p, const char *end,
+				     void *(*deserialize)(const void *, size_t),
+				     void **obj_ptr)
+{
+	uint32_t size;
+	if (end - p < sizeof(size)) {
+		return NULL;
+	}
+
+	memcpy(&size, p, sizeof(size));
+	p += sizeof(size);
+	if (end - p < size) {
+		return NULL;
+	}
+
+	*obj_ptr = deserialize(p, size);
+	return p + size;
+}
+
+static int snapshotVerify(const char *data, size_t len)
+{
+	SnapshotHeader header;
+	if (len < sizeof(SnapshotHeader) + sizeof(uint64_t)) {
+		return 0;
+	}
+
+	memcpy(&header, data, sizeof(SnapshotHeader));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+	    header.version != SNAPSHOT_VERSION ||
+	    header.word_size != sizeof(size_t) ||
+	    (header.buckets & (header.buckets - 1)) != 0 ||
+	    (header.buckets == 0 && header.count != 0)) {
+		return 0;
+	}
+
+	len -= sizeof(uint64_t);
+	size_t checksum = 0;
+	size_t offset;
+	size_t n;
+	for (offset = 0; offset < len; offset += n) {
+		n = len - offset < SNAPSHOT_BLOCK_SIZE ? len - offset
+						       : SNAPSHOT_BLOCK_SIZE;
+		checksum = hashBytes(data + offset, n, checksum);
+	}
+
+	uint64_t expected;
+	memcpy(&expected, data + len, sizeof(expected));
+	return checksum == expected;
+}
+
+/*
+ * The file is mapped and verified before anything is built. Entries are
+ * linked into a single bucket array of the saved size using their stored
+ * hashes, so no key is rehashed. htable must be empty and use the hash
+ * method the snapshot was saved with; its seed is restored from the file.
+ */
+int hashTableLoad(HashTable *htable, const char *path,
+		  void *(*deserialize_key)(const void *buf, size_t len),
+		  void *(*deserialize_value)(const void *buf, size_t len))
+{
+	assert(hashTableSize(htable) == 0);
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	size_t len = st.st_size;
+	const char *data = len > 0 ? mmap(NULL, len, PROT_READ, MAP_PRIVATE,
+					  fd, 0)
+				   : MAP_FAILED;
+	close(fd);
+	if (data == MAP_FAILED) {
+		errno = len > 0 ? errno : EINVAL;
+		return -1;
+	}
+
+	madvise((void *)data, len, MADV_SEQUENTIAL);
+	if (!snapshotVerify(data, len)) {
+		munmap((void *)data, len);
+		errno = EINVAL;
+		return -1;
+	}
+
+	SnapshotHeader header;
+	memcpy(&header, data, sizeof(SnapshotHeader));
+	hashTableClear(htable);
+	htable->seed = header.seed;
+	if (header.buckets > 0) {
+		hashTableInit(htable, header.buckets);
+	}
+
+	const char *p = data + sizeof(SnapshotHeader);
+	const char *end = data + len - sizeof(uint64_t);
+	Table *table = htable->tables;
+	TableEntry *entry;
+	uint64_t hash;
+	size_t index;
+	void *key;
+	void *value;
+	while (p != NULL && p < end) {
+		if (end - p < sizeof(hash) || table->count == header.count) {
+			p = NULL;
+			break;
+		}
+
+		memcpy(&hash, p, sizeof(hash));
+		p = snapshotGetObject(p + sizeof(hash), end, deserialize_key,
+				      &key);
+		if (p == NULL) {
+			break;
+		}
+
+		p = snapshotGetObject(p, end, deserialize_value, &value);
+		if (p == NULL) {
+			if (htable->free_key != NULL) {
+				htable->free_key(key);
+			}
+
+			break;
+		}
+
+		index = hash & (table->size - 1);
+		entry = hashTableAllocEntry(htable);
+		entry->key = key;
+		entry->value = value;
+		entry->hash = hash;
+		entry->next = table->entries[index];
+		table->entries[index] = entry;
+		++table->count;
+	}
+
+	munmap((void *)data, len);
+	if (p == NULL || table->count != header.count) {
+		hashTableClear(htable);
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static HashTable *hashTableDestroyEntryList(HashTable *htable, TableEntry *head)
 {
 	TableEntry *tmp = NULL;
 	while (head != NULL) {
@@ -330,7 +1394,9 @@ HashTable *hashTableDestroyEntryList(HashTable *htable, TableEntry *head)
 			htable->free_value(tmp->value);
 		}
 
-		htable->dealloc(tmp);
+		if (htable->pool == NULL) {
+			htable->dealloc(tmp);
+		}
 	}
 
 	return htable;
@@ -341,82 +1407,79 @@ void hashTableClear(HashTable *htable)
 	Table *table1 = htable->tables;
 	Table *table2 = htable->tables + 1;
 
-	int i;
+	if (table1->entries == NULL) {
+		return;
+	}
+
+	/* pooled entries go with their slabs unless keys/values need freeing */
+	int walk = htable->pool == NULL || htable->free_key != NULL ||
+		   htable->free_value != NULL;
+
+	size_t i;
 	if (htable->rehash_idx != -1) {
-		for (i = htable->rehash_idx; i < table1->size; ++i) {
+		for (i = htable->rehash_idx; walk && i < table1->size; ++i) {
 			hashTableDestroyEntryList(htable, table1->entries[i]);
 		}
 
-		for (i = 0; i < table2->size; ++i) {
+		for (i = 0; walk && i < table2->size; ++i) {
 			hashTableDestroyEntryList(htable, table2->entries[i]);
 		}
 
 		htable->dealloc(table2->entries);
 	} else {
-		for (i = 0; i < table1->size; ++i) {
+		for (i = 0; walk && i < table1->size; ++i) {
 			hashTableDestroyEntryList(htable, table1->entries[i]);
 		}
 	}
 
 	htable->dealloc(table1->entries);
 
-	table1->entries = NULL;
-	table2->entries = NULL;
+	if (htable->pool != NULL) {
+		poolClear(htable->pool);
+	}
+
+	memset(table1, 0, sizeof(Table));
+	memset(table2, 0, sizeof(Table));
 	htable->rehash_idx = -1;
 }
 
 void hashTableDestroy(HashTable *htable)
 {
 	hashTableClear(htable);
+	if (htable->pool != NULL) {
+		poolDestroy(htable->pool);
+	}
+
 	htable->dealloc(htable);
 }
 
-HashTableIter *hashTableIterator(HashTable *htable)
+void hashTableIterInit(HashTable *htable, HashTableIter *iter)
 {
-	HashTableIter *iter = htable->alloc(sizeof(HashTableIter));
+	int isRehashing = htable->rehash_idx != -1;
 	iter->table = htable;
+	iter->buckets[0] = htable->tables[0].entries;
+	iter->sizes[0] = htable->tables[0].size;
+	iter->buckets[1] = isRehashing ? htable->tables[1].entries : NULL;
+	iter->sizes[1] = isRehashing ? htable->tables[1].size : 0;
 	iter->current_table_idx = 0;
-	iter->current_index = htable->rehash_idx != -1 ? htable->rehash_idx : 0;
-	iter->next = htable->tables[0].entries[iter->current_index];
+	iter->current_index = isRehashing ? htable->rehash_idx : 0;
+	iter->next = NULL;
+	iter->dealloc = NULL;
+	hashTableIterSeek(iter);
+}
+
+HashTableIter *hashTableIterator(HashTable *htable)
+{
+	HashTableIter *iter = htable->alloc(sizeof(HashTableIter));
+	hashTableIterInit(htable, iter);
 	iter->dealloc = htable->dealloc;
 	return iter;
 }
 
-int hashTableIterHasNext(HashTableIter *iter) { return iter->next != NULL; }
-
-void hashTableIterNext(HashTableIter *iter, void **key_ptr, void **value_ptr)
+/* a no-op for iterators set up by hashTableIterInit */
+void hashTableIterDestroy(HashTableIter *iter)
 {
-	*key_ptr = iter->next->key;
-	*value_ptr = iter->next->value;
-
-	iter->next = iter->next->next;
-	if (iter->next != NULL) {
-		return;
-	}
-
-	Table *table1 = iter->table->tables;
-	Table *table2 = iter->table->tables + 1;
-
-	int isRehashing = iter->table->rehash_idx != -1;
-
-	while (iter->next == NULL) {
-		if (!isRehashing && iter->current_index == table1->size - 1 ||
-		    isRehashing && iter->current_table_idx == 1 &&
-			iter->current_index == table2->size - 1) {
-			break;
-		}
-
-		if (isRehashing && iter->current_table_idx == 0 &&
-		    iter->current_index == table1->size - 1) {
-			iter->current_table_idx = 1;
-			iter->current_index = 0;
-		} else {
-			++iter->current_index;
-		}
-
-		iter->next = iter->table->tables[iter->current_table_idx]
-				 .entries[iter->current_index];
+	if (iter->dealloc != NULL) {
+		iter->dealloc(iter);
 	}
 }
-
-void hashTableIterDestroy(HashTableIter *iter) { iter->dealloc(iter); }
@@ -6,27 +6,189 @@
 typedef struct HashTable HashTable;
 typedef struct HashTableIter HashTableIter;
 
+/* public so that iterating inlines, entries are read only outside */
+struct TableEntry {
+	void *key;
+	void *value;
+	size_t hash;
+	struct TableEntry *next;
+};
+
+/* set up by hashTableIterInit it can live on the stack and needs no destroy */
+struct HashTableIter {
+	HashTable *table;
+	struct TableEntry *next;
+	/* bucket arrays to walk, the second one is only set while rehashing */
+	struct TableEntry **buckets[2];
+	size_t sizes[2];
+	size_t current_table_idx;
+	size_t current_index;
+	void (*dealloc)(void *);
+};
+
+static inline void hashTableIterSeek(HashTableIter *iter)
+{
+	while (iter->next == NULL) {
+		size_t t = iter->current_table_idx;
+		if (iter->current_index < iter->sizes[t]) {
+			iter->next = iter->buckets[t][iter->current_index++];
+			continue;
+		}
+
+		if (t == 1) {
+			break;
+		}
+
+		iter->current_table_idx = 1;
+		iter->current_index = 0;
+	}
+}
+
+static inline int hashTableIterHasNext(HashTableIter *iter)
+{
+	return iter->next != NULL;
+}
+
+static inline void hashTableIterNext(HashTableIter *iter, void **key_ptr,
+				     void **value_ptr)
+{
+	*key_ptr = iter->next->key;
+	*value_ptr = iter->next->value;
+
+	iter->next = iter->next->next;
+	hashTableIterSeek(iter);
+}
+
+/* key and value are void * lvalues, break leaves early */
+#define hashTableForEach(htable, iter, key, value)			\
+	for (hashTableIterInit((htable), &(iter));			\
+	     hashTableIterHasNext(&(iter)) &&				\
+	     (hashTableIterNext(&(iter), &(key), &(value)), 1);)
+
+/* only counted when built with HASHTABLE_COUNTERS defined */
+typedef struct HashTableCounters {
+	size_t hash_calls;
+	size_t hash_calls_saved;
+	size_t compare_calls;
+	size_t compare_calls_saved;
+} HashTableCounters;
+
+#define HASHTABLE_STATS_CHAINS 16
+
+typedef struct HashTableTableStats {
+	size_t size;
+	size_t count;
+	double load_factor;
+	/* the fields below are only filled when chains are walked */
+	size_t used_buckets;
+	size_t max_chain;
+	/* buckets by chain length, the last slot counts longer chains too */
+	size_t chains[HASHTABLE_STATS_CHAINS];
+} HashTableTableStats;
+
+typedef struct HashTableStats {
+	HashTableTableStats tables[2];
+	int rehashing;
+	size_t rehash_idx;
+	size_t bucket_memory;
+	size_t entry_memory;
+	size_t memory;
+} HashTableStats;
+
 HashTable *hashTableCreate(void *(*alloc)(size_t), void (*dealloc)(void *));
+HashTable *hashTableCreatePooled(void *(*alloc)(size_t),
+				 void (*dealloc)(void *));
+HashTable *hashTableCreateWithEntryData(void *(*alloc)(size_t),
+					void (*dealloc)(void *), size_t size);
+HashTable *hashTableCreateWithStringKeys(void *(*alloc)(size_t),
+					 void (*dealloc)(void *));
 size_t (*getHashMethod(HashTable *htable))(void *);
 void setHashMethod(HashTable *htable, size_t (*hash)(void *));
+size_t (*getSeededHashMethod(HashTable *htable))(void *, size_t);
+void setSeededHashMethod(HashTable *htable, size_t (*hash)(void *, size_t));
+size_t hashTableGetSeed(HashTable *htable);
+void hashTableSetSeed(HashTable *htable, size_t seed);
 int (*getCompareMethod(HashTable *htable))(void *, void *);
 void setCompareMethod(HashTable *htable, int (*compare)(void *, void *));
 void (*getFreeKeyMethod(HashTable *htable))(void *);
 void setFreeKeyMethod(HashTable *htable, void (*free_key)(void *));
 void (*getFreeValueMethod(HashTable *htable))(void *);
 void setFreeValueMethod(HashTable *htable, void (*free_value)(void *));
+void hashTableGetCounters(HashTable *htable, HashTableCounters *counters);
+void hashTableResetCounters(HashTable *htable);
+void hashTableGetStats(HashTable *htable, HashTableStats *stats, int chains);
 size_t hashTableSize(HashTable *htable);
 int HashTableContains(HashTable *htable, void *key);
 void hashTableSet(HashTable *htable, void *key, void *value);
 void *hashTableGet(HashTable *htable, void *key);
+void *hashTableGetWithData(HashTable *htable, void *key, void **data_ptr);
+void *hashTableSetWithData(HashTable *htable, void *key, void *value);
+void hashTableSetMany(HashTable *htable, void **keys, void **values, size_t n);
+void hashTableGetMany(HashTable *htable, void **keys, size_t n, void **values);
+void hashTableContainsMany(HashTable *htable, void **keys, size_t n,
+			   int *results);
+int hashTableIsRehashing(HashTable *htable);
+size_t hashTableGetRehashStep(HashTable *htable);
+void hashTableSetRehashStep(HashTable *htable, size_t buckets);
+int hashTableRehash(HashTable *htable, size_t buckets);
+int hashTableRehashMicroseconds(HashTable *htable, size_t us);
+void hashTableReserve(HashTable *htable, size_t size);
 void *hashTableRemove(HashTable *htable, void *key);
 void hashTableDel(HashTable *htable, void *key);
+/* hash must be what the table's own hash method returns for key */
+void hashTableSetWithHash(HashTable *htable, void *key, void *value,
+			  size_t hash);
+void *hashTableGetWithHash(HashTable *htable, void *key, size_t hash);
+void *hashTableRemoveWithHash(HashTable *htable, void *key, size_t hash);
+void hashTableDelWithHash(HashTable *htable, void *key, size_t hash);
+size_t hashTableSample(HashTable *htable, size_t n, void **keys,
+		       void **values);
+size_t hashTableSampleWithData(HashTable *htable, size_t n, void **keys,
+			       void **values, void **datas);
+size_t hashTableScan(HashTable *htable, size_t cursor, size_t buckets,
+		     void (*fn)(void *key, void *value, void *privdata),
+		     void *privdata);
+int hashTableSaveStream(HashTable *htable,
+			size_t (*write)(const void *buf, size_t len,
+					void *privdata),
+			void *privdata,
+			size_t (*serialize_key)(void *key, void *buf,
+						size_t cap),
+			size_t (*serialize_value)(void *value, void *buf,
+						  size_t cap));
+int hashTableSave(HashTable *htable, const char *path,
+		  size_t (*serialize_key)(void *key, void *buf, size_t cap),
+		  size_t (*serialize_value)(void *value, void *buf,
+					    size_t cap));
+int hashTableLoad(HashTable *htable, const char *path,
+		  void *(*deserialize_key)(const void *buf, size_t len),
+		  void *(*deserialize_value)(const void *buf, size_t len));
 void hashTableClear(HashTable *htable);
 void hashTableDestroy(HashTable *htable);
+void hashTableIterInit(HashTable *htable, HashTableIter *iter);
 HashTableIter *hashTableIterator(HashTable *htable);
-
-int hashTableIterHasNext(HashTableIter *iter);
-void hashTableIterNext(HashTableIter *iter, void **key_ptr, void **value_ptr);
 void hashTableIterDestroy(HashTableIter *iter);
 
+/*
+ * Visits every entry in iterator order until visit returns non-zero,
+ * returning that. The table must not change meanwhile.
+ */
+static inline int hashTableVisit(HashTable *htable,
+				 int (*visit)(void *key, void *value,
+					      void *privdata),
+				 void *privdata)
+{
+	HashTableIter iter;
+	void *key;
+	void *value;
+	hashTableForEach(htable, iter, key, value) {
+		int ret = visit(key, value, privdata);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
 #endif
@@ -0,0 +1,509 @@
+#include "rcuhashtable.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+
+#define EXPAND_THRESHOLD 1
+#define SHRINK_THRESHOLD 0.1
+
+#define MIN_TABLE_SIZE 8
+
+#define CACHE_LINE_SIZE 64
+
+/* a reader whose epoch is 0 is offline and never delays reclamation */
+#define EPOCH_OFFLINE 0
+
+#define RETIRED_VALUE 0
+#define RETIRED_ENTRY 1
+/* a table copied by a resize, its entries share keys and values */
+#define RETIRED_TABLE 2
+/* a cleared table, its keys and values go with it */
+#define RETIRED_CLEARED_TABLE 3
+
+#define rcuLoad(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define rcuStore(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+typedef struct RCUEntry {
+	void *key;
+	void *value;
+	size_t hash;
+	struct RCUEntry *next;
+} RCUEntry;
+
+typedef struct RCUTable {
+	/* size always equals to 2^n */
+	size_t size;
+	RCUEntry *entries[];
+} RCUTable;
+
+typedef struct Retired {
+	void *ptr;
+	int type;
+	size_t epoch;
+	struct Retired *next;
+} Retired;
+
+#define READER_SIZE (sizeof(size_t) + 2 * sizeof(void *))
+
+struct RCUHashTableReader {
+	size_t epoch;
+	RCUHashTable *table;
+	RCUHashTableReader *next;
+	char padding[CACHE_LINE_SIZE - READER_SIZE % CACHE_LINE_SIZE];
+};
+
+/*
+ * Readers walk the published table without locks or atomic
+ * read-modify-write; writers serialize on a mutex and publish every
+ * change with a release store. Memory a reader may still see is retired
+ * with the current epoch and freed once every online reader has passed
+ * a quiescent state in a later epoch.
+ */
+struct RCUHashTable {
+	RCUTable *table;
+	size_t count;
+	size_t epoch;
+	Retired *retired;
+	RCUHashTableReader *readers;
+	pthread_mutex_t lock;
+
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	size_t (*hash)(void *);
+	int (*compare)(void *, void *);
+	void (*free_key)(void *);
+	void (*free_value)(void *);
+};
+
+static RCUTable *rcuTableCreate(RCUHashTable *htable, size_t size)
+{
+	RCUTable *table =
+	    htable->alloc(sizeof(RCUTable) + sizeof(RCUEntry *) * size);
+	memset(table->entries, 0, sizeof(RCUEntry *) * size);
+	table->size = size;
+	return table;
+}
+
+static void rcuTableDestroy(RCUHashTable *htable, RCUTable *table,
+			    int free_items)
+{
+	size_t i;
+	RCUEntry *entry;
+	RCUEntry *next;
+	for (i = 0; i < table->size; ++i) {
+		for (entry = table->entries[i]; entry != NULL; entry = next) {
+			next = entry->next;
+			if (free_items && htable->free_key != NULL) {
+				htable->free_key(entry->key);
+			}
+
+			if (free_items && htable->free_value != NULL) {
+				htable->free_value(entry->value);
+			}
+
+			htable->dealloc(entry);
+		}
+	}
+
+	htable->dealloc(table);
+}
+
+RCUHashTable *rcuHashTableCreate(void *(*alloc)(size_t),
+				 void (*dealloc)(void *))
+{
+	RCUHashTable *htable = alloc(sizeof(RCUHashTable));
+	memset(htable, 0, sizeof(RCUHashTable));
+	htable->alloc = alloc;
+	htable->dealloc = dealloc;
+	htable->epoch = EPOCH_OFFLINE + 1;
+	htable->table = rcuTableCreate(htable, MIN_TABLE_SIZE);
+	pthread_mutex_init(&htable->lock, NULL);
+	return htable;
+}
+
+size_t (*rcuHashTableGetHashMethod(RCUHashTable *htable))(void *)
+{
+	return htable->hash;
+}
+
+void rcuHashTableSetHashMethod(RCUHashTable *htable, size_t (*hash)(void *))
+{
+	htable->hash = hash;
+}
+
+int (*rcuHashTableGetCompareMethod(RCUHashTable *htable))(void *, void *)
+{
+	return htable->compare;
+}
+
+void rcuHashTableSetCompareMethod(RCUHashTable *htable,
+				  int (*compare)(void *, void *))
+{
+	htable->compare = compare;
+}
+
+void (*rcuHashTableGetFreeKeyMethod(RCUHashTable *htable))(void *)
+{
+	return htable->free_key;
+}
+
+void rcuHashTableSetFreeKeyMethod(RCUHashTable *htable,
+				  void (*free_key)(void *))
+{
+	htable->free_key = free_key;
+}
+
+void (*rcuHashTableGetFreeValueMethod(RCUHashTable *htable))(void *)
+{
+	return htable->free_value;
+}
+
+void rcuHashTableSetFreeValueMethod(RCUHashTable *htable,
+				    void (*free_value)(void *))
+{
+	htable->free_value = free_value;
+}
+
+/*
+ * Going online must be visible to writers before the reader loads any
+ * pointer, which takes a full fence. Quiescent states only move an
+ * online reader's epoch forward, so a plain release store is enough.
+ */
+void rcuHashTableOnline(RCUHashTableReader *reader)
+{
+	rcuStore(&reader->epoch, rcuLoad(&reader->table->epoch));
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void rcuHashTableOffline(RCUHashTableReader *reader)
+{
+	rcuStore(&reader->epoch, EPOCH_OFFLINE);
+}
+
+void rcuHashTableQuiescent(RCUHashTableReader *reader)
+{
+	rcuStore(&reader->epoch, rcuLoad(&reader->table->epoch));
+}
+
+RCUHashTableReader *rcuHashTableRegisterReader(RCUHashTable *htable)
+{
+	RCUHashTableReader *reader = htable->alloc(sizeof(RCUHashTableReader));
+	memset(reader, 0, sizeof(RCUHashTableReader));
+	reader->table = htable;
+
+	pthread_mutex_lock(&htable->lock);
+	reader->next = htable->readers;
+	htable->readers = reader;
+	pthread_mutex_unlock(&htable->lock);
+
+	rcuHashTableOnline(reader);
+	return reader;
+}
+
+void rcuHashTableUnregisterReader(RCUHashTableReader *reader)
+{
+	RCUHashTable *htable = reader->table;
+	pthread_mutex_lock(&htable->lock);
+	RCUHashTableReader **reader_ptr = &htable->readers;
+	while (*reader_ptr != reader) {
+		reader_ptr = &(*reader_ptr)->next;
+	}
+
+	*reader_ptr = reader->next;
+	pthread_mutex_unlock(&htable->lock);
+
+	htable->dealloc(reader);
+}
+
+static void rcuHashTableFreeRetired(RCUHashTable *htable, Retired *retired)
+{
+	RCUEntry *entry;
+	switch (retired->type) {
+	case RETIRED_VALUE:
+		htable->free_value(retired->ptr);
+		break;
+	case RETIRED_ENTRY:
+		entry = retired->ptr;
+		if (htable->free_key != NULL) {
+			htable->free_key(entry->key);
+		}
+
+		htable->dealloc(entry);
+		break;
+	case RETIRED_TABLE:
+		rcuTableDestroy(htable, retired->ptr, 0);
+		break;
+	case RETIRED_CLEARED_TABLE:
+		rcuTableDestroy(htable, retired->ptr, 1);
+		break;
+	}
+
+	htable->dealloc(retired);
+}
+
+static void rcuHashTableRetire(RCUHashTable *htable, void *ptr, int type)
+{
+	Retired *retired = htable->alloc(sizeof(Retired));
+	retired->ptr = ptr;
+	retired->type = type;
+	retired->epoch = htable->epoch;
+	retired->next = htable->retired;
+	htable->retired = retired;
+}
+
+/* frees everything retired before the oldest epoch still observed */
+static void rcuHashTableReclaim(RCUHashTable *htable)
+{
+	if (htable->retired == NULL) {
+		return;
+	}
+
+	size_t min = htable->epoch;
+	size_t epoch;
+	RCUHashTableReader *reader;
+	for (reader = htable->readers; reader != NULL; reader = reader->next) {
+		epoch = rcuLoad(&reader->epoch);
+		if (epoch != EPOCH_OFFLINE && epoch < min) {
+			min = epoch;
+		}
+	}
+
+	/* the list is newest first, so everything after the first hit goes */
+	Retired **retired_ptr = &htable->retired;
+	while (*retired_ptr != NULL && (*retired_ptr)->epoch >= min) {
+		retired_ptr = &(*retired_ptr)->next;
+	}
+
+	Retired *retired = *retired_ptr;
+	Retired *next;
+	*retired_ptr = NULL;
+	for (; retired != NULL; retired = next) {
+		next = retired->next;
+		rcuHashTableFreeRetired(htable, retired);
+	}
+}
+
+/* ends a write: opens a new epoch, then frees what nobody can see */
+static void rcuHashTableAdvance(RCUHashTable *htable)
+{
+	if (htable->retired == NULL) {
+		return;
+	}
+
+	__atomic_store_n(&htable->epoch, htable->epoch + 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	rcuHashTableReclaim(htable);
+}
+
+size_t rcuHashTableSize(RCUHashTable *htable)
+{
+	return rcuLoad(&htable->count);
+}
+
+void *rcuHashTableGet(RCUHashTable *htable, void *key)
+{
+	RCUTable *table = rcuLoad(&htable->table);
+	size_t hash = htable->hash(key);
+	RCUEntry *entry = rcuLoad(&table->entries[hash & (table->size - 1)]);
+	while (entry != NULL) {
+		if (entry->hash == hash &&
+		    htable->compare(entry->key, key) == 0) {
+			return rcuLoad(&entry->value);
+		}
+
+		entry = rcuLoad(&entry->next);
+	}
+
+	return NULL;
+}
+
+int rcuHashTableContains(RCUHashTable *htable, void *key)
+{
+	return rcuHashTableGet(htable, key) != NULL;
+}
+
+/* readers may be walking the old table, so every entry is copied */
+static void rcuHashTableResize(RCUHashTable *htable, size_t size)
+{
+	RCUTable *old = htable->table;
+	RCUTable *table = rcuTableCreate(htable, size);
+
+	size_t i;
+	size_t index;
+	RCUEntry *entry;
+	RCUEntry *copy;
+	for (i = 0; i < old->size; ++i) {
+		for (entry = old->entries[i]; entry != NULL;
+		     entry = entry->next) {
+			copy = htable->alloc(sizeof(RCUEntry));
+			memcpy(copy, entry, sizeof(RCUEntry));
+			index = copy->hash & (size - 1);
+			copy->next = table->entries[index];
+			table->entries[index] = copy;
+		}
+	}
+
+	rcuStore(&htable->table, table);
+	rcuHashTableRetire(htable, old, RETIRED_TABLE);
+}
+
+static void rcuHashTableCheckThreShold(RCUHashTable *htable)
+{
+	RCUTable *table = htable->table;
+	double threshold = (double)htable->count / table->size;
+	if (threshold > SHRINK_THRESHOLD && threshold <= EXPAND_THRESHOLD) {
+		return;
+	}
+
+	size_t size = MIN_TABLE_SIZE;
+	while (size < htable->count) {
+		size <<= 1;
+	}
+
+	if (threshold > EXPAND_THRESHOLD) {
+		size <<= 1;
+	}
+
+	if (size != table->size) {
+		rcuHashTableResize(htable, size);
+	}
+}
+
+void rcuHashTableSet(RCUHashTable *htable, void *key, void *value)
+{
+	size_t hash = htable->hash(key);
+
+	pthread_mutex_lock(&htable->lock);
+	RCUTable *table = htable->table;
+	RCUEntry **head = table->entries + (hash & (table->size - 1));
+	RCUEntry *entry = *head;
+	while (entry != NULL &&
+	       (entry->hash != hash || htable->compare(entry->key, key) != 0)) {
+		entry = entry->next;
+	}
+
+	if (entry != NULL) {
+		void *old = entry->value;
+		rcuStore(&entry->value, value);
+		if (htable->free_value != NULL) {
+			rcuHashTableRetire(htable, old, RETIRED_VALUE);
+		}
+	} else {
+		entry = htable->alloc(sizeof(RCUEntry));
+		entry->key = key;
+		entry->value = value;
+		entry->hash = hash;
+		entry->next = *head;
+		rcuStore(head, entry);
+		rcuStore(&htable->count, htable->count + 1);
+		rcuHashTableCheckThreShold(htable);
+	}
+
+	rcuHashTableAdvance(htable);
+	pthread_mutex_unlock(&htable->lock);
+}
+
+static void *rcuHashTableUnlink(RCUHashTable *htable, void *key, int del)
+{
+	size_t hash = htable->hash(key);
+
+	pthread_mutex_lock(&htable->lock);
+	RCUTable *table = htable->table;
+	RCUEntry **entry_ptr = table->entries + (hash & (table->size - 1));
+	RCUEntry *entry = *entry_ptr;
+	while (entry != NULL &&
+	       (entry->hash != hash || htable->compare(entry->key, key) != 0)) {
+		entry_ptr = &entry->next;
+		entry = *entry_ptr;
+	}
+
+	void *value = NULL;
+	if (entry != NULL) {
+		value = entry->value;
+		rcuStore(entry_ptr, entry->next);
+		rcuStore(&htable->count, htable->count - 1);
+		rcuHashTableRetire(htable, entry, RETIRED_ENTRY);
+		if (del && htable->free_value != NULL) {
+			rcuHashTableRetire(htable, value, RETIRED_VALUE);
+		}
+
+		rcuHashTableCheckThreShold(htable);
+		rcuHashTableAdvance(htable);
+	}
+
+	pthread_mutex_unlock(&htable->lock);
+	return value;
+}
+
+/*
+ * Readers may still hold the returned value, call rcuHashTableSynchronize
+ * before freeing it or use rcuHashTableDel to have it freed when safe.
+ */
+void *rcuHashTableRemove(RCUHashTable *htable, void *key)
+{
+	return rcuHashTableUnlink(htable, key, 0);
+}
+
+void rcuHashTableDel(RCUHashTable *htable, void *key)
+{
+	rcuHashTableUnlink(htable, key, 1);
+}
+
+/* waits for a full grace period, must not be called by an online reader */
+void rcuHashTableSynchronize(RCUHashTable *htable)
+{
+	pthread_mutex_lock(&htable->lock);
+	size_t target = htable->epoch + 1;
+	__atomic_store_n(&htable->epoch, target, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	RCUHashTableReader *reader = htable->readers;
+	size_t epoch;
+	while (reader != NULL) {
+		epoch = rcuLoad(&reader->epoch);
+		if (epoch != EPOCH_OFFLINE && epoch < target) {
+			sched_yield();
+			continue;
+		}
+
+		reader = reader->next;
+	}
+
+	rcuHashTableReclaim(htable);
+	pthread_mutex_unlock(&htable->lock);
+}
+
+void rcuHashTableClear(RCUHashTable *htable)
+{
+	pthread_mutex_lock(&htable->lock);
+	RCUTable *old = htable->table;
+	rcuStore(&htable->table, rcuTableCreate(htable, MIN_TABLE_SIZE));
+	rcuStore(&htable->count, 0);
+	rcuHashTableRetire(htable, old, RETIRED_CLEARED_TABLE);
+	rcuHashTableAdvance(htable);
+	pthread_mutex_unlock(&htable->lock);
+}
+
+/* no reader may use the table any more, remaining readers are freed */
+void rcuHashTableDestroy(RCUHashTable *htable)
+{
+	Retired *retired = htable->retired;
+	Retired *next_retired;
+	for (; retired != NULL; retired = next_retired) {
+		next_retired = retired->next;
+		rcuHashTableFreeRetired(htable, retired);
+	}
+
+	RCUHashTableReader *reader = htable->readers;
+	RCUHashTableReader *next_reader;
+	for (; reader != NULL; reader = next_reader) {
+		next_reader = reader->next;
+		htable->dealloc(reader);
+	}
+
+	rcuTableDestroy(htable, htable->table, 1);
+	pthread_mutex_destroy(&htable->lock);
+	htable->dealloc(htable);
+}
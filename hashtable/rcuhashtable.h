@@ -0,0 +1,37 @@
+#ifndef RCUHASHTABLE_H
+#define RCUHASHTABLE_H
+
+#include <stddef.h>
+
+typedef struct RCUHashTable RCUHashTable;
+typedef struct RCUHashTableReader RCUHashTableReader;
+
+RCUHashTable *rcuHashTableCreate(void *(*alloc)(size_t),
+				 void (*dealloc)(void *));
+size_t (*rcuHashTableGetHashMethod(RCUHashTable *htable))(void *);
+void rcuHashTableSetHashMethod(RCUHashTable *htable, size_t (*hash)(void *));
+int (*rcuHashTableGetCompareMethod(RCUHashTable *htable))(void *, void *);
+void rcuHashTableSetCompareMethod(RCUHashTable *htable,
+				  int (*compare)(void *, void *));
+void (*rcuHashTableGetFreeKeyMethod(RCUHashTable *htable))(void *);
+void rcuHashTableSetFreeKeyMethod(RCUHashTable *htable,
+				  void (*free_key)(void *));
+void (*rcuHashTableGetFreeValueMethod(RCUHashTable *htable))(void *);
+void rcuHashTableSetFreeValueMethod(RCUHashTable *htable,
+				    void (*free_value)(void *));
+RCUHashTableReader *rcuHashTableRegisterReader(RCUHashTable *htable);
+void rcuHashTableUnregisterReader(RCUHashTableReader *reader);
+void rcuHashTableQuiescent(RCUHashTableReader *reader);
+void rcuHashTableOnline(RCUHashTableReader *reader);
+void rcuHashTableOffline(RCUHashTableReader *reader);
+size_t rcuHashTableSize(RCUHashTable *htable);
+int rcuHashTableContains(RCUHashTable *htable, void *key);
+void *rcuHashTableGet(RCUHashTable *htable, void *key);
+void rcuHashTableSet(RCUHashTable *htable, void *key, void *value);
+void *rcuHashTableRemove(RCUHashTable *htable, void *key);
+void rcuHashTableDel(RCUHashTable *htable, void *key);
+void rcuHashTableSynchronize(RCUHashTable *htable);
+void rcuHashTableClear(RCUHashTable *htable);
+void rcuHashTableDestroy(RCUHashTable *htable);
+
+#endif
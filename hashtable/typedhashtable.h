@@ -0,0 +1,242 @@
+#ifndef TYPEDHASHTABLE_H
+#define TYPEDHASHTABLE_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define CDS_HASHTABLE_MIN_SIZE 8
+/* grow beyond 3/4 full, shrink below 1/8 */
+#define CDS_HASHTABLE_LOAD_NUM 3
+#define CDS_HASHTABLE_LOAD_DEN 4
+#define CDS_HASHTABLE_SHRINK_DEN 8
+
+/*
+ * Generates a linear probing hash table named name with keys of type K and
+ * values of type V stored by value. hash(key) returns a size_t and
+ * eq(key1, key2) returns non-zero for equal keys; both are expanded in
+ * place, so functions declared static inline (or macros) get inlined.
+ * Lookups return a pointer to the stored value, valid until the next
+ * insert or remove.
+ */
+#define CDS_DEFINE_HASHTABLE(name, K, V, hash, eq)			\
+typedef struct name##Slot {						\
+	K key;								\
+	V value;							\
+} name##Slot;								\
+									\
+typedef struct name {							\
+	name##Slot *slots;						\
+	unsigned char *used;						\
+	size_t count;							\
+	/* size always equals to 2^n */					\
+	size_t size;							\
+									\
+	void *(*alloc)(size_t);						\
+	void (*dealloc)(void *);					\
+} name;									\
+									\
+typedef struct name##Iter {						\
+	name *table;							\
+	size_t index;							\
+} name##Iter;								\
+									\
+static inline name *name##Create(void *(*alloc)(size_t),		\
+				 void (*dealloc)(void *))		\
+{									\
+	name *table = alloc(sizeof(name));				\
+	memset(table, 0, sizeof(name));					\
+	table->alloc = alloc;						\
+	table->dealloc = dealloc;					\
+	return table;							\
+}									\
+									\
+static inline size_t name##Size(name *table) { return table->count; }	\
+									\
+static inline size_t name##FindIndex(name *table, K key)		\
+{									\
+	size_t mask = table->size - 1;					\
+	size_t index = (size_t)hash(key) & mask;			\
+	while (table->used[index] && !eq(table->slots[index].key, key)) { \
+		index = (index + 1) & mask;				\
+	}								\
+									\
+	return index;							\
+}									\
+									\
+static inline void name##Resize(name *table, size_t size)		\
+{									\
+	name##Slot *slots = table->slots;				\
+	unsigned char *used = table->used;				\
+	size_t old_size = table->size;					\
+									\
+	table->slots = table->alloc(sizeof(name##Slot) * size);		\
+	table->used = table->alloc(size);				\
+	memset(table->used, 0, size);					\
+	table->size = size;						\
+									\
+	size_t i;							\
+	size_t index;							\
+	for (i = 0; i < old_size; ++i) {				\
+		if (!used[i]) {						\
+			continue;					\
+		}							\
+									\
+		index = (size_t)hash(slots[i].key) & (size - 1);	\
+		while (table->used[index]) {				\
+			index = (index + 1) & (size - 1);		\
+		}							\
+									\
+		table->used[index] = 1;					\
+		table->slots[index] = slots[i];				\
+	}								\
+									\
+	if (slots != NULL) {						\
+		table->dealloc(slots);					\
+		table->dealloc(used);					\
+	}								\
+}									\
+									\
+static inline void name##Reserve(name *table, size_t size)		\
+{									\
+	size_t slots = CDS_HASHTABLE_MIN_SIZE;				\
+	while (slots * CDS_HASHTABLE_LOAD_NUM <				\
+	       size * CDS_HASHTABLE_LOAD_DEN) {				\
+		slots <<= 1;						\
+	}								\
+									\
+	if (slots > table->size) {					\
+		name##Resize(table, slots);				\
+	}								\
+}									\
+									\
+/* an update never grows, only an insert into a free slot may */	\
+static inline void name##Set(name *table, K key, V value)		\
+{									\
+	size_t index = 0;						\
+	if (table->size > 0) {						\
+		index = name##FindIndex(table, key);			\
+		if (table->used[index]) {				\
+			table->slots[index].value = value;		\
+			return;						\
+		}							\
+	}								\
+									\
+	size_t size = table->size;					\
+	name##Reserve(table, table->count + 1);				\
+	if (table->size != size) {					\
+		index = name##FindIndex(table, key);			\
+	}								\
+									\
+	table->used[index] = 1;						\
+	table->slots[index].key = key;					\
+	table->slots[index].value = value;				\
+	++table->count;							\
+}									\
+									\
+static inline V *name##Get(name *table, K key)				\
+{									\
+	if (table->count == 0) {					\
+		return NULL;						\
+	}								\
+									\
+	size_t index = name##FindIndex(table, key);			\
+	return table->used[index] ? &table->slots[index].value : NULL;	\
+}									\
+									\
+static inline int name##Contains(name *table, K key)			\
+{									\
+	return name##Get(table, key) != NULL;				\
+}									\
+									\
+/* backward shift deletion, so the table never holds tombstones */	\
+static inline int name##Remove(name *table, K key, V *value_ptr)	\
+{									\
+	if (table->count == 0) {					\
+		return 0;						\
+	}								\
+									\
+	size_t mask = table->size - 1;					\
+	size_t index = name##FindIndex(table, key);			\
+	if (!table->used[index]) {					\
+		return 0;						\
+	}								\
+									\
+	if (value_ptr != NULL) {					\
+		*value_ptr = table->slots[index].value;			\
+	}								\
+									\
+	size_t next = index;						\
+	size_t home;							\
+	for (;;) {							\
+		next = (next + 1) & mask;				\
+		if (!table->used[next]) {				\
+			break;						\
+		}							\
+									\
+		home = (size_t)hash(table->slots[next].key) & mask;	\
+		if (((next - home) & mask) >= ((next - index) & mask)) { \
+			table->slots[index] = table->slots[next];	\
+			index = next;					\
+		}							\
+	}								\
+									\
+	table->used[index] = 0;						\
+	--table->count;							\
+									\
+	if (table->size > CDS_HASHTABLE_MIN_SIZE &&			\
+	    table->count * CDS_HASHTABLE_SHRINK_DEN < table->size) {	\
+		name##Resize(table, table->size >> 1);			\
+	}								\
+									\
+	return 1;							\
+}									\
+									\
+static inline void name##Clear(name *table)				\
+{									\
+	if (table->slots != NULL) {					\
+		table->dealloc(table->slots);				\
+		table->dealloc(table->used);				\
+	}								\
+									\
+	table->slots = NULL;						\
+	table->used = NULL;						\
+	table->count = 0;						\
+	table->size = 0;						\
+}									\
+									\
+static inline void name##Destroy(name *table)				\
+{									\
+	name##Clear(table);						\
+	table->dealloc(table);						\
+}									\
+									\
+static inline void name##IterSeek(name##Iter *iter)			\
+{									\
+	while (iter->index < iter->table->size &&			\
+	       !iter->table->used[iter->index]) {			\
+		++iter->index;						\
+	}								\
+}									\
+									\
+static inline void name##IterInit(name##Iter *iter, name *table)	\
+{									\
+	iter->table = table;						\
+	iter->index = 0;						\
+	name##IterSeek(iter);						\
+}									\
+									\
+static inline int name##IterHasNext(name##Iter *iter)			\
+{									\
+	return iter->index < iter->table->size;				\
+}									\
+									\
+static inline void name##IterNext(name##Iter *iter, K *key_ptr,		\
+				  V *value_ptr)				\
+{									\
+	*key_ptr = iter->table->slots[iter->index].key;			\
+	*value_ptr = iter->table->slots[iter->index].value;		\
+	++iter->index;							\
+	name##IterSeek(iter);						\
+}
+
+#endif
@@ -0,0 +1,459 @@
+#include "deque.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DIRECTION_ASCENDING 1
+#define DIRECTION_DESCENDING 0
+
+#define DEQUE_MIN_CAPACITY 8
+
+/*
+ * Values live in one circular array whose capacity is 0 or a power of 2,
+ * the first one at head. The array wraps at most once, so the values are
+ * always one or two contiguous spans that callers can scan directly.
+ */
+struct Deque {
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	void *(*dup)(void *);
+	void (*free)(void *);
+	int (*compare)(void *, void *);
+
+	void **values;
+	size_t capacity;
+	size_t head;
+	size_t length;
+};
+
+/* next walks the array directly and jumps to the other end at wrap */
+struct DequeIter {
+	int direction;
+	void (*dealloc)(void *);
+	void **values;
+	void **last;
+	void **next;
+	size_t remaining;
+};
+
+#define dequeSlot(deque, index)						\
+	((deque)->values[((deque)->head + (index)) & ((deque)->capacity - 1)])
+
+Deque *dequeCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
+{
+	Deque *deque = alloc(sizeof(Deque));
+	if (deque == NULL) {
+		return NULL;
+	}
+
+	memset(deque, 0, sizeof(Deque));
+	deque->alloc = alloc;
+	deque->dealloc = dealloc;
+
+	return deque;
+}
+
+void dequeSetDupMethod(Deque *deque, void *(*dup)(void *))
+{
+	deque->dup = dup;
+}
+
+void dequeSetFreeMethod(Deque *deque, void (*free)(void *))
+{
+	deque->free = free;
+}
+
+void dequeSetCompareMethod(Deque *deque, int (*compare)(void *, void *))
+{
+	deque->compare = compare;
+}
+
+void *(*dequeGetDupMethod(Deque *deque))(void *) { return deque->dup; }
+
+void (*dequeGetFreeMethod(Deque *deque))(void *) { return deque->free; }
+
+int (*dequeGetCompareMethod(Deque *deque))(void *, void *)
+{
+	return deque->compare;
+}
+
+size_t dequeLength(Deque *deque) { return deque->length; }
+
+size_t dequeCapacity(Deque *deque) { return deque->capacity; }
+
+/* the values from index on are contiguous up to the returned count */
+static inline size_t dequeContiguous(Deque *deque, size_t index, size_t n)
+{
+	size_t start = (deque->head + index) & (deque->capacity - 1);
+	size_t room = deque->capacity - start;
+	return n < room ? n : room;
+}
+
+static void dequeCopyOut(Deque *deque, size_t index, void **dest, size_t n)
+{
+	if (n == 0) {
+		return;
+	}
+
+	size_t first = dequeContiguous(deque, index, n);
+	memcpy(dest, &dequeSlot(deque, index), first * sizeof(void *));
+	memcpy(dest + first, deque->values, (n - first) * sizeof(void *));
+}
+
+static void dequeCopyIn(Deque *deque, size_t index, void **src, size_t n)
+{
+	if (n == 0) {
+		return;
+	}
+
+	size_t first = dequeContiguous(deque, index, n);
+	memcpy(&dequeSlot(deque, index), src, first * sizeof(void *));
+	memcpy(deque->values, src + first, (n - first) * sizeof(void *));
+}
+
+static void dequeResize(Deque *deque, size_t capacity)
+{
+	void **values = NULL;
+	if (capacity > 0) {
+		values = deque->alloc(capacity * sizeof(void *));
+		dequeCopyOut(deque, 0, values, deque->length);
+	}
+
+	if (deque->values != NULL) {
+		deque->dealloc(deque->values);
+	}
+
+	deque->values = values;
+	deque->capacity = capacity;
+	deque->head = 0;
+}
+
+static size_t dequeRoundCapacity(size_t capacity)
+{
+	size_t size = DEQUE_MIN_CAPACITY;
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	return size;
+}
+
+void dequeReserve(Deque *deque, size_t capacity)
+{
+	if (capacity > deque->capacity) {
+		dequeResize(deque, dequeRoundCapacity(capacity));
+	}
+}
+
+void dequeShrinkToFit(Deque *deque)
+{
+	size_t capacity =
+	    deque->length > 0 ? dequeRoundCapacity(deque->length) : 0;
+	if (capacity < deque->capacity) {
+		dequeResize(deque, capacity);
+	}
+}
+
+void dequePushHead(Deque *deque, void *value)
+{
+	dequeReserve(deque, deque->length + 1);
+	deque->head = (deque->head - 1) & (deque->capacity - 1);
+	deque->values[deque->head] = value;
+	++deque->length;
+}
+
+void dequePushTail(Deque *deque, void *value)
+{
+	dequeReserve(deque, deque->length + 1);
+	dequeSlot(deque, deque->length) = value;
+	++deque->length;
+}
+
+/* values keep their order, values[0] becomes the head */
+void dequePushHeadMany(Deque *deque, void **values, size_t n)
+{
+	dequeReserve(deque, deque->length + n);
+	deque->head = (deque->head - n) & (deque->capacity - 1);
+	deque->length += n;
+	dequeCopyIn(deque, 0, values, n);
+}
+
+void dequePushTailMany(Deque *deque, void **values, size_t n)
+{
+	dequeReserve(deque, deque->length + n);
+	deque->length += n;
+	dequeCopyIn(deque, deque->length - n, values, n);
+}
+
+/* shifts whichever side of index is shorter */
+void dequeInsert(Deque *deque, size_t index, void *value)
+{
+	assert(index <= deque->length);
+
+	dequeReserve(deque, deque->length + 1);
+	size_t i;
+	if (index < deque->length / 2) {
+		deque->head = (deque->head - 1) & (deque->capacity - 1);
+		for (i = 0; i < index; ++i) {
+			dequeSlot(deque, i) = dequeSlot(deque, i + 1);
+		}
+	} else {
+		for (i = deque->length; i > index; --i) {
+			dequeSlot(deque, i) = dequeSlot(deque, i - 1);
+		}
+	}
+
+	dequeSlot(deque, index) = value;
+	++deque->length;
+}
+
+size_t dequeSpans(Deque *deque, void ***span1, size_t *length1,
+		  void ***span2, size_t *length2)
+{
+	*span1 = NULL;
+	*span2 = NULL;
+	*length1 = 0;
+	*length2 = 0;
+	if (deque->length == 0) {
+		return 0;
+	}
+
+	*span1 = deque->values + deque->head;
+	*length1 = dequeContiguous(deque, 0, deque->length);
+	if (*length1 == deque->length) {
+		return 1;
+	}
+
+	*span2 = deque->values;
+	*length2 = deque->length - *length1;
+	return 2;
+}
+
+static size_t dequeFind(Deque *deque, void *value)
+{
+	void **spans[2];
+	size_t lengths[2];
+	dequeSpans(deque, &spans[0], &lengths[0], &spans[1], &lengths[1]);
+
+	size_t span;
+	size_t i;
+	for (span = 0; span < 2; ++span) {
+		for (i = 0; i < lengths[span]; ++i) {
+			if (deque->compare(spans[span][i], value) == 0) {
+				return span == 0 ? i : lengths[0] + i;
+			}
+		}
+	}
+
+	return deque->length;
+}
+
+int dequeContains(Deque *deque, void *value)
+{
+	return dequeFind(deque, value) < deque->length;
+}
+
+void *dequeIndex(Deque *deque, size_t index)
+{
+	if (index >= deque->length) {
+		return NULL;
+	}
+
+	return dequeSlot(deque, index);
+}
+
+void dequeSetIndex(Deque *deque, size_t index, void *value)
+{
+	assert(index < deque->length);
+
+	dequeSlot(deque, index) = value;
+}
+
+void *dequePopHead(Deque *deque)
+{
+	if (deque->length == 0) {
+		return NULL;
+	}
+
+	void *value = deque->values[deque->head];
+	deque->head = (deque->head + 1) & (deque->capacity - 1);
+	--deque->length;
+	return value;
+}
+
+void *dequePopTail(Deque *deque)
+{
+	if (deque->length == 0) {
+		return NULL;
+	}
+
+	--deque->length;
+	return dequeSlot(deque, deque->length);
+}
+
+size_t dequePopHeadMany(Deque *deque, void **values, size_t n)
+{
+	if (n > deque->length) {
+		n = deque->length;
+	}
+
+	dequeCopyOut(deque, 0, values, n);
+	deque->head = (deque->head + n) & (deque->capacity - 1);
+	deque->length -= n;
+	return n;
+}
+
+/* the popped values keep their order, the tail ends up last */
+size_t dequePopTailMany(Deque *deque, void **values, size_t n)
+{
+	if (n > deque->length) {
+		n = deque->length;
+	}
+
+	deque->length -= n;
+	dequeCopyOut(deque, deque->length, values, n);
+	return n;
+}
+
+void *dequeRemove(Deque *deque, size_t index)
+{
+	assert(index < deque->length);
+
+	void *value = dequeSlot(deque, index);
+	size_t i;
+	if (index < deque->length / 2) {
+		for (i = index; i > 0; --i) {
+			dequeSlot(deque, i) = dequeSlot(deque, i - 1);
+		}
+
+		deque->head = (deque->head + 1) & (deque->capacity - 1);
+	} else {
+		for (i = index; i + 1 < deque->length; ++i) {
+			dequeSlot(deque, i) = dequeSlot(deque, i + 1);
+		}
+	}
+
+	--deque->length;
+	return value;
+}
+
+void dequeDel(Deque *deque, void *value)
+{
+	size_t index = dequeFind(deque, value);
+	if (index == deque->length) {
+		return;
+	}
+
+	value = dequeRemove(deque, index);
+	if (deque->free != NULL) {
+		deque->free(value);
+	}
+}
+
+Deque *dequeDup(Deque *deque)
+{
+	Deque *d = dequeCreate(deque->alloc, deque->dealloc);
+	d->dup = deque->dup;
+	d->free = deque->free;
+	d->compare = deque->compare;
+
+	dequeReserve(d, deque->length);
+	d->length = deque->length;
+	dequeCopyOut(deque, 0, d->values, deque->length);
+	if (deque->dup != NULL) {
+		size_t i;
+		for (i = 0; i < d->length; ++i) {
+			d->values[i] = deque->dup(d->values[i]);
+		}
+	}
+
+	return d;
+}
+
+void dequeReverse(Deque *deque)
+{
+	size_t i;
+	size_t j;
+	for (i = 0, j = deque->length; i + 1 < j; ++i, --j) {
+		void *tmp = dequeSlot(deque, i);
+		dequeSlot(deque, i) = dequeSlot(deque, j - 1);
+		dequeSlot(deque, j - 1) = tmp;
+	}
+}
+
+/* keeps the array, dequeShrinkToFit gives it back */
+void dequeClear(Deque *deque)
+{
+	if (deque->free != NULL) {
+		size_t i;
+		for (i = 0; i < deque->length; ++i) {
+			deque->free(dequeSlot(deque, i));
+		}
+	}
+
+	deque->head = 0;
+	deque->length = 0;
+}
+
+void dequeDestroy(Deque *deque)
+{
+	dequeClear(deque);
+	if (deque->values != NULL) {
+		deque->dealloc(deque->values);
+	}
+
+	deque->dealloc(deque);
+}
+
+static DequeIter *dequeIterCreate(Deque *deque, int direction)
+{
+	DequeIter *iter = deque->alloc(sizeof(DequeIter));
+	iter->direction = direction;
+	iter->dealloc = deque->dealloc;
+	iter->values = deque->values;
+	iter->last = NULL;
+	iter->next = NULL;
+	iter->remaining = deque->length;
+	if (deque->length == 0) {
+		return iter;
+	}
+
+	iter->last = deque->values + deque->capacity - 1;
+	if (direction == DIRECTION_ASCENDING) {
+		iter->next = &dequeSlot(deque, 0);
+	} else {
+		iter->next = &dequeSlot(deque, deque->length - 1);
+	}
+
+	return iter;
+}
+
+DequeIter *dequeIterator(Deque *deque)
+{
+	return dequeIterCreate(deque, DIRECTION_ASCENDING);
+}
+
+DequeIter *dequeReverseIterator(Deque *deque)
+{
+	return dequeIterCreate(deque, DIRECTION_DESCENDING);
+}
+
+int dequeIterHasNext(DequeIter *iter) { return iter->remaining > 0; }
+
+void *dequeIterNext(DequeIter *iter)
+{
+	void *value = *iter->next;
+	if (iter->direction) {
+		iter->next = iter->next == iter->last ? iter->values
+						      : iter->next + 1;
+	} else {
+		iter->next = iter->next == iter->values ? iter->last
+							: iter->next - 1;
+	}
+
+	--iter->remaining;
+	return value;
+}
+
+void dequeIterDestroy(DequeIter *iter) { iter->dealloc(iter); }
@@ -0,0 +1,48 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stddef.h>
+
+typedef struct Deque Deque;
+typedef struct DequeIter DequeIter;
+
+Deque *dequeCreate(void *(*alloc)(size_t), void (*dealloc)(void *));
+void dequeSetDupMethod(Deque *deque, void *(*dup)(void *));
+void dequeSetFreeMethod(Deque *deque, void (*free)(void *));
+void dequeSetCompareMethod(Deque *deque, int (*compare)(void *, void *));
+void *(*dequeGetDupMethod(Deque *deque))(void *);
+void (*dequeGetFreeMethod(Deque *deque))(void *);
+int (*dequeGetCompareMethod(Deque *deque))(void *, void *);
+size_t dequeLength(Deque *deque);
+size_t dequeCapacity(Deque *deque);
+void dequeReserve(Deque *deque, size_t capacity);
+void dequeShrinkToFit(Deque *deque);
+void dequePushHead(Deque *deque, void *value);
+void dequePushTail(Deque *deque, void *value);
+void dequePushHeadMany(Deque *deque, void **values, size_t n);
+void dequePushTailMany(Deque *deque, void **values, size_t n);
+void dequeInsert(Deque *deque, size_t index, void *value);
+int dequeContains(Deque *deque, void *value);
+void *dequeIndex(Deque *deque, size_t index);
+void dequeSetIndex(Deque *deque, size_t index, void *value);
+void *dequePopHead(Deque *deque);
+void *dequePopTail(Deque *deque);
+size_t dequePopHeadMany(Deque *deque, void **values, size_t n);
+size_t dequePopTailMany(Deque *deque, void **values, size_t n);
+void *dequeRemove(Deque *deque, size_t index);
+void dequeDel(Deque *deque, void *value);
+/* scanning the spans is faster than an iterator, no call per value */
+size_t dequeSpans(Deque *deque, void ***span1, size_t *length1,
+		  void ***span2, size_t *length2);
+Deque *dequeDup(Deque *deque);
+void dequeReverse(Deque *deque);
+void dequeClear(Deque *deque);
+void dequeDestroy(Deque *deque);
+DequeIter *dequeIterator(Deque *deque);
+DequeIter *dequeReverseIterator(Deque *deque);
+
+int dequeIterHasNext(DequeIter *iter);
+void *dequeIterNext(DequeIter *iter);
+void dequeIterDestroy(DequeIter *iter);
+
+#endif
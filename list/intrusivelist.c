@@ -0,0 +1,127 @@
+#include "intrusivelist.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+/*
+ * The links live inside the caller's objects and the list never
+ * allocates. The list is circular around its own head link, so linking
+ * and unlinking need no special cases. Unlinked links are NULLed to tell
+ * whether an object is still on a list.
+ */
+void intrusiveListInit(IntrusiveList *list)
+{
+	list->head.prev = &list->head;
+	list->head.next = &list->head;
+	list->length = 0;
+}
+
+void intrusiveLinkInit(ListLink *link)
+{
+	link->prev = NULL;
+	link->next = NULL;
+}
+
+int intrusiveLinkIsLinked(ListLink *link) { return link->next != NULL; }
+
+size_t intrusiveListLength(IntrusiveList *list) { return list->length; }
+
+ListLink *intrusiveListHead(IntrusiveList *list)
+{
+	return list->length > 0 ? list->head.next : NULL;
+}
+
+ListLink *intrusiveListTail(IntrusiveList *list)
+{
+	return list->length > 0 ? list->head.prev : NULL;
+}
+
+ListLink *intrusiveListNext(IntrusiveList *list, ListLink *link)
+{
+	return link->next != &list->head ? link->next : NULL;
+}
+
+ListLink *intrusiveListPrev(IntrusiveList *list, ListLink *link)
+{
+	return link->prev != &list->head ? link->prev : NULL;
+}
+
+static inline void intrusiveListLink(IntrusiveList *list, ListLink *prev,
+				     ListLink *link)
+{
+	assert(!intrusiveLinkIsLinked(link));
+
+	link->prev = prev;
+	link->next = prev->next;
+	prev->next->prev = link;
+	prev->next = link;
+	++list->length;
+}
+
+static inline void intrusiveListUnlink(IntrusiveList *list, ListLink *link)
+{
+	link->prev->next = link->next;
+	link->next->prev = link->prev;
+	link->prev = NULL;
+	link->next = NULL;
+	--list->length;
+}
+
+void intrusiveListPushHead(IntrusiveList *list, ListLink *link)
+{
+	intrusiveListLink(list, &list->head, link);
+}
+
+void intrusiveListPushTail(IntrusiveList *list, ListLink *link)
+{
+	intrusiveListLink(list, list->head.prev, link);
+}
+
+void intrusiveListInsertBefore(IntrusiveList *list, ListLink *pos,
+			       ListLink *link)
+{
+	intrusiveListLink(list, pos->prev, link);
+}
+
+void intrusiveListInsertAfter(IntrusiveList *list, ListLink *pos,
+			      ListLink *link)
+{
+	intrusiveListLink(list, pos, link);
+}
+
+ListLink *intrusiveListPopHead(IntrusiveList *list)
+{
+	ListLink *link = intrusiveListHead(list);
+	if (link != NULL) {
+		intrusiveListUnlink(list, link);
+	}
+
+	return link;
+}
+
+ListLink *intrusiveListPopTail(IntrusiveList *list)
+{
+	ListLink *link = intrusiveListTail(list);
+	if (link != NULL) {
+		intrusiveListUnlink(list, link);
+	}
+
+	return link;
+}
+
+void intrusiveListRemove(IntrusiveList *list, ListLink *link)
+{
+	intrusiveListUnlink(list, link);
+}
+
+void intrusiveListMoveToHead(IntrusiveList *list, ListLink *link)
+{
+	intrusiveListUnlink(list, link);
+	intrusiveListLink(list, &list->head, link);
+}
+
+void intrusiveListMoveToTail(IntrusiveList *list, ListLink *link)
+{
+	intrusiveListUnlink(list, link);
+	intrusiveListLink(list, list->head.prev, link);
+}
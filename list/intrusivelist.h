@@ -0,0 +1,45 @@
+#ifndef INTRUSIVELIST_H
+#define INTRUSIVELIST_H
+
+#include <stddef.h>
+
+#ifndef containerOf
+#define containerOf(ptr, type, member)					\
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+typedef struct ListLink {
+	struct ListLink *prev;
+	struct ListLink *next;
+} ListLink;
+
+typedef struct IntrusiveList {
+	ListLink head;
+	size_t length;
+} IntrusiveList;
+
+#define intrusiveListForEach(list, link)				\
+	for ((link) = (list)->head.next; (link) != &(list)->head;	\
+	     (link) = (link)->next)
+
+void intrusiveListInit(IntrusiveList *list);
+void intrusiveLinkInit(ListLink *link);
+int intrusiveLinkIsLinked(ListLink *link);
+size_t intrusiveListLength(IntrusiveList *list);
+ListLink *intrusiveListHead(IntrusiveList *list);
+ListLink *intrusiveListTail(IntrusiveList *list);
+ListLink *intrusiveListNext(IntrusiveList *list, ListLink *link);
+ListLink *intrusiveListPrev(IntrusiveList *list, ListLink *link);
+void intrusiveListPushHead(IntrusiveList *list, ListLink *link);
+void intrusiveListPushTail(IntrusiveList *list, ListLink *link);
+void intrusiveListInsertBefore(IntrusiveList *list, ListLink *pos,
+			       ListLink *link);
+void intrusiveListInsertAfter(IntrusiveList *list, ListLink *pos,
+			      ListLink *link);
+ListLink *intrusiveListPopHead(IntrusiveList *list);
+ListLink *intrusiveListPopTail(IntrusiveList *list);
+void intrusiveListRemove(IntrusiveList *list, ListLink *link);
+void intrusiveListMoveToHead(IntrusiveList *list, ListLink *link);
+void intrusiveListMoveToTail(IntrusiveList *list, ListLink *link);
+
+#endif
@@ -1,6 +1,8 @@
 #include "list.h"
+#include "pool.h"
 
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,11 +11,11 @@
 #define DIRECTION_ASCENDING 1
 #define DIRECTION_DESCENDING 0
 
-typedef struct ListNode {
-	void *value;
-	struct ListNode *prev;
-	struct ListNode *next;
-} ListNode;
+/* pending runs of the bottom-up sort, enough for 2^64 nodes */
+#define LIST_SORT_BINS 64
+#define LIST_SORT_MAX_THREADS 64
+/* shorter lists aren't worth starting threads for */
+#define LIST_PARALLEL_SORT_MIN 16384
 
 struct List {
 	void *(*alloc)(size_t);
@@ -25,14 +27,19 @@ struct List {
 	size_t length;
 	struct ListNode *head;
 	struct ListNode *tail;
-};
 
-struct ListIter {
-	int direction;
-	void (*dealloc)(void *);
-	struct ListNode *next;
+	Pool *pool;
 };
 
+typedef struct ListSortTask {
+	pthread_t thread;
+	int started;
+	int (*compare)(void *, void *);
+	ListNode *chain;
+	/* merged into chain when set, chain gets sorted otherwise */
+	ListNode *other;
+} ListSortTask;
+
 List *listCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
 {
 	List *list = alloc(sizeof(List));
@@ -47,6 +54,48 @@ List *listCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
 	return list;
 }
 
+List *listCreatePooled(void *(*alloc)(size_t), void (*dealloc)(void *))
+{
+	List *list = listCreate(alloc, dealloc);
+	if (list == NULL) {
+		return NULL;
+	}
+
+	list->pool = poolCreate(alloc, dealloc, sizeof(ListNode),
+				POOL_DEFAULT_SLAB_NODES);
+	return list;
+}
+
+List *listCreateWithPool(void *(*alloc)(size_t), void (*dealloc)(void *),
+			 Pool *pool)
+{
+	List *list = listCreate(alloc, dealloc);
+	if (list == NULL) {
+		return NULL;
+	}
+
+	list->pool = poolRetain(pool);
+	return list;
+}
+
+static inline ListNode *listAllocNode(List *list)
+{
+	if (list->pool != NULL) {
+		return poolAlloc(list->pool);
+	}
+
+	return list->alloc(sizeof(ListNode));
+}
+
+static inline void listFreeNode(List *list, ListNode *node)
+{
+	if (list->pool != NULL) {
+		poolFree(list->pool, node);
+	} else {
+		list->dealloc(node);
+	}
+}
+
 void listSetDupMethod(List *list, void *(*dup)(void *)) { list->dup = dup; }
 
 void listSetFreeMethod(List *list, void (*free)(void *)) { list->free = free; }
@@ -67,9 +116,9 @@ int (*listGetCompareMethod(List *list))(void *, void *)
 
 size_t listLength(List *list) { return list->length; }
 
-void listPushHead(List *list, void *value)
+ListNode *listPushHead(List *list, void *value)
 {
-	ListNode *node = list->alloc(sizeof(ListNode));
+	ListNode *node = listAllocNode(list);
 	node->value = value;
 
 	if (list->length != 0) {
@@ -83,11 +132,12 @@ void listPushHead(List *list, void *value)
 	list->head = node;
 
 	++list->length;
+	return node;
 }
 
-void listPushTail(List *list, void *value)
+ListNode *listPushTail(List *list, void *value)
 {
-	ListNode *node = list->alloc(sizeof(ListNode));
+	ListNode *node = listAllocNode(list);
 	node->value = value;
 
 	if (list->length != 0) {
@@ -101,6 +151,7 @@ void listPushTail(List *list, void *value)
 	list->tail = node;
 
 	++list->length;
+	return node;
 }
 
 void listInsert(List *list, int index, void *value)
@@ -117,7 +168,7 @@ void listInsert(List *list, int index, void *value)
 		return;
 	}
 
-	ListNode *newNode = list->alloc(sizeof(ListNode));
+	ListNode *newNode = listAllocNode(list);
 	newNode->value = value;
 
 	int i;
@@ -150,6 +201,8 @@ int listContains(List *list, void *value)
 		if (list->compare(node->value, value) == 0) {
 			return 1;
 		}
+
+		node = node->next;
 	}
 
 	return 0;
@@ -171,7 +224,7 @@ void *listIndex(List *list, int index)
 		node = node->next;
 	}
 
-	return node;
+	return node->value;
 }
 
 static void _listRemove(List *list, ListNode *node)
@@ -202,6 +255,71 @@ static void _listRemove(List *list, ListNode *node)
 	--list->length;
 }
 
+ListNode *listHead(List *list) { return list->head; }
+
+ListNode *listTail(List *list) { return list->tail; }
+
+ListNode *listNodePrev(ListNode *node) { return node->prev; }
+
+ListNode *listNodeNext(ListNode *node) { return node->next; }
+
+void *listNodeValue(ListNode *node) { return node->value; }
+
+void listMoveToHead(List *list, ListNode *node)
+{
+	if (list->head == node) {
+		return;
+	}
+
+	_listRemove(list, node);
+	node->prev = NULL;
+	node->next = list->head;
+	if (list->head != NULL) {
+		list->head->prev = node;
+	} else {
+		list->tail = node;
+	}
+
+	list->head = node;
+	++list->length;
+}
+
+void listMoveToTail(List *list, ListNode *node)
+{
+	if (list->tail == node) {
+		return;
+	}
+
+	_listRemove(list, node);
+	node->prev = list->tail;
+	node->next = NULL;
+	if (list->tail != NULL) {
+		list->tail->next = node;
+	} else {
+		list->head = node;
+	}
+
+	list->tail = node;
+	++list->length;
+}
+
+void *listRemoveNode(List *list, ListNode *node)
+{
+	_listRemove(list, node);
+	void *value = node->value;
+	listFreeNode(list, node);
+
+	return value;
+}
+
+void listDelNode(List *list, ListNode *node)
+{
+	void *value = listRemoveNode(list, node);
+	if (list->free != NULL) {
+		list->free(value);
+	}
+}
+
 void *listPopHead(List *list) { return listRemove(list, 0); }
 
 void *listPopTail(List *list)
@@ -209,7 +327,7 @@ void *listPopTail(List *list)
 	ListNode *node = list->tail;
 	_listRemove(list, node);
 	void *value = node->value;
-	list->dealloc(node);
+	listFreeNode(list, node);
 
 	return value;
 }
@@ -230,7 +348,7 @@ void *listRemove(List *list, int index)
 
 	_listRemove(list, node);
 	void *value = node->value;
-	list->dealloc(node);
+	listFreeNode(list, node);
 
 	return value;
 }
@@ -256,15 +374,375 @@ void listDel(List *list, void *value)
 		list->free(node->value);
 	}
 
-	list->dealloc(node);
+	listFreeNode(list, node);
 }
 
-List *listDup(List *list)
+/*
+ * The sort works on chains linked by next only and NULL terminated,
+ * prev pointers are rebuilt once at the end. Left nodes win ties, so
+ * both the sort and the merge are stable.
+ */
+static ListNode *listMergeChains(int (*compare)(void *, void *),
+				 ListNode *left, ListNode *right)
+{
+	ListNode head;
+	ListNode *tail = &head;
+	while (left != NULL && right != NULL) {
+		if (compare(right->value, left->value) < 0) {
+			tail->next = right;
+			right = right->next;
+		} else {
+			tail->next = left;
+			left = left->next;
+		}
+
+		tail = tail->next;
+	}
+
+	tail->next = left != NULL ? left : right;
+	return head.next;
+}
+
+/* bins[i] holds a sorted run of 2^i nodes, merged like a binary counter */
+static ListNode *listSortChain(int (*compare)(void *, void *),
+			       ListNode *chain)
+{
+	ListNode *bins[LIST_SORT_BINS];
+	size_t used = 0;
+	size_t i;
+	while (chain != NULL) {
+		ListNode *run = chain;
+		chain = chain->next;
+		run->next = NULL;
+		for (i = 0; i < used && bins[i] != NULL; ++i) {
+			run = listMergeChains(compare, bins[i], run);
+			bins[i] = NULL;
+		}
+
+		if (i == used) {
+			++used;
+		}
+
+		bins[i] = run;
+	}
+
+	ListNode *sorted = NULL;
+	for (i = 0; i < used; ++i) {
+		if (bins[i] != NULL) {
+			sorted = listMergeChains(compare, bins[i], sorted);
+		}
+	}
+
+	return sorted;
+}
+
+static void listRelink(List *list, ListNode *chain)
 {
-	List *l = listCreate(list->alloc, list->dealloc);
+	ListNode *prev = NULL;
+	list->head = chain;
+	while (chain != NULL) {
+		chain->prev = prev;
+		prev = chain;
+		chain = chain->next;
+	}
+
+	list->tail = prev;
+}
+
+/* stable, in place and allocation free, ordered by the compare method */
+void listSort(List *list)
+{
+	if (list->length < 2) {
+		return;
+	}
+
+	listRelink(list, listSortChain(list->compare, list->head));
+}
+
+static void *listSortTask(void *arg)
+{
+	ListSortTask *task = arg;
+	if (task->other != NULL) {
+		task->chain =
+		    listMergeChains(task->compare, task->chain, task->other);
+	} else {
+		task->chain = listSortChain(task->compare, task->chain);
+	}
+
+	return NULL;
+}
+
+/* the first task runs on the calling thread, as do tasks failing to start */
+static void listRunSortTasks(ListSortTask *tasks, size_t n)
+{
+	size_t i;
+	for (i = 1; i < n; ++i) {
+		tasks[i].started = pthread_create(&tasks[i].thread, NULL,
+						  listSortTask, tasks + i) == 0;
+		if (!tasks[i].started) {
+			listSortTask(tasks + i);
+		}
+	}
+
+	listSortTask(tasks);
+	for (i = 1; i < n; ++i) {
+		if (tasks[i].started) {
+			pthread_join(tasks[i].thread, NULL);
+		}
+	}
+}
+
+/*
+ * Sorts one run per thread, then merges neighbouring runs pairwise with
+ * half as many threads each round. The result equals listSort's; compare
+ * must be safe to call from several threads.
+ */
+void listSortParallel(List *list, size_t threads)
+{
+	if (threads > LIST_SORT_MAX_THREADS) {
+		threads = LIST_SORT_MAX_THREADS;
+	}
+
+	if (threads < 2 || list->length < LIST_PARALLEL_SORT_MIN) {
+		listSort(list);
+		return;
+	}
+
+	ListSortTask tasks[LIST_SORT_MAX_THREADS];
+	size_t run_length = (list->length + threads - 1) / threads;
+	ListNode *node = list->head;
+	size_t runs = 0;
+	size_t i;
+	while (node != NULL) {
+		tasks[runs].compare = list->compare;
+		tasks[runs].chain = node;
+		tasks[runs].other = NULL;
+		for (i = 1; i < run_length && node->next != NULL; ++i) {
+			node = node->next;
+		}
+
+		ListNode *next = node->next;
+		node->next = NULL;
+		node = next;
+		++runs;
+	}
+
+	listRunSortTasks(tasks, runs);
+	while (runs > 1) {
+		for (i = 0; i + 1 < runs; i += 2) {
+			tasks[i / 2].chain = tasks[i].chain;
+			tasks[i / 2].other = tasks[i + 1].chain;
+		}
+
+		if (runs % 2 != 0) {
+			tasks[runs / 2].chain = tasks[runs - 1].chain;
+			tasks[runs / 2].other = NULL;
+		}
+
+		/* an odd run out is already sorted and waits a round */
+		listRunSortTasks(tasks, runs / 2);
+		runs = (runs + 1) / 2;
+	}
+
+	listRelink(list, tasks[0].chain);
+}
+
+/*
+ * Nodes belong to the pool they came from, so moving a detached chain
+ * between lists on different pools copies it into the target's nodes.
+ * Lists on the same pool, or both without one, keep the nodes.
+ */
+static void listAdopt(List *list, List *other, ListNode **first,
+		      ListNode **last)
+{
+	if (list->pool == other->pool) {
+		return;
+	}
+
+	ListNode *prev = NULL;
+	ListNode *node = *first;
+	ListNode *next;
+	*first = NULL;
+	for (; node != NULL; node = next) {
+		next = node->next;
+		ListNode *copy = listAllocNode(list);
+		copy->value = node->value;
+		copy->prev = prev;
+		copy->next = NULL;
+		if (prev != NULL) {
+			prev->next = copy;
+		} else {
+			*first = copy;
+		}
+
+		prev = copy;
+		listFreeNode(other, node);
+	}
+
+	*last = prev;
+}
+
+/* merges the sorted other into the sorted list and leaves other empty */
+void listMerge(List *list, List *other)
+{
+	assert(list != other);
+
+	ListNode *chain = other->head;
+	ListNode *last = other->tail;
+	listAdopt(list, other, &chain, &last);
+	list->length += other->length;
+	listRelink(list, listMergeChains(list->compare, list->head, chain));
+
+	other->head = NULL;
+	other->tail = NULL;
+	other->length = 0;
+}
+
+/* drops all but the first of every run of equal values of a sorted list */
+void listUnique(List *list)
+{
+	ListNode *node = list->head;
+	while (node != NULL && node->next != NULL) {
+		if (list->compare(node->value, node->next->value) == 0) {
+			listDelNode(list, node->next);
+		} else {
+			node = node->next;
+		}
+	}
+}
+
+/* detaches first..last, leaving a NULL terminated chain */
+static void listUnlinkRange(List *list, ListNode *first, ListNode *last,
+			    size_t count)
+{
+	if (first->prev != NULL) {
+		first->prev->next = last->next;
+	} else {
+		list->head = last->next;
+	}
+
+	if (last->next != NULL) {
+		last->next->prev = first->prev;
+	} else {
+		list->tail = first->prev;
+	}
+
+	first->prev = NULL;
+	last->next = NULL;
+	list->length -= count;
+}
+
+/* links a detached chain after node, or at the head when node is NULL */
+static void listLinkRange(List *list, ListNode *node, ListNode *first,
+			  ListNode *last, size_t count)
+{
+	ListNode *next = node != NULL ? node->next : list->head;
+	first->prev = node;
+	last->next = next;
+	if (node != NULL) {
+		node->next = first;
+	} else {
+		list->head = first;
+	}
+
+	if (next != NULL) {
+		next->prev = last;
+	} else {
+		list->tail = last;
+	}
+
+	list->length += count;
+}
+
+/*
+ * Moves the count nodes first..last of other after node of list, or to
+ * its head when node is NULL. Within one list node must lie outside the
+ * range. O(1) unless the lists are on different pools.
+ */
+void listMoveRange(List *list, ListNode *node, List *other, ListNode *first,
+		   ListNode *last, size_t count)
+{
+	if (count == 0) {
+		return;
+	}
+
+	listUnlinkRange(other, first, last, count);
+	listAdopt(list, other, &first, &last);
+	listLinkRange(list, node, first, last, count);
+}
+
+/* moves all of other after node of list and leaves other empty */
+void listSplice(List *list, ListNode *node, List *other)
+{
+	listMoveRange(list, node, other, other->head, other->tail,
+		      other->length);
+}
+
+void listJoin(List *list, List *other)
+{
+	listSplice(list, list->tail, other);
+}
+
+static List *listCreateLike(List *list)
+{
+	List *l;
+	if (list->pool != NULL) {
+		l = listCreateWithPool(list->alloc, list->dealloc, list->pool);
+	} else {
+		l = listCreate(list->alloc, list->dealloc);
+	}
 	l->free = list->free;
 	l->dup = list->dup;
 	l->compare = list->compare;
+	return l;
+}
+
+/* the new list takes the count nodes from first on to the tail */
+static List *listSplitFrom(List *list, ListNode *first, size_t count)
+{
+	List *l = listCreateLike(list);
+	listMoveRange(l, NULL, list, first, list->tail, count);
+	return l;
+}
+
+/* the returned list takes node and everything after it, NULL takes none */
+List *listSplitNode(List *list, ListNode *node)
+{
+	size_t count = 0;
+	ListNode *tmp;
+	for (tmp = node; tmp != NULL; tmp = tmp->next) {
+		++count;
+	}
+
+	return listSplitFrom(list, node, count);
+}
+
+/* the returned list takes the nodes from index on */
+List *listSplit(List *list, int index)
+{
+	assert(index >= 0 && index <= list->length);
+
+	size_t count = list->length - index;
+	ListNode *node;
+	size_t i;
+	if (index <= count) {
+		node = list->head;
+		for (i = 0; i < index; ++i) {
+			node = node->next;
+		}
+	} else {
+		node = NULL;
+		for (i = 0; i < count; ++i) {
+			node = node != NULL ? node->prev : list->tail;
+		}
+	}
+
+	return listSplitFrom(list, node, count);
+}
+
+List *listDup(List *list)
+{
+	List *l = listCreateLike(list);
 
 	ListNode *node = list->head;
 	while (node != NULL) {
@@ -298,6 +776,15 @@ void listClear(List *list)
 {
 	ListNode *node = list->head;
 	ListNode *tmp = NULL;
+	/*
+	 * Nodes of a pool of its own go away with the slabs unless values
+	 * need freeing, a shared pool gets every node back one by one.
+	 */
+	int own_pool = list->pool != NULL && !poolIsShared(list->pool);
+	if (own_pool && list->free == NULL) {
+		node = NULL;
+	}
+
 	while (node != NULL) {
 		if (list->free != NULL) {
 			list->free(node->value);
@@ -305,7 +792,13 @@ void listClear(List *list)
 
 		tmp = node;
 		node = node->next;
-		list->dealloc(tmp);
+		if (!own_pool) {
+			listFreeNode(list, tmp);
+		}
+	}
+
+	if (own_pool) {
+		poolClear(list->pool);
 	}
 
 	list->head = NULL;
@@ -316,14 +809,35 @@ void listClear(List *list)
 void listDestroy(List *list)
 {
 	listClear(list);
+	if (list->pool != NULL) {
+		poolDestroy(list->pool);
+	}
+
 	list->dealloc(list);
 }
 
-ListIter *listIterator(List *list)
+void listIterInit(List *list, ListIter *iter)
 {
-	ListIter *iter = list->alloc(sizeof(ListIter));
 	iter->direction = DIRECTION_ASCENDING;
+	iter->dealloc = NULL;
+	iter->list = list;
 	iter->next = list->head;
+	iter->current = NULL;
+}
+
+void listReverseIterInit(List *list, ListIter *iter)
+{
+	iter->direction = DIRECTION_DESCENDING;
+	iter->dealloc = NULL;
+	iter->list = list;
+	iter->next = list->tail;
+	iter->current = NULL;
+}
+
+ListIter *listIterator(List *list)
+{
+	ListIter *iter = list->alloc(sizeof(ListIter));
+	listIterInit(list, iter);
 	iter->dealloc = list->dealloc;
 	return iter;
 }
@@ -331,8 +845,7 @@ ListIter *listIterator(List *list)
 ListIter *listReverseIterator(List *list)
 {
 	ListIter *iter = list->alloc(sizeof(ListIter));
-	iter->direction = DIRECTION_DESCENDING;
-	iter->next = list->tail;
+	listReverseIterInit(list, iter);
 	iter->dealloc = list->dealloc;
 	return iter;
 }
@@ -341,6 +854,7 @@ int listIterHasNext(ListIter *iter) { return iter->next != NULL; }
 
 void *listIterNext(ListIter *iter)
 {
+	iter->current = iter->next;
 	void *value = iter->next->value;
 
 	if (iter->direction) {
@@ -352,4 +866,29 @@ void *listIterNext(ListIter *iter)
 	return value;
 }
 
-void listIterDestroy(ListIter *iter) { iter->dealloc(iter); }
+/* removes the node last returned by listIterNext, iteration goes on */
+void *listIterRemove(ListIter *iter)
+{
+	assert(iter->current != NULL);
+
+	void *value = listRemoveNode(iter->list, iter->current);
+	iter->current = NULL;
+	return value;
+}
+
+void listIterDel(ListIter *iter)
+{
+	List *list = iter->list;
+	void *value = listIterRemove(iter);
+	if (list->free != NULL) {
+		list->free(value);
+	}
+}
+
+/* a no-op for iterators set up by listIterInit */
+void listIterDestroy(ListIter *iter)
+{
+	if (iter->dealloc != NULL) {
+		iter->dealloc(iter);
+	}
+}
@@ -1,12 +1,44 @@
 #ifndef LIST_H
 #define LIST_H
 
+#include "pool.h"
+
 #include <stddef.h>
 
 typedef struct List List;
+typedef struct ListNode ListNode;
 typedef struct ListIter ListIter;
 
+struct ListNode {
+	void *value;
+	struct ListNode *prev;
+	struct ListNode *next;
+};
+
+/* set up by listIterInit it can live on the stack and needs no destroy */
+struct ListIter {
+	int direction;
+	void (*dealloc)(void *);
+	List *list;
+	ListNode *next;
+	/* returned by the last listIterNext, NULL once removed */
+	ListNode *current;
+};
+
+/* the loop body must not remove node, break leaves early */
+#define listForEach(list, node)						\
+	for ((node) = listHead(list); (node) != NULL; (node) = (node)->next)
+
 List *listCreate(void *(*alloc)(size_t), void (*dealloc)(void *));
+List *listCreatePooled(void *(*alloc)(size_t), void (*dealloc)(void *));
+/*
+ * The list takes a reference on pool, whose nodes must fit a ListNode.
+ * Splits and dups of a pooled list share its pool. Moving nodes between
+ * lists on the same pool relinks them; between different pools, or a
+ * pooled and an unpooled list, every node is copied.
+ */
+List *listCreateWithPool(void *(*alloc)(size_t), void (*dealloc)(void *),
+			 Pool *pool);
 void listSetDupMethod(List *list, void *(*dup)(void *));
 void listSetFreeMethod(List *list, void (*free)(void *));
 void listSetCompareMethod(List *list, int (*compare)(void *, void *));
@@ -14,24 +46,63 @@ void *(*listGetDupMethod(List *list))(void *);
 void (*listGetFreeMethod(List *list))(void *);
 int (*listGetCompareMethod(List *list))(void *, void *);
 size_t listLength(List *list);
-void listPushHead(List *list, void *value);
-void listPushTail(List *list, void *value);
+ListNode *listPushHead(List *list, void *value);
+ListNode *listPushTail(List *list, void *value);
 void listInsert(List *list, int index, void *value);
 int listContains(List *list, void *value);
 void *listIndex(List *list, int index);
+ListNode *listHead(List *list);
+ListNode *listTail(List *list);
+ListNode *listNodePrev(ListNode *node);
+ListNode *listNodeNext(ListNode *node);
+void *listNodeValue(ListNode *node);
+void listMoveToHead(List *list, ListNode *node);
+void listMoveToTail(List *list, ListNode *node);
+void *listRemoveNode(List *list, ListNode *node);
+void listDelNode(List *list, ListNode *node);
 void *listPopHead(List *list);
 void *listPopTail(List *list);
 void *listRemove(List *list, int index);
 void listDel(List *list, void *value);
+void listSort(List *list);
+void listSortParallel(List *list, size_t threads);
+void listMerge(List *list, List *other);
+void listUnique(List *list);
+void listMoveRange(List *list, ListNode *node, List *other, ListNode *first,
+		   ListNode *last, size_t count);
+void listSplice(List *list, ListNode *node, List *other);
+void listJoin(List *list, List *other);
+List *listSplit(List *list, int index);
+List *listSplitNode(List *list, ListNode *node);
 List *listDup(List *list);
 void listRotate(List *list);
 void listClear(List *list);
 void listDestroy(List *list);
+void listIterInit(List *list, ListIter *iter);
+void listReverseIterInit(List *list, ListIter *iter);
 ListIter *listIterator(List *list);
 ListIter *listReverseIterator(List *list);
 
 int listIterHasNext(ListIter *iter);
 void *listIterNext(ListIter *iter);
+void *listIterRemove(ListIter *iter);
+void listIterDel(ListIter *iter);
 void listIterDestroy(ListIter *iter);
 
+/* visits every value in order until visit returns non-zero, returning it */
+static inline int listVisit(List *list,
+			    int (*visit)(void *value, void *privdata),
+			    void *privdata)
+{
+	ListNode *node;
+	listForEach(list, node) {
+		int ret = visit(node->value, privdata);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
 #endif
@@ -0,0 +1,402 @@
+#include "skiplist.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DIRECTION_ASCENDING 1
+#define DIRECTION_DESCENDING 0
+
+#define SKIPLIST_MAX_LEVEL 32
+/* a node reaches the next level with probability 1/4 */
+#define SKIPLIST_P 0x3FFF
+
+/*
+ * A sorted skip list as the Redis zset one. Each forward pointer also
+ * stores its span, the number of level 0 nodes it jumps over, so walking
+ * down from the top level sums positions in O(log n) and a value's rank
+ * and the value at an index come with the search itself. Equal values
+ * are kept in insertion order.
+ */
+typedef struct SkipListLevel {
+	struct SkipListNode *forward;
+	size_t span;
+} SkipListLevel;
+
+typedef struct SkipListNode {
+	void *value;
+	struct SkipListNode *backward;
+	SkipListLevel levels[];
+} SkipListNode;
+
+struct SkipList {
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	void *(*dup)(void *);
+	void (*free)(void *);
+	int (*compare)(void *, void *);
+
+	size_t length;
+	int level;
+	SkipListNode *head;
+	SkipListNode *tail;
+	uint64_t random;
+};
+
+struct SkipListIter {
+	int direction;
+	void (*dealloc)(void *);
+	SkipListNode *next;
+};
+
+static SkipListNode *skipListAllocNode(SkipList *list, int level,
+				       void *value)
+{
+	SkipListNode *node = list->alloc(sizeof(SkipListNode) +
+					 level * sizeof(SkipListLevel));
+	node->value = value;
+	node->backward = NULL;
+	return node;
+}
+
+SkipList *skipListCreate(void *(*alloc)(size_t), void (*dealloc)(void *),
+			 int (*compare)(void *, void *))
+{
+	SkipList *list = alloc(sizeof(SkipList));
+	if (list == NULL) {
+		return NULL;
+	}
+
+	memset(list, 0, sizeof(SkipList));
+	list->alloc = alloc;
+	list->dealloc = dealloc;
+	list->compare = compare;
+	list->level = 1;
+	list->random = (uintptr_t)list | 1;
+
+	list->head = skipListAllocNode(list, SKIPLIST_MAX_LEVEL, NULL);
+	memset(list->head->levels, 0,
+	       SKIPLIST_MAX_LEVEL * sizeof(SkipListLevel));
+
+	return list;
+}
+
+void skipListSetDupMethod(SkipList *list, void *(*dup)(void *))
+{
+	list->dup = dup;
+}
+
+void skipListSetFreeMethod(SkipList *list, void (*free)(void *))
+{
+	list->free = free;
+}
+
+void *(*skipListGetDupMethod(SkipList *list))(void *) { return list->dup; }
+
+void (*skipListGetFreeMethod(SkipList *list))(void *) { return list->free; }
+
+int (*skipListGetCompareMethod(SkipList *list))(void *, void *)
+{
+	return list->compare;
+}
+
+size_t skipListLength(SkipList *list) { return list->length; }
+
+static int skipListRandomLevel(SkipList *list)
+{
+	int level = 1;
+	uint64_t x = list->random;
+	do {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+	} while ((x & 0xFFFF) < SKIPLIST_P && ++level < SKIPLIST_MAX_LEVEL);
+
+	list->random = x;
+	return level;
+}
+
+void skipListInsert(SkipList *list, void *value)
+{
+	SkipListNode *update[SKIPLIST_MAX_LEVEL];
+	size_t rank[SKIPLIST_MAX_LEVEL];
+	SkipListNode *node = list->head;
+	int i;
+	for (i = list->level - 1; i >= 0; --i) {
+		rank[i] = i == list->level - 1 ? 0 : rank[i + 1];
+		while (node->levels[i].forward != NULL &&
+		       list->compare(node->levels[i].forward->value, value) <=
+			   0) {
+			rank[i] += node->levels[i].span;
+			node = node->levels[i].forward;
+		}
+
+		update[i] = node;
+	}
+
+	int level = skipListRandomLevel(list);
+	if (level > list->level) {
+		for (i = list->level; i < level; ++i) {
+			rank[i] = 0;
+			update[i] = list->head;
+			update[i]->levels[i].span = list->length;
+		}
+
+		list->level = level;
+	}
+
+	node = skipListAllocNode(list, level, value);
+	for (i = 0; i < level; ++i) {
+		node->levels[i].forward = update[i]->levels[i].forward;
+		update[i]->levels[i].forward = node;
+		node->levels[i].span =
+		    update[i]->levels[i].span - (rank[0] - rank[i]);
+		update[i]->levels[i].span = rank[0] - rank[i] + 1;
+	}
+
+	/* levels above the new node now jump over one more node */
+	for (i = level; i < list->level; ++i) {
+		++update[i]->levels[i].span;
+	}
+
+	node->backward = update[0] == list->head ? NULL : update[0];
+	if (node->levels[0].forward != NULL) {
+		node->levels[0].forward->backward = node;
+	} else {
+		list->tail = node;
+	}
+
+	++list->length;
+}
+
+/* stops before the first value not less than value */
+static SkipListNode *skipListSearch(SkipList *list, void *value,
+				    SkipListNode **update, size_t *rank)
+{
+	SkipListNode *node = list->head;
+	size_t traversed = 0;
+	int i;
+	for (i = list->level - 1; i >= 0; --i) {
+		while (node->levels[i].forward != NULL &&
+		       list->compare(node->levels[i].forward->value, value) <
+			   0) {
+			traversed += node->levels[i].span;
+			node = node->levels[i].forward;
+		}
+
+		if (update != NULL) {
+			update[i] = node;
+		}
+	}
+
+	if (rank != NULL) {
+		*rank = traversed;
+	}
+
+	node = node->levels[0].forward;
+	if (node != NULL && list->compare(node->value, value) == 0) {
+		return node;
+	}
+
+	return NULL;
+}
+
+int skipListContains(SkipList *list, void *value)
+{
+	return skipListSearch(list, value, NULL, NULL) != NULL;
+}
+
+/* index of the first value equal to value */
+size_t skipListRank(SkipList *list, void *value)
+{
+	size_t rank;
+	if (skipListSearch(list, value, NULL, &rank) == NULL) {
+		return SKIPLIST_NOT_FOUND;
+	}
+
+	return rank;
+}
+
+/* stops before the node at index, indexes counting from 0 */
+static SkipListNode *skipListLocate(SkipList *list, size_t index,
+				    SkipListNode **update)
+{
+	SkipListNode *node = list->head;
+	size_t traversed = 0;
+	int i;
+	for (i = list->level - 1; i >= 0; --i) {
+		while (node->levels[i].forward != NULL &&
+		       traversed + node->levels[i].span <= index) {
+			traversed += node->levels[i].span;
+			node = node->levels[i].forward;
+		}
+
+		if (update != NULL) {
+			update[i] = node;
+		}
+	}
+
+	return node->levels[0].forward;
+}
+
+void *skipListIndex(SkipList *list, size_t index)
+{
+	if (index >= list->length) {
+		return NULL;
+	}
+
+	return skipListLocate(list, index, NULL)->value;
+}
+
+static void *skipListDelNode(SkipList *list, SkipListNode *node,
+			     SkipListNode **update)
+{
+	int i;
+	for (i = 0; i < list->level; ++i) {
+		if (update[i]->levels[i].forward == node) {
+			update[i]->levels[i].span += node->levels[i].span - 1;
+			update[i]->levels[i].forward =
+			    node->levels[i].forward;
+		} else {
+			--update[i]->levels[i].span;
+		}
+	}
+
+	if (node->levels[0].forward != NULL) {
+		node->levels[0].forward->backward = node->backward;
+	} else {
+		list->tail = node->backward;
+	}
+
+	while (list->level > 1 &&
+	       list->head->levels[list->level - 1].forward == NULL) {
+		list->head->levels[list->level - 1].span = 0;
+		--list->level;
+	}
+
+	--list->length;
+	void *value = node->value;
+	list->dealloc(node);
+	return value;
+}
+
+void *skipListRemove(SkipList *list, size_t index)
+{
+	assert(index < list->length);
+
+	SkipListNode *update[SKIPLIST_MAX_LEVEL];
+	SkipListNode *node = skipListLocate(list, index, update);
+	return skipListDelNode(list, node, update);
+}
+
+void skipListDel(SkipList *list, void *value)
+{
+	SkipListNode *update[SKIPLIST_MAX_LEVEL];
+	SkipListNode *node = skipListSearch(list, value, update, NULL);
+	if (node == NULL) {
+		return;
+	}
+
+	value = skipListDelNode(list, node, update);
+	if (list->free != NULL) {
+		list->free(value);
+	}
+}
+
+void *skipListPopHead(SkipList *list)
+{
+	return list->length > 0 ? skipListRemove(list, 0) : NULL;
+}
+
+void *skipListPopTail(SkipList *list)
+{
+	return list->length > 0 ? skipListRemove(list, list->length - 1)
+				: NULL;
+}
+
+SkipList *skipListDup(SkipList *list)
+{
+	SkipList *l = skipListCreate(list->alloc, list->dealloc, list->compare);
+	l->dup = list->dup;
+	l->free = list->free;
+
+	SkipListNode *node = list->head->levels[0].forward;
+	while (node != NULL) {
+		skipListInsert(l, list->dup != NULL ? list->dup(node->value)
+						    : node->value);
+		node = node->levels[0].forward;
+	}
+
+	return l;
+}
+
+void skipListClear(SkipList *list)
+{
+	SkipListNode *node = list->head->levels[0].forward;
+	SkipListNode *tmp = NULL;
+	while (node != NULL) {
+		if (list->free != NULL) {
+			list->free(node->value);
+		}
+
+		tmp = node;
+		node = node->levels[0].forward;
+		list->dealloc(tmp);
+	}
+
+	memset(list->head->levels, 0,
+	       SKIPLIST_MAX_LEVEL * sizeof(SkipListLevel));
+	list->level = 1;
+	list->length = 0;
+	list->tail = NULL;
+}
+
+void skipListDestroy(SkipList *list)
+{
+	skipListClear(list);
+	list->dealloc(list->head);
+	list->dealloc(list);
+}
+
+SkipListIter *skipListIterator(SkipList *list)
+{
+	return skipListIteratorAt(list, 0);
+}
+
+/* iterates forward from index, the way to page through the list */
+SkipListIter *skipListIteratorAt(SkipList *list, size_t index)
+{
+	SkipListIter *iter = list->alloc(sizeof(SkipListIter));
+	iter->direction = DIRECTION_ASCENDING;
+	iter->dealloc = list->dealloc;
+	iter->next = index < list->length ? skipListLocate(list, index, NULL)
+					  : NULL;
+	return iter;
+}
+
+SkipListIter *skipListReverseIterator(SkipList *list)
+{
+	SkipListIter *iter = list->alloc(sizeof(SkipListIter));
+	iter->direction = DIRECTION_DESCENDING;
+	iter->dealloc = list->dealloc;
+	iter->next = list->tail;
+	return iter;
+}
+
+int skipListIterHasNext(SkipListIter *iter) { return iter->next != NULL; }
+
+void *skipListIterNext(SkipListIter *iter)
+{
+	void *value = iter->next->value;
+
+	if (iter->direction) {
+		iter->next = iter->next->levels[0].forward;
+	} else {
+		iter->next = iter->next->backward;
+	}
+
+	return value;
+}
+
+void skipListIterDestroy(SkipListIter *iter) { iter->dealloc(iter); }
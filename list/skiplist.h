@@ -0,0 +1,38 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include <stddef.h>
+
+#define SKIPLIST_NOT_FOUND ((size_t)-1)
+
+typedef struct SkipList SkipList;
+typedef struct SkipListIter SkipListIter;
+
+SkipList *skipListCreate(void *(*alloc)(size_t), void (*dealloc)(void *),
+			 int (*compare)(void *, void *));
+void skipListSetDupMethod(SkipList *list, void *(*dup)(void *));
+void skipListSetFreeMethod(SkipList *list, void (*free)(void *));
+void *(*skipListGetDupMethod(SkipList *list))(void *);
+void (*skipListGetFreeMethod(SkipList *list))(void *);
+int (*skipListGetCompareMethod(SkipList *list))(void *, void *);
+size_t skipListLength(SkipList *list);
+void skipListInsert(SkipList *list, void *value);
+int skipListContains(SkipList *list, void *value);
+size_t skipListRank(SkipList *list, void *value);
+void *skipListIndex(SkipList *list, size_t index);
+void *skipListRemove(SkipList *list, size_t index);
+void skipListDel(SkipList *list, void *value);
+void *skipListPopHead(SkipList *list);
+void *skipListPopTail(SkipList *list);
+SkipList *skipListDup(SkipList *list);
+void skipListClear(SkipList *list);
+void skipListDestroy(SkipList *list);
+SkipListIter *skipListIterator(SkipList *list);
+SkipListIter *skipListIteratorAt(SkipList *list, size_t index);
+SkipListIter *skipListReverseIterator(SkipList *list);
+
+int skipListIterHasNext(SkipListIter *iter);
+void *skipListIterNext(SkipListIter *iter);
+void skipListIterDestroy(SkipListIter *iter);
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef TYPEDLIST_H
+#define TYPEDLIST_H
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Generates a doubly linked list named name holding values of type T by
+ * value. eq(value1, value2) returns non-zero for equal values and is
+ * expanded in place, so it gets inlined when it is a static inline
+ * function or a macro.
+ */
+#define CDS_DEFINE_LIST(name, T, eq)					\
+typedef struct name##Node {						\
+	T value;							\
+	struct name##Node *prev;					\
+	struct name##Node *next;					\
+} name##Node;								\
+									\
+typedef struct name {							\
+	name##Node *head;						\
+	name##Node *tail;						\
+	size_t length;							\
+									\
+	void *(*alloc)(size_t);						\
+	void (*dealloc)(void *);					\
+} name;									\
+									\
+typedef struct name##Iter {						\
+	name##Node *next;						\
+} name##Iter;								\
+									\
+static inline name *name##Create(void *(*alloc)(size_t),		\
+				 void (*dealloc)(void *))		\
+{									\
+	name *list = alloc(sizeof(name));				\
+	memset(list, 0, sizeof(name));					\
+	list->alloc = alloc;						\
+	list->dealloc = dealloc;					\
+	return list;							\
+}									\
+									\
+static inline size_t name##Length(name *list) { return list->length; }	\
+									\
+static inline void name##PushHead(name *list, T value)			\
+{									\
+	name##Node *node = list->alloc(sizeof(name##Node));		\
+	node->value = value;						\
+	node->prev = NULL;						\
+	node->next = list->head;					\
+	if (list->head != NULL) {					\
+		list->head->prev = node;				\
+	} else {							\
+		list->tail = node;					\
+	}								\
+									\
+	list->head = node;						\
+	++list->length;							\
+}									\
+									\
+static inline void name##PushTail(name *list, T value)			\
+{									\
+	name##Node *node = list->alloc(sizeof(name##Node));		\
+	node->value = value;						\
+	node->prev = list->tail;					\
+	node->next = NULL;						\
+	if (list->tail != NULL) {					\
+		list->tail->next = node;				\
+	} else {							\
+		list->head = node;					\
+	}								\
+									\
+	list->tail = node;						\
+	++list->length;							\
+}									\
+									\
+static inline void name##Unlink(name *list, name##Node *node)		\
+{									\
+	if (node->prev != NULL) {					\
+		node->prev->next = node->next;				\
+	} else {							\
+		list->head = node->next;				\
+	}								\
+									\
+	if (node->next != NULL) {					\
+		node->next->prev = node->prev;				\
+	} else {							\
+		list->tail = node->prev;				\
+	}								\
+									\
+	--list->length;							\
+	list->dealloc(node);						\
+}									\
+									\
+static inline int name##PopHead(name *list, T *value_ptr)		\
+{									\
+	if (list->head == NULL) {					\
+		return 0;						\
+	}								\
+									\
+	*value_ptr = list->head->value;					\
+	name##Unlink(list, list->head);					\
+	return 1;							\
+}									\
+									\
+static inline int name##PopTail(name *list, T *value_ptr)		\
+{									\
+	if (list->tail == NULL) {					\
+		return 0;						\
+	}								\
+									\
+	*value_ptr = list->tail->value;					\
+	name##Unlink(list, list->tail);					\
+	return 1;							\
+}									\
+									\
+static inline name##Node *name##FindNode(name *list, T value)		\
+{									\
+	name##Node *node = list->head;					\
+	while (node != NULL && !eq(node->value, value)) {		\
+		node = node->next;					\
+	}								\
+									\
+	return node;							\
+}									\
+									\
+static inline int name##Contains(name *list, T value)			\
+{									\
+	return name##FindNode(list, value) != NULL;			\
+}									\
+									\
+static inline T *name##Index(name *list, size_t index)			\
+{									\
+	if (index >= list->length) {					\
+		return NULL;						\
+	}								\
+									\
+	name##Node *node = list->head;					\
+	while (index-- > 0) {						\
+		node = node->next;					\
+	}								\
+									\
+	return &node->value;						\
+}									\
+									\
+static inline int name##Del(name *list, T value)			\
+{									\
+	name##Node *node = name##FindNode(list, value);			\
+	if (node == NULL) {						\
+		return 0;						\
+	}								\
+									\
+	name##Unlink(list, node);					\
+	return 1;							\
+}									\
+									\
+static inline void name##Clear(name *list)				\
+{									\
+	name##Node *node = list->head;					\
+	name##Node *next;						\
+	while (node != NULL) {						\
+		next = node->next;					\
+		list->dealloc(node);					\
+		node = next;						\
+	}								\
+									\
+	list->head = NULL;						\
+	list->tail = NULL;						\
+	list->length = 0;						\
+}									\
+									\
+static inline void name##Destroy(name *list)				\
+{									\
+	name##Clear(list);						\
+	list->dealloc(list);						\
+}									\
+									\
+static inline void name##IterInit(name##Iter *iter, name *list)		\
+{									\
+	iter->next = list->head;					\
+}									\
+									\
+static inline int name##IterHasNext(name##Iter *iter)			\
+{									\
+	return iter->next != NULL;					\
+}									\
+									\
+static inline T name##IterNext(name##Iter *iter)			\
+{									\
+	T value = iter->next->value;					\
+	iter->next = iter->next->next;					\
+	return value;							\
+}
+
+#endif
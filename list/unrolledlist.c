@@ -0,0 +1,468 @@
+#include "unrolledlist.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DIRECTION_ASCENDING 1
+#define DIRECTION_DESCENDING 0
+
+/* 29 values and the node header fill four cache lines */
+#define NODE_VALUES 29
+/* a node this empty after a removal is merged with a neighbour */
+#define NODE_MERGE_THRESHOLD (NODE_VALUES / 4)
+
+/*
+ * Values are kept in arrays of up to NODE_VALUES pointers chained as a
+ * doubly linked list, as the Redis quicklist does with ziplists. A node
+ * uses values[start, start + count), so both ends grow without moving
+ * anything most of the time, and a middle insert shifts at most one node.
+ */
+typedef struct UnrolledNode {
+	struct UnrolledNode *prev;
+	struct UnrolledNode *next;
+	unsigned int start;
+	unsigned int count;
+	void *values[NODE_VALUES];
+} UnrolledNode;
+
+struct UnrolledList {
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	void (*free)(void *);
+	int (*compare)(void *, void *);
+
+	size_t length;
+	size_t nodes;
+	UnrolledNode *head;
+	UnrolledNode *tail;
+};
+
+struct UnrolledListIter {
+	int direction;
+	void (*dealloc)(void *);
+	UnrolledNode *node;
+	size_t offset;
+};
+
+UnrolledList *unrolledListCreate(void *(*alloc)(size_t),
+				 void (*dealloc)(void *))
+{
+	UnrolledList *list = alloc(sizeof(UnrolledList));
+	if (list == NULL) {
+		return NULL;
+	}
+
+	memset(list, 0, sizeof(UnrolledList));
+	list->alloc = alloc;
+	list->dealloc = dealloc;
+
+	return list;
+}
+
+void unrolledListSetFreeMethod(UnrolledList *list, void (*free)(void *))
+{
+	list->free = free;
+}
+
+void unrolledListSetCompareMethod(UnrolledList *list,
+				  int (*compare)(void *, void *))
+{
+	list->compare = compare;
+}
+
+void (*unrolledListGetFreeMethod(UnrolledList *list))(void *)
+{
+	return list->free;
+}
+
+int (*unrolledListGetCompareMethod(UnrolledList *list))(void *, void *)
+{
+	return list->compare;
+}
+
+size_t unrolledListLength(UnrolledList *list) { return list->length; }
+
+size_t unrolledListMemory(UnrolledList *list)
+{
+	return sizeof(UnrolledList) + list->nodes * sizeof(UnrolledNode);
+}
+
+/* links a new node after prev, or at the head when prev is NULL */
+static UnrolledNode *unrolledListAddNode(UnrolledList *list,
+					 UnrolledNode *prev, unsigned int start)
+{
+	UnrolledNode *node = list->alloc(sizeof(UnrolledNode));
+	node->start = start;
+	node->count = 0;
+	node->prev = prev;
+	node->next = prev != NULL ? prev->next : list->head;
+	if (node->next != NULL) {
+		node->next->prev = node;
+	} else {
+		list->tail = node;
+	}
+
+	if (prev != NULL) {
+		prev->next = node;
+	} else {
+		list->head = node;
+	}
+
+	++list->nodes;
+	return node;
+}
+
+static void unrolledListDelNode(UnrolledList *list, UnrolledNode *node)
+{
+	if (node->prev != NULL) {
+		node->prev->next = node->next;
+	} else {
+		list->head = node->next;
+	}
+
+	if (node->next != NULL) {
+		node->next->prev = node->prev;
+	} else {
+		list->tail = node->prev;
+	}
+
+	--list->nodes;
+	list->dealloc(node);
+}
+
+/* finds the node holding index and the offset of index inside it */
+static UnrolledNode *unrolledListLocate(UnrolledList *list, size_t index,
+					size_t *offset)
+{
+	UnrolledNode *node;
+	if (index < list->length / 2) {
+		node = list->head;
+		while (index >= node->count) {
+			index -= node->count;
+			node = node->next;
+		}
+
+		*offset = index;
+		return node;
+	}
+
+	size_t rest = list->length - index;
+	node = list->tail;
+	while (rest > node->count) {
+		rest -= node->count;
+		node = node->prev;
+	}
+
+	*offset = node->count - rest;
+	return node;
+}
+
+void unrolledListPushHead(UnrolledList *list, void *value)
+{
+	UnrolledNode *node = list->head;
+	if (node == NULL || node->count == NODE_VALUES) {
+		node = unrolledListAddNode(list, NULL, NODE_VALUES);
+	} else if (node->start == 0) {
+		/* move the values to the end so the next pushes are free */
+		memmove(node->values + NODE_VALUES - node->count, node->values,
+			node->count * sizeof(void *));
+		node->start = NODE_VALUES - node->count;
+	}
+
+	node->values[--node->start] = value;
+	++node->count;
+	++list->length;
+}
+
+void unrolledListPushTail(UnrolledList *list, void *value)
+{
+	UnrolledNode *node = list->tail;
+	if (node == NULL || node->count == NODE_VALUES) {
+		node = unrolledListAddNode(list, list->tail, 0);
+	} else if (node->start + node->count == NODE_VALUES) {
+		memmove(node->values, node->values + node->start,
+			node->count * sizeof(void *));
+		node->start = 0;
+	}
+
+	node->values[node->start + node->count++] = value;
+	++list->length;
+}
+
+void *unrolledListPopHead(UnrolledList *list)
+{
+	UnrolledNode *node = list->head;
+	if (node == NULL) {
+		return NULL;
+	}
+
+	void *value = node->values[node->start++];
+	--list->length;
+	if (--node->count == 0) {
+		unrolledListDelNode(list, node);
+	}
+
+	return value;
+}
+
+void *unrolledListPopTail(UnrolledList *list)
+{
+	UnrolledNode *node = list->tail;
+	if (node == NULL) {
+		return NULL;
+	}
+
+	void *value = node->values[node->start + --node->count];
+	--list->length;
+	if (node->count == 0) {
+		unrolledListDelNode(list, node);
+	}
+
+	return value;
+}
+
+/* the node must have room, shifts whichever side has it */
+static void unrolledNodeInsert(UnrolledNode *node, size_t offset, void *value)
+{
+	void **at = node->values + node->start + offset;
+	if (node->start + node->count < NODE_VALUES) {
+		memmove(at + 1, at, (node->count - offset) * sizeof(void *));
+	} else {
+		memmove(node->values + node->start - 1,
+			node->values + node->start, offset * sizeof(void *));
+		--node->start;
+		--at;
+	}
+
+	*at = value;
+	++node->count;
+}
+
+void unrolledListInsert(UnrolledList *list, size_t index, void *value)
+{
+	assert(index <= list->length);
+
+	if (index == 0) {
+		unrolledListPushHead(list, value);
+		return;
+	}
+
+	if (index == list->length) {
+		unrolledListPushTail(list, value);
+		return;
+	}
+
+	size_t offset;
+	UnrolledNode *node = unrolledListLocate(list, index, &offset);
+	if (node->count == NODE_VALUES) {
+		/* split a full node and insert into the half owning index */
+		UnrolledNode *next = unrolledListAddNode(list, node, 0);
+		unsigned int keep = node->count - node->count / 2;
+		next->count = node->count - keep;
+		memcpy(next->values, node->values + node->start + keep,
+		       next->count * sizeof(void *));
+		node->count = keep;
+		if (offset > keep) {
+			node = next;
+			offset -= keep;
+		}
+	}
+
+	unrolledNodeInsert(node, offset, value);
+	++list->length;
+}
+
+void *unrolledListIndex(UnrolledList *list, size_t index)
+{
+	if (index >= list->length) {
+		return NULL;
+	}
+
+	size_t offset;
+	UnrolledNode *node = unrolledListLocate(list, index, &offset);
+	return node->values[node->start + offset];
+}
+
+void unrolledListSetIndex(UnrolledList *list, size_t index, void *value)
+{
+	assert(index < list->length);
+
+	size_t offset;
+	UnrolledNode *node = unrolledListLocate(list, index, &offset);
+	node->values[node->start + offset] = value;
+}
+
+int unrolledListContains(UnrolledList *list, void *value)
+{
+	UnrolledNode *node = list->head;
+	while (node != NULL) {
+		unsigned int i;
+		for (i = node->start; i < node->start + node->count; ++i) {
+			if (list->compare(node->values[i], value) == 0) {
+				return 1;
+			}
+		}
+
+		node = node->next;
+	}
+
+	return 0;
+}
+
+/* appends next to node and frees it, both must fit in one node */
+static void unrolledListMerge(UnrolledList *list, UnrolledNode *node,
+			      UnrolledNode *next)
+{
+	if (node->start + node->count + next->count > NODE_VALUES) {
+		memmove(node->values, node->values + node->start,
+			node->count * sizeof(void *));
+		node->start = 0;
+	}
+
+	memcpy(node->values + node->start + node->count,
+	       next->values + next->start, next->count * sizeof(void *));
+	node->count += next->count;
+	unrolledListDelNode(list, next);
+}
+
+static void *unrolledListRemoveAt(UnrolledList *list, UnrolledNode *node,
+				  size_t offset)
+{
+	void **at = node->values + node->start + offset;
+	void *value = *at;
+	if (offset < node->count / 2) {
+		memmove(node->values + node->start + 1,
+			node->values + node->start, offset * sizeof(void *));
+		++node->start;
+	} else {
+		memmove(at, at + 1,
+			(node->count - offset - 1) * sizeof(void *));
+	}
+
+	--node->count;
+	--list->length;
+	if (node->count == 0) {
+		unrolledListDelNode(list, node);
+	} else if (node->count < NODE_MERGE_THRESHOLD) {
+		UnrolledNode *next = node->next;
+		UnrolledNode *prev = node->prev;
+		if (next != NULL && node->count + next->count <= NODE_VALUES) {
+			unrolledListMerge(list, node, next);
+		} else if (prev != NULL &&
+			   prev->count + node->count <= NODE_VALUES) {
+			unrolledListMerge(list, prev, node);
+		}
+	}
+
+	return value;
+}
+
+void *unrolledListRemove(UnrolledList *list, size_t index)
+{
+	assert(index < list->length);
+
+	size_t offset;
+	UnrolledNode *node = unrolledListLocate(list, index, &offset);
+	return unrolledListRemoveAt(list, node, offset);
+}
+
+void unrolledListDel(UnrolledList *list, void *value)
+{
+	UnrolledNode *node = list->head;
+	while (node != NULL) {
+		unsigned int i;
+		for (i = 0; i < node->count; ++i) {
+			void *current = node->values[node->start + i];
+			if (list->compare(current, value) != 0) {
+				continue;
+			}
+
+			unrolledListRemoveAt(list, node, i);
+			if (list->free != NULL) {
+				list->free(current);
+			}
+
+			return;
+		}
+
+		node = node->next;
+	}
+}
+
+void unrolledListClear(UnrolledList *list)
+{
+	UnrolledNode *node = list->head;
+	UnrolledNode *tmp = NULL;
+	while (node != NULL) {
+		if (list->free != NULL) {
+			unsigned int i;
+			for (i = node->start; i < node->start + node->count;
+			     ++i) {
+				list->free(node->values[i]);
+			}
+		}
+
+		tmp = node;
+		node = node->next;
+		list->dealloc(tmp);
+	}
+
+	list->head = NULL;
+	list->tail = NULL;
+	list->length = 0;
+	list->nodes = 0;
+}
+
+void unrolledListDestroy(UnrolledList *list)
+{
+	unrolledListClear(list);
+	list->dealloc(list);
+}
+
+UnrolledListIter *unrolledListIterator(UnrolledList *list)
+{
+	UnrolledListIter *iter = list->alloc(sizeof(UnrolledListIter));
+	iter->direction = DIRECTION_ASCENDING;
+	iter->dealloc = list->dealloc;
+	iter->node = list->head;
+	iter->offset = 0;
+	return iter;
+}
+
+UnrolledListIter *unrolledListReverseIterator(UnrolledList *list)
+{
+	UnrolledListIter *iter = list->alloc(sizeof(UnrolledListIter));
+	iter->direction = DIRECTION_DESCENDING;
+	iter->dealloc = list->dealloc;
+	iter->node = list->tail;
+	iter->offset = iter->node != NULL ? iter->node->count - 1 : 0;
+	return iter;
+}
+
+int unrolledListIterHasNext(UnrolledListIter *iter)
+{
+	return iter->node != NULL;
+}
+
+void *unrolledListIterNext(UnrolledListIter *iter)
+{
+	UnrolledNode *node = iter->node;
+	void *value = node->values[node->start + iter->offset];
+
+	if (iter->direction) {
+		if (++iter->offset == node->count) {
+			iter->node = node->next;
+			iter->offset = 0;
+		}
+	} else if (iter->offset-- == 0) {
+		iter->node = node->prev;
+		if (iter->node != NULL) {
+			iter->offset = iter->node->count - 1;
+		}
+	}
+
+	return value;
+}
+
+void unrolledListIterDestroy(UnrolledListIter *iter) { iter->dealloc(iter); }
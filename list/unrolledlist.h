@@ -0,0 +1,37 @@
+#ifndef UNROLLEDLIST_H
+#define UNROLLEDLIST_H
+
+#include <stddef.h>
+
+typedef struct UnrolledList UnrolledList;
+typedef struct UnrolledListIter UnrolledListIter;
+
+UnrolledList *unrolledListCreate(void *(*alloc)(size_t),
+				 void (*dealloc)(void *));
+void unrolledListSetFreeMethod(UnrolledList *list, void (*free)(void *));
+void unrolledListSetCompareMethod(UnrolledList *list,
+				  int (*compare)(void *, void *));
+void (*unrolledListGetFreeMethod(UnrolledList *list))(void *);
+int (*unrolledListGetCompareMethod(UnrolledList *list))(void *, void *);
+size_t unrolledListLength(UnrolledList *list);
+size_t unrolledListMemory(UnrolledList *list);
+void unrolledListPushHead(UnrolledList *list, void *value);
+void unrolledListPushTail(UnrolledList *list, void *value);
+void *unrolledListPopHead(UnrolledList *list);
+void *unrolledListPopTail(UnrolledList *list);
+void unrolledListInsert(UnrolledList *list, size_t index, void *value);
+void *unrolledListIndex(UnrolledList *list, size_t index);
+void unrolledListSetIndex(UnrolledList *list, size_t index, void *value);
+int unrolledListContains(UnrolledList *list, void *value);
+void *unrolledListRemove(UnrolledList *list, size_t index);
+void unrolledListDel(UnrolledList *list, void *value);
+void unrolledListClear(UnrolledList *list);
+void unrolledListDestroy(UnrolledList *list);
+UnrolledListIter *unrolledListIterator(UnrolledList *list);
+UnrolledListIter *unrolledListReverseIterator(UnrolledList *list);
+
+int unrolledListIterHasNext(UnrolledListIter *iter);
+void *unrolledListIterNext(UnrolledListIter *iter);
+void unrolledListIterDestroy(UnrolledListIter *iter);
+
+#endif
@@ -0,0 +1,142 @@
+#include "pool.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define NODE_ALIGN sizeof(void *)
+
+typedef struct Slab {
+	struct Slab *next;
+} Slab;
+
+typedef struct FreeNode {
+	struct FreeNode *next;
+} FreeNode;
+
+/*
+ * Nodes are carved from slabs holding nodes_per_slab nodes each: first
+ * from the free list, then by bumping through the newest slab. Freed
+ * nodes go back on the free list; slabs are only released all at once.
+ * Containers sharing a pool each hold a reference, the pool goes away
+ * with the last one.
+ */
+struct Pool {
+	size_t refs;
+	Slab *slabs;
+	FreeNode *free_list;
+	char *bump;
+	char *bump_end;
+	size_t slab_count;
+	size_t node_size;
+	size_t nodes_per_slab;
+
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+};
+
+Pool *poolCreate(void *(*alloc)(size_t), void (*dealloc)(void *),
+		 size_t node_size, size_t nodes_per_slab)
+{
+	Pool *pool = alloc(sizeof(Pool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	memset(pool, 0, sizeof(Pool));
+	pool->refs = 1;
+	pool->alloc = alloc;
+	pool->dealloc = dealloc;
+
+	if (node_size < sizeof(FreeNode)) {
+		node_size = sizeof(FreeNode);
+	}
+
+	pool->node_size = (node_size + NODE_ALIGN - 1) & ~(NODE_ALIGN - 1);
+	pool->nodes_per_slab = nodes_per_slab > 0 ? nodes_per_slab : 1;
+	return pool;
+}
+
+static Pool *poolGrow(Pool *pool)
+{
+	size_t bytes = pool->node_size * pool->nodes_per_slab;
+	Slab *slab = pool->alloc(sizeof(Slab) + bytes);
+	if (slab == NULL) {
+		return NULL;
+	}
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	++pool->slab_count;
+
+	pool->bump = (char *)(slab + 1);
+	pool->bump_end = pool->bump + bytes;
+	return pool;
+}
+
+void *poolAlloc(Pool *pool)
+{
+	FreeNode *node = pool->free_list;
+	if (node != NULL) {
+		pool->free_list = node->next;
+		return node;
+	}
+
+	if (pool->bump == pool->bump_end && poolGrow(pool) == NULL) {
+		return NULL;
+	}
+
+	void *ptr = pool->bump;
+	pool->bump += pool->node_size;
+	return ptr;
+}
+
+void poolFree(Pool *pool, void *node)
+{
+	FreeNode *free_node = node;
+	free_node->next = pool->free_list;
+	pool->free_list = free_node;
+}
+
+size_t poolMemory(Pool *pool)
+{
+	return sizeof(Pool) +
+	       pool->slab_count *
+		   (sizeof(Slab) + pool->node_size * pool->nodes_per_slab);
+}
+
+void poolClear(Pool *pool)
+{
+	Slab *slab = pool->slabs;
+	Slab *tmp = NULL;
+	while (slab != NULL) {
+		tmp = slab;
+		slab = slab->next;
+		pool->dealloc(tmp);
+	}
+
+	pool->slabs = NULL;
+	pool->free_list = NULL;
+	pool->bump = NULL;
+	pool->bump_end = NULL;
+	pool->slab_count = 0;
+}
+
+Pool *poolRetain(Pool *pool)
+{
+	++pool->refs;
+	return pool;
+}
+
+/* a shared pool must not be cleared, its slabs hold others' nodes too */
+int poolIsShared(Pool *pool) { return pool->refs > 1; }
+
+/* drops a reference, the last one releases the slabs */
+void poolDestroy(Pool *pool)
+{
+	if (--pool->refs > 0) {
+		return;
+	}
+
+	poolClear(pool);
+	pool->dealloc(pool);
+}
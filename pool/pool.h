@@ -0,0 +1,20 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#define POOL_DEFAULT_SLAB_NODES 1024
+
+typedef struct Pool Pool;
+
+Pool *poolCreate(void *(*alloc)(size_t), void (*dealloc)(void *),
+		 size_t node_size, size_t nodes_per_slab);
+void *poolAlloc(Pool *pool);
+void poolFree(Pool *pool, void *node);
+size_t poolMemory(Pool *pool);
+void poolClear(Pool *pool);
+Pool *poolRetain(Pool *pool);
+int poolIsShared(Pool *pool);
+void poolDestroy(Pool *pool);
+
+#endif
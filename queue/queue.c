@@ -0,0 +1,616 @@
+#include "queue.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define CACHE_LINE_SIZE 64
+
+#define HAZARDS_PER_HANDLE 2
+/* retired nodes a handle collects before it scans the hazard pointers */
+#define RETIRE_SCAN_THRESHOLD 64
+/* freed nodes a handle keeps for its next pushes */
+#define FREE_NODES_MAX 256
+
+#define queueLoad(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define queueLoadRelaxed(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define queueStore(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define queueCAS(ptr, expected_ptr, desired)				\
+	__atomic_compare_exchange_n(ptr, expected_ptr, desired, 0,	\
+				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+/* hazard pointers need their stores ordered before the next loads */
+#define queueLoadSeq(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define queueStoreSeq(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+
+/*
+ * A bounded queue is Vyukov's MPMC ring: every cell carries a sequence
+ * number telling whose turn it is, so producers and consumers only race
+ * on their own position counter. A batch claims a run of ready cells with
+ * a single CAS.
+ *
+ * An unbounded queue is the Michael-Scott linked queue. A popped head
+ * node is retired to its handle and freed once no handle's hazard
+ * pointers point at it; freed nodes are kept by the handle for reuse. A
+ * batch push links a prepared chain with a single CAS.
+ *
+ * Values can't be NULL, NULL means the queue is empty.
+ */
+typedef struct QueueCell {
+	size_t sequence;
+	void *value;
+} QueueCell;
+
+/* a popper may still read next and value of a retired node */
+typedef struct QueueNode {
+	void *value;
+	struct QueueNode *next;
+	struct QueueNode *free_next;
+} QueueNode;
+
+struct QueueHandle {
+	QueueNode *hazards[HAZARDS_PER_HANDLE];
+	Queue *queue;
+	QueueHandle *next;
+	int active;
+	QueueNode *retired;
+	size_t retired_count;
+	QueueNode *free_nodes;
+	size_t free_count;
+	/* keeps handles allocated back to back off each other's lines */
+	char padding[CACHE_LINE_SIZE];
+};
+
+struct Queue {
+	char padding0[CACHE_LINE_SIZE];
+	size_t head;
+	QueueNode *head_node;
+	char padding1[CACHE_LINE_SIZE];
+	size_t tail;
+	QueueNode *tail_node;
+	char padding2[CACHE_LINE_SIZE];
+
+	QueueCell *cells;
+	size_t mask;
+	QueueHandle *handles;
+
+	size_t waiters;
+	int closed;
+	pthread_mutex_t lock;
+	pthread_cond_t nonempty;
+
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	void (*free)(void *);
+};
+
+static Queue *queueCreateWith(void *(*alloc)(size_t),
+			      void (*dealloc)(void *))
+{
+	Queue *queue = alloc(sizeof(Queue));
+	memset(queue, 0, sizeof(Queue));
+	queue->alloc = alloc;
+	queue->dealloc = dealloc;
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->nonempty, NULL);
+	return queue;
+}
+
+Queue *queueCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
+{
+	Queue *queue = queueCreateWith(alloc, dealloc);
+	QueueNode *dummy = alloc(sizeof(QueueNode));
+	dummy->value = NULL;
+	dummy->next = NULL;
+	queue->head_node = dummy;
+	queue->tail_node = dummy;
+	return queue;
+}
+
+/* capacity is rounded up to a power of 2 */
+Queue *queueCreateBounded(void *(*alloc)(size_t), void (*dealloc)(void *),
+			  size_t capacity)
+{
+	assert(capacity > 0);
+
+	size_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	Queue *queue = queueCreateWith(alloc, dealloc);
+	queue->cells = alloc(sizeof(QueueCell) * size);
+	queue->mask = size - 1;
+
+	size_t i;
+	for (i = 0; i < size; ++i) {
+		queue->cells[i].sequence = i;
+	}
+
+	return queue;
+}
+
+void queueSetFreeMethod(Queue *queue, void (*free)(void *))
+{
+	queue->free = free;
+}
+
+void (*queueGetFreeMethod(Queue *queue))(void *) { return queue->free; }
+
+/* 0 for an unbounded queue */
+size_t queueCapacity(Queue *queue)
+{
+	return queue->cells != NULL ? queue->mask + 1 : 0;
+}
+
+/* every thread using the queue needs a handle, inactive ones are reused */
+QueueHandle *queueRegister(Queue *queue)
+{
+	QueueHandle *handle;
+	for (handle = queueLoad(&queue->handles); handle != NULL;
+	     handle = handle->next) {
+		int inactive = 0;
+		if (!queueLoadRelaxed(&handle->active) &&
+		    queueCAS(&handle->active, &inactive, 1)) {
+			return handle;
+		}
+	}
+
+	handle = queue->alloc(sizeof(QueueHandle));
+	memset(handle, 0, sizeof(QueueHandle));
+	handle->queue = queue;
+	handle->active = 1;
+	handle->next = queueLoad(&queue->handles);
+	while (!queueCAS(&queue->handles, &handle->next, handle)) {
+	}
+
+	return handle;
+}
+
+static int queueIsHazard(Queue *queue, QueueNode *node)
+{
+	QueueHandle *handle;
+	for (handle = queueLoad(&queue->handles); handle != NULL;
+	     handle = handle->next) {
+		size_t i;
+		for (i = 0; i < HAZARDS_PER_HANDLE; ++i) {
+			if (queueLoadSeq(&handle->hazards[i]) == node) {
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void queueFreeNode(QueueHandle *handle, QueueNode *node)
+{
+	if (handle->free_count < FREE_NODES_MAX) {
+		node->free_next = handle->free_nodes;
+		handle->free_nodes = node;
+		++handle->free_count;
+		return;
+	}
+
+	handle->queue->dealloc(node);
+}
+
+static QueueNode *queueAllocNode(QueueHandle *handle)
+{
+	QueueNode *node = handle->free_nodes;
+	if (node == NULL) {
+		return handle->queue->alloc(sizeof(QueueNode));
+	}
+
+	handle->free_nodes = node->free_next;
+	--handle->free_count;
+	return node;
+}
+
+static void queueScan(QueueHandle *handle)
+{
+	QueueNode *node = handle->retired;
+	QueueNode *next;
+	handle->retired = NULL;
+	handle->retired_count = 0;
+	for (; node != NULL; node = next) {
+		next = node->free_next;
+		if (queueIsHazard(handle->queue, node)) {
+			node->free_next = handle->retired;
+			handle->retired = node;
+			++handle->retired_count;
+		} else {
+			queueFreeNode(handle, node);
+		}
+	}
+}
+
+static void queueRetire(QueueHandle *handle, QueueNode *node)
+{
+	node->free_next = handle->retired;
+	handle->retired = node;
+	if (++handle->retired_count >= RETIRE_SCAN_THRESHOLD) {
+		queueScan(handle);
+	}
+}
+
+/* nodes still hazardous stay with the handle for its next owner */
+void queueUnregister(QueueHandle *handle)
+{
+	size_t i;
+	for (i = 0; i < HAZARDS_PER_HANDLE; ++i) {
+		queueStoreSeq(&handle->hazards[i], NULL);
+	}
+
+	queueScan(handle);
+	queueStore(&handle->active, 0);
+}
+
+/* protects the pointer read from src, NULL if src changed meanwhile */
+static QueueNode *queueProtect(QueueHandle *handle, int hazard,
+			       QueueNode **src)
+{
+	QueueNode *node = queueLoadSeq(src);
+	queueStoreSeq(&handle->hazards[hazard], node);
+	return queueLoadSeq(src) == node ? node : NULL;
+}
+
+static void queueLinkNodes(QueueHandle *handle, QueueNode *first,
+			   QueueNode *last)
+{
+	Queue *queue = handle->queue;
+	QueueNode *tail;
+	QueueNode *next;
+	for (;;) {
+		tail = queueProtect(handle, 0, &queue->tail_node);
+		if (tail == NULL) {
+			continue;
+		}
+
+		next = queueLoadSeq(&tail->next);
+		if (tail != queueLoadSeq(&queue->tail_node)) {
+			continue;
+		}
+
+		if (next != NULL) {
+			/* help a producer that linked but didn't swing tail */
+			queueCAS(&queue->tail_node, &tail, next);
+			continue;
+		}
+
+		if (queueCAS(&tail->next, &next, first)) {
+			break;
+		}
+	}
+
+	queueCAS(&queue->tail_node, &tail, last);
+	queueStoreSeq(&handle->hazards[0], NULL);
+}
+
+static void *queueUnlinkNode(QueueHandle *handle)
+{
+	Queue *queue = handle->queue;
+	QueueNode *head;
+	QueueNode *tail;
+	QueueNode *next;
+	void *value;
+	for (;;) {
+		head = queueProtect(handle, 0, &queue->head_node);
+		if (head == NULL) {
+			continue;
+		}
+
+		tail = queueLoadSeq(&queue->tail_node);
+		next = queueLoadSeq(&head->next);
+		queueStoreSeq(&handle->hazards[1], next);
+		if (head != queueLoadSeq(&queue->head_node)) {
+			continue;
+		}
+
+		if (next == NULL) {
+			queueStoreSeq(&handle->hazards[0], NULL);
+			return NULL;
+		}
+
+		if (head == tail) {
+			queueCAS(&queue->tail_node, &tail, next);
+			continue;
+		}
+
+		value = next->value;
+		if (queueCAS(&queue->head_node, &head, next)) {
+			break;
+		}
+	}
+
+	queueStoreSeq(&handle->hazards[0], NULL);
+	queueStoreSeq(&handle->hazards[1], NULL);
+	queueRetire(handle, head);
+	return value;
+}
+
+/* claims up to n cells starting at a position whose cell reads ready */
+static size_t queueRingPush(Queue *queue, void **values, size_t n)
+{
+	size_t pos = queueLoadRelaxed(&queue->tail);
+	size_t k;
+	for (;;) {
+		QueueCell *cell = &queue->cells[pos & queue->mask];
+		intptr_t diff =
+		    (intptr_t)queueLoad(&cell->sequence) - (intptr_t)pos;
+		if (diff < 0) {
+			return 0;
+		}
+
+		if (diff > 0) {
+			pos = queueLoadRelaxed(&queue->tail);
+			continue;
+		}
+
+		k = 1;
+		while (k < n &&
+		       queueLoad(&queue->cells[(pos + k) & queue->mask]
+				      .sequence) == pos + k) {
+			++k;
+		}
+
+		if (queueCAS(&queue->tail, &pos, pos + k)) {
+			break;
+		}
+	}
+
+	size_t i;
+	for (i = 0; i < k; ++i) {
+		QueueCell *cell = &queue->cells[(pos + i) & queue->mask];
+		cell->value = values[i];
+		queueStore(&cell->sequence, pos + i + 1);
+	}
+
+	return k;
+}
+
+static size_t queueRingPop(Queue *queue, void **values, size_t n)
+{
+	size_t pos = queueLoadRelaxed(&queue->head);
+	size_t k;
+	for (;;) {
+		QueueCell *cell = &queue->cells[pos & queue->mask];
+		intptr_t diff =
+		    (intptr_t)queueLoad(&cell->sequence) - (intptr_t)(pos + 1);
+		if (diff < 0) {
+			return 0;
+		}
+
+		if (diff > 0) {
+			pos = queueLoadRelaxed(&queue->head);
+			continue;
+		}
+
+		k = 1;
+		while (k < n &&
+		       queueLoad(&queue->cells[(pos + k) & queue->mask]
+				      .sequence) == pos + k + 1) {
+			++k;
+		}
+
+		if (queueCAS(&queue->head, &pos, pos + k)) {
+			break;
+		}
+	}
+
+	size_t i;
+	for (i = 0; i < k; ++i) {
+		QueueCell *cell = &queue->cells[(pos + i) & queue->mask];
+		values[i] = cell->value;
+		queueStore(&cell->sequence, pos + i + queue->mask + 1);
+	}
+
+	return k;
+}
+
+/* the fence pairs with the one of a consumer about to sleep */
+static void queueWake(Queue *queue, size_t n)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (queueLoadRelaxed(&queue->waiters) == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	if (n == 1) {
+		pthread_cond_signal(&queue->nonempty);
+	} else {
+		pthread_cond_broadcast(&queue->nonempty);
+	}
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/* returns -1 when a bounded queue is full */
+int queuePushTail(QueueHandle *handle, void *value)
+{
+	return queuePushTailMany(handle, &value, 1) == 1 ? 0 : -1;
+}
+
+/* pushes as many values as fit, in order, and returns how many did */
+size_t queuePushTailMany(QueueHandle *handle, void **values, size_t n)
+{
+	Queue *queue = handle->queue;
+	size_t pushed = 0;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		assert(values[i] != NULL);
+	}
+
+	if (queue->cells != NULL) {
+		size_t k;
+		while (pushed < n && (k = queueRingPush(queue, values + pushed,
+							n - pushed)) > 0) {
+			pushed += k;
+		}
+	} else if (n > 0) {
+		QueueNode *first = NULL;
+		QueueNode *last = NULL;
+		for (pushed = 0; pushed < n; ++pushed) {
+			QueueNode *node = queueAllocNode(handle);
+			node->value = values[pushed];
+			node->next = NULL;
+			if (last != NULL) {
+				last->next = node;
+			} else {
+				first = node;
+			}
+
+			last = node;
+		}
+
+		queueLinkNodes(handle, first, last);
+	}
+
+	if (pushed > 0) {
+		queueWake(queue, pushed);
+	}
+
+	return pushed;
+}
+
+void *queuePopHead(QueueHandle *handle)
+{
+	void *value;
+	return queuePopHeadMany(handle, &value, 1) == 1 ? value : NULL;
+}
+
+size_t queuePopHeadMany(QueueHandle *handle, void **values, size_t n)
+{
+	Queue *queue = handle->queue;
+	size_t popped = 0;
+	if (queue->cells != NULL) {
+		size_t k;
+		while (popped < n && (k = queueRingPop(queue, values + popped,
+						       n - popped)) > 0) {
+			popped += k;
+		}
+
+		return popped;
+	}
+
+	while (popped < n &&
+	       (values[popped] = queueUnlinkNode(handle)) != NULL) {
+		++popped;
+	}
+
+	return popped;
+}
+
+void *queuePopHeadWait(QueueHandle *handle, long timeout_us)
+{
+	void *value;
+	return queuePopHeadManyWait(handle, &value, 1, timeout_us) == 1 ? value
+									 : NULL;
+}
+
+/*
+ * Waits until at least one value is popped, the timeout expires or the
+ * queue is closed. A negative timeout waits forever. Producers only take
+ * the lock when a consumer waits.
+ */
+size_t queuePopHeadManyWait(QueueHandle *handle, void **values, size_t n,
+			    long timeout_us)
+{
+	Queue *queue = handle->queue;
+	size_t popped = queuePopHeadMany(handle, values, n);
+	if (popped > 0 || timeout_us == 0) {
+		return popped;
+	}
+
+	struct timespec deadline;
+	if (timeout_us > 0) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += timeout_us / 1000000;
+		deadline.tv_nsec += timeout_us % 1000000 * 1000;
+		if (deadline.tv_nsec >= 1000000000) {
+			++deadline.tv_sec;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	__atomic_add_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+	/* pairs with the fence in queueWake, before the pop below re-checks */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	while ((popped = queuePopHeadMany(handle, values, n)) == 0 &&
+	       !queueLoad(&queue->closed)) {
+		if (timeout_us < 0) {
+			pthread_cond_wait(&queue->nonempty, &queue->lock);
+		} else if (pthread_cond_timedwait(&queue->nonempty,
+						  &queue->lock,
+						  &deadline) == ETIMEDOUT) {
+			popped = queuePopHeadMany(handle, values, n);
+			break;
+		}
+	}
+	__atomic_sub_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&queue->lock);
+
+	return popped;
+}
+
+/* waiting consumers return once the queue is drained, pushes still work */
+void queueClose(Queue *queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	queueStore(&queue->closed, 1);
+	pthread_cond_broadcast(&queue->nonempty);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+static void queueFreeList(Queue *queue, QueueNode *node)
+{
+	QueueNode *next;
+	for (; node != NULL; node = next) {
+		next = node->free_next;
+		queue->dealloc(node);
+	}
+}
+
+/* no thread may still use the queue */
+void queueDestroy(Queue *queue)
+{
+	if (queue->cells != NULL) {
+		size_t pos;
+		for (pos = queue->head; pos != queue->tail; ++pos) {
+			QueueCell *cell = &queue->cells[pos & queue->mask];
+			if (queue->free != NULL) {
+				queue->free(cell->value);
+			}
+		}
+
+		queue->dealloc(queue->cells);
+	} else {
+		QueueNode *node = queue->head_node;
+		QueueNode *next;
+		for (; node != NULL; node = next) {
+			next = node->next;
+			if (node != queue->head_node && queue->free != NULL) {
+				queue->free(node->value);
+			}
+
+			queue->dealloc(node);
+		}
+	}
+
+	QueueHandle *handle = queue->handles;
+	QueueHandle *next;
+	for (; handle != NULL; handle = next) {
+		next = handle->next;
+		queueFreeList(queue, handle->retired);
+		queueFreeList(queue, handle->free_nodes);
+		queue->dealloc(handle);
+	}
+
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->nonempty);
+	queue->dealloc(queue);
+}
@@ -0,0 +1,28 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+
+typedef struct Queue Queue;
+typedef struct QueueHandle QueueHandle;
+
+Queue *queueCreate(void *(*alloc)(size_t), void (*dealloc)(void *));
+Queue *queueCreateBounded(void *(*alloc)(size_t), void (*dealloc)(void *),
+			  size_t capacity);
+void queueSetFreeMethod(Queue *queue, void (*free)(void *));
+void (*queueGetFreeMethod(Queue *queue))(void *);
+size_t queueCapacity(Queue *queue);
+QueueHandle *queueRegister(Queue *queue);
+void queueUnregister(QueueHandle *handle);
+/* values can't be NULL in either mode, popping NULL means empty */
+int queuePushTail(QueueHandle *handle, void *value);
+size_t queuePushTailMany(QueueHandle *handle, void **values, size_t n);
+void *queuePopHead(QueueHandle *handle);
+size_t queuePopHeadMany(QueueHandle *handle, void **values, size_t n);
+void *queuePopHeadWait(QueueHandle *handle, long timeout_us);
+size_t queuePopHeadManyWait(QueueHandle *handle, void **values, size_t n,
+			    long timeout_us);
+void queueClose(Queue *queue);
+void queueDestroy(Queue *queue);
+
+#endif
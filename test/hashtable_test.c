@@ -0,0 +1,173 @@
+#include "hashtable.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCAN_KEYS 1000
+/* keys set from inside a scan start here */
+#define ADDED_KEY (SCAN_KEYS + 1)
+#define SCAN_BUCKETS 4
+
+typedef struct ScanState {
+	HashTable *htable;
+	/* times each key was reported */
+	unsigned char reported[2 * SCAN_KEYS + 2];
+	/* remove keys divisible by expire, 0 removes none */
+	uintptr_t expire;
+	int add;
+	uintptr_t added;
+} ScanState;
+
+static size_t hashKey(void *key)
+{
+	uint64_t x = (uintptr_t)key;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static int compareKey(void *key1, void *key2) { return key1 != key2; }
+
+static HashTable *createTable(size_t keys, size_t rehash_step)
+{
+	HashTable *htable = hashTableCreate(malloc, free);
+	setHashMethod(htable, hashKey);
+	setCompareMethod(htable, compareKey);
+	hashTableSetRehashStep(htable, rehash_step);
+
+	uintptr_t key;
+	for (key = 1; key <= keys; ++key) {
+		hashTableSet(htable, (void *)key, (void *)key);
+	}
+
+	return htable;
+}
+
+static void scanVisit(void *key, void *value, void *privdata)
+{
+	ScanState *state = privdata;
+	uintptr_t k = (uintptr_t)key;
+	assert(key == value);
+	if (state->reported[k] < 255) {
+		++state->reported[k];
+	}
+
+	if (state->expire != 0 && k <= SCAN_KEYS && k % state->expire == 0) {
+		assert(hashTableRemove(state->htable, key) == value);
+	}
+
+	if (state->add && state->added < ADDED_KEY + SCAN_KEYS) {
+		void *added = (void *)state->added++;
+		hashTableSet(state->htable, added, added);
+	}
+}
+
+/* scans to the end, optionally removing a key from outside between calls */
+static void scanAll(ScanState *state, uintptr_t remove_between)
+{
+	size_t cursor = 0;
+	uintptr_t key = 1;
+	do {
+		cursor = hashTableScan(state->htable, cursor, SCAN_BUCKETS,
+				       scanVisit, state);
+		if (remove_between != 0 && key <= SCAN_KEYS) {
+			hashTableRemove(state->htable, (void *)key);
+			key += remove_between;
+		}
+	} while (cursor != 0);
+}
+
+/* keys off a multiple of step may have been removed from outside */
+static void checkScan(ScanState *state, uintptr_t step)
+{
+	uintptr_t key;
+	for (key = 1; key <= SCAN_KEYS; ++key) {
+		if (key % step != 0) {
+			continue;
+		}
+
+		/* present for the whole scan, so reported at least once */
+		assert(state->reported[key] > 0);
+		int expired = state->expire != 0 && key % state->expire == 0;
+		assert(hashTableGet(state->htable, (void *)key) ==
+		       (expired ? NULL : (void *)key));
+	}
+}
+
+/* expiry sweeps remove most keys, so the table shrinks under the scan */
+static void testScanShrink(void)
+{
+	static ScanState state;
+	memset(&state, 0, sizeof(ScanState));
+	state.htable = createTable(SCAN_KEYS, 1);
+	hashTableRehash(state.htable, (size_t)-1);
+	state.expire = 1;
+	scanAll(&state, 0);
+	checkScan(&state, 1);
+	assert(hashTableSize(state.htable) == 0);
+	hashTableDestroy(state.htable);
+
+	/* outside removals rehash the table between the calls of one scan */
+	memset(&state, 0, sizeof(ScanState));
+	state.htable = createTable(SCAN_KEYS, 1);
+	hashTableRehash(state.htable, (size_t)-1);
+	state.expire = 3;
+	scanAll(&state, 2);
+	checkScan(&state, 2);
+	uintptr_t key;
+	size_t size = 0;
+	for (key = 1; key <= SCAN_KEYS; ++key) {
+		size += hashTableGet(state.htable, (void *)key) != NULL;
+	}
+
+	assert(hashTableSize(state.htable) == size);
+	hashTableDestroy(state.htable);
+}
+
+/* sets from the callback grow the table, starting mid rehash too */
+static void testScanGrow(void)
+{
+	static ScanState state;
+	uintptr_t key;
+	int rehashing;
+	for (rehashing = 0; rehashing < 2; ++rehashing) {
+		memset(&state, 0, sizeof(ScanState));
+		/* with no steps per write the next grow stays unfinished */
+		state.htable = createTable(SCAN_KEYS / 2, 1);
+		assert(!hashTableIsRehashing(state.htable));
+		hashTableSetRehashStep(state.htable, 0);
+		for (key = SCAN_KEYS / 2 + 1; key <= SCAN_KEYS; ++key) {
+			hashTableSet(state.htable, (void *)key, (void *)key);
+		}
+
+		hashTableRehash(state.htable, rehashing ? 64 : (size_t)-1);
+		assert(hashTableIsRehashing(state.htable) == rehashing);
+		hashTableSetRehashStep(state.htable, 1);
+
+		state.expire = 5;
+		state.add = 1;
+		state.added = ADDED_KEY;
+		scanAll(&state, 0);
+		checkScan(&state, 1);
+		for (key = ADDED_KEY; key < state.added; ++key) {
+			assert(hashTableGet(state.htable, (void *)key) ==
+			       (void *)key);
+		}
+
+		assert(hashTableSize(state.htable) ==
+		       SCAN_KEYS - SCAN_KEYS / 5 + (state.added - ADDED_KEY));
+		hashTableDestroy(state.htable);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	testScanShrink();
+	testScanGrow();
+	printf("%s\n", "hashtable_test ok");
+	return 0;
+}
@@ -1,9 +1,466 @@
 #include "list.h"
+#include "pool.h"
 
+#include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODEL_MAX 256
+#define MODEL_VALUES 48
+#define MOVE_ROUNDS 4000
+/* above LIST_PARALLEL_SORT_MIN, and uneven so the runs differ in length */
+#define SORT_LENGTH (3 * 16384 + 7)
+#define SORT_KEYS 100
+
+/* how the two lists of a move test get their nodes */
+#define POOLS_NONE 0
+#define POOLS_SHARED 1
+#define POOLS_SEPARATE 2
+#define POOLS_MIXED 3
+
+typedef struct Model {
+	void *values[MODEL_MAX];
+	size_t length;
+} Model;
+
+/* compared by key only, seq tells equal keys apart */
+typedef struct Item {
+	int key;
+	size_t seq;
+} Item;
+
+static Item items[SORT_LENGTH];
+static void *expected[SORT_LENGTH];
+static size_t freed_items;
+
+/* walks both ways, checking values, prev links, head, tail and length */
+static void checkValues(List *list, void **values, size_t n)
+{
+	ListNode *node = listHead(list);
+	ListNode *prev = NULL;
+	size_t i;
+
+	assert(listLength(list) == n);
+	for (i = 0; i < n; ++i) {
+		assert(node != NULL);
+		assert(listNodePrev(node) == prev);
+		assert(listNodeValue(node) == values[i]);
+		prev = node;
+		node = listNodeNext(node);
+	}
+
+	assert(node == NULL);
+	assert(listTail(list) == prev);
+	for (i = n; i-- > 0;) {
+		assert(listNodeValue(prev) == values[i]);
+		prev = listNodePrev(prev);
+	}
+
+	assert(prev == NULL);
+}
+
+static ListNode *nodeAt(List *list, size_t index)
+{
+	ListNode *node = listHead(list);
+	while (index-- > 0) {
+		node = listNodeNext(node);
+	}
+
+	return node;
+}
+
+static void modelInsert(Model *model, size_t index, void **values, size_t n)
+{
+	assert(model->length + n <= MODEL_MAX);
+	memmove(model->values + index + n, model->values + index,
+		(model->length - index) * sizeof(void *));
+	memcpy(model->values + index, values, n * sizeof(void *));
+	model->length += n;
+}
+
+static void modelErase(Model *model, size_t index, size_t n)
+{
+	memmove(model->values + index, model->values + index + n,
+		(model->length - index - n) * sizeof(void *));
+	model->length -= n;
+}
+
+/* a split at 0 or at the length is worth more than one in the middle */
+static size_t randomIndex(size_t length)
+{
+	switch (rand() % 4) {
+	case 0:
+		return 0;
+	case 1:
+		return length;
+	default:
+		return (size_t)rand() % (length + 1);
+	}
+}
+
+/*
+ * Moves count nodes from index first of lists[from] after the node at
+ * index at of lists[to], or to its head when at is 0. Nodes moved between
+ * lists sharing a pool, or both without one, must keep their addresses.
+ */
+static void testMove(List **lists, Model *models, int from, int to,
+		     size_t first, size_t count, size_t at, int relink)
+{
+	ListNode *node = at > 0 ? nodeAt(lists[to], at - 1) : NULL;
+	ListNode *first_node = nodeAt(lists[from], first);
+	ListNode *last_node = nodeAt(lists[from], first + count - 1);
+	void *moved[MODEL_MAX];
+
+	memcpy(moved, models[from].values + first, count * sizeof(void *));
+	listMoveRange(lists[to], node, lists[from], first_node, last_node,
+		      count);
+
+	modelErase(&models[from], first, count);
+	if (from == to && at > first) {
+		at -= count;
+	}
+
+	modelInsert(&models[to], at, moved, count);
+	ListNode *moved_node = nodeAt(lists[to], at);
+	assert(relink || from == to ? moved_node == first_node
+				    : moved_node != first_node);
+}
+
+/* drops the values of one residue mod 3 halfway through an iteration */
+static void testIterRemove(List *list, Model *model, uintptr_t residue)
+{
+	ListIter iter;
+	size_t kept = 0;
+	size_t i;
+	int reverse = rand() % 2;
+
+	if (reverse) {
+		listReverseIterInit(list, &iter);
+	} else {
+		listIterInit(list, &iter);
+	}
+
+	for (i = 0; i < model->length; ++i) {
+		size_t k = reverse ? model->length - 1 - i : i;
+		assert(listIterHasNext(&iter));
+		void *value = listIterNext(&iter);
+		assert(value == model->values[k]);
+		if ((uintptr_t)value % 3 != residue) {
+			continue;
+		}
+
+		if (rand() % 2) {
+			assert(listIterRemove(&iter) == value);
+		} else {
+			listIterDel(&iter);
+		}
+	}
+
+	assert(!listIterHasNext(&iter));
+	for (i = 0; i < model->length; ++i) {
+		if ((uintptr_t)model->values[i] % 3 != residue) {
+			model->values[kept++] = model->values[i];
+		}
+	}
+
+	model->length = kept;
+}
+
+static void testMoves(int pools)
+{
+	static Model models[2];
+	List *lists[2];
+	List *split;
+	Pool *pool = NULL;
+	uintptr_t next_value = 1;
+	size_t round;
+	int l;
+
+	switch (pools) {
+	case POOLS_NONE:
+		lists[0] = listCreate(malloc, free);
+		lists[1] = listCreate(malloc, free);
+		break;
+	case POOLS_SHARED:
+		pool = poolCreate(malloc, free, sizeof(ListNode), 16);
+		lists[0] = listCreateWithPool(malloc, free, pool);
+		lists[1] = listCreateWithPool(malloc, free, pool);
+		/* the lists hold their own references */
+		poolDestroy(pool);
+		break;
+	case POOLS_SEPARATE:
+		lists[0] = listCreatePooled(malloc, free);
+		lists[1] = listCreatePooled(malloc, free);
+		break;
+	default:
+		lists[0] = listCreatePooled(malloc, free);
+		lists[1] = listCreate(malloc, free);
+		break;
+	}
+
+	int relink = pools == POOLS_NONE || pools == POOLS_SHARED;
+	memset(models, 0, sizeof(models));
+	for (round = 0; round < MOVE_ROUNDS; ++round) {
+		/* keeps both lists stocked with values never seen before */
+		while (models[0].length + models[1].length < MODEL_VALUES) {
+			l = rand() % 2;
+			void *value = (void *)next_value++;
+			listPushTail(lists[l], value);
+			modelInsert(&models[l], models[l].length, &value, 1);
+		}
+
+		int from = rand() % 2;
+		int to = rand() % 2;
+		size_t length = models[from].length;
+		size_t first;
+		size_t count;
+		size_t at;
+
+		switch (rand() % 6) {
+		case 0:
+			/* a range, within one list or across both */
+			if (length == 0) {
+				break;
+			}
+
+			first = (size_t)rand() % length;
+			count = 1 + (size_t)rand() % (length - first);
+			if (from == to) {
+				/* after the head or a node outside the range */
+				at = (size_t)rand() % (length - count + 1);
+				if (at > first) {
+					at += count;
+				}
+			} else {
+				at = randomIndex(models[to].length);
+			}
+
+			testMove(lists, models, from, to, first, count, at,
+				 relink);
+			break;
+		case 1:
+			if (from == to || length == 0) {
+				break;
+			}
+
+			at = randomIndex(models[to].length);
+			ListNode *node = at > 0 ? nodeAt(lists[to], at - 1)
+						: NULL;
+			ListNode *head = listHead(lists[from]);
+			listSplice(lists[to], node, lists[from]);
+			modelInsert(&models[to], at, models[from].values,
+				    length);
+			models[from].length = 0;
+			assert((nodeAt(lists[to], at) == head) == relink);
+			break;
+		case 2:
+			if (from == to) {
+				break;
+			}
+
+			listJoin(lists[to], lists[from]);
+			modelInsert(&models[to], models[to].length,
+				    models[from].values, length);
+			models[from].length = 0;
+			break;
+		case 3:
+		case 4:
+			/* a split hands its nodes over to a list on its pool */
+			first = randomIndex(length);
+			ListNode *first_node = nodeAt(lists[from], first);
+			if (rand() % 2) {
+				split = listSplit(lists[from], (int)first);
+			} else {
+				split = listSplitNode(lists[from], first_node);
+			}
+
+			checkValues(split, models[from].values + first,
+				    length - first);
+			assert(listHead(split) == first_node);
+			models[from].length = first;
+			checkValues(lists[from], models[from].values, first);
+
+			/* and joining it back to either list moves them on */
+			listJoin(lists[to], split);
+			assert(listLength(split) == 0);
+			listDestroy(split);
+			if (to != from) {
+				modelInsert(&models[to], models[to].length,
+					    models[from].values + first,
+					    length - first);
+			} else {
+				models[from].length = length;
+			}
+			break;
+		default:
+			/* removes every value of one residue while iterating */
+			testIterRemove(lists[from], &models[from],
+				       rand() % 3);
+			break;
+		}
+
+		checkValues(lists[0], models[0].values, models[0].length);
+		checkValues(lists[1], models[1].values, models[1].length);
+	}
+
+	/* NULL splits off nothing, and so does a split at the length */
+	split = listSplitNode(lists[0], NULL);
+	checkValues(split, NULL, 0);
+	listDestroy(split);
+	split = listSplit(lists[0], (int)models[0].length);
+	checkValues(split, NULL, 0);
+	listDestroy(split);
+	checkValues(lists[0], models[0].values, models[0].length);
+
+	listDestroy(lists[0]);
+	listDestroy(lists[1]);
+}
+
+static int compareItems(void *item1, void *item2)
+{
+	int key1 = ((Item *)item1)->key;
+	int key2 = ((Item *)item2)->key;
+	return (key1 > key2) - (key1 < key2);
+}
+
+/* the order a stable sort has to produce */
+static int compareItemsStable(const void *item1, const void *item2)
+{
+	Item *i1 = *(Item **)item1;
+	Item *i2 = *(Item **)item2;
+	int cmp = compareItems(i1, i2);
+	return cmp != 0 ? cmp : (i1->seq > i2->seq) - (i1->seq < i2->seq);
+}
+
+static void freeItem(void *item)
+{
+	++freed_items;
+}
+
+/* pushes items first..first + n in seq order, or sorted by key */
+static void pushItems(List *list, size_t first, size_t n, int keys,
+		      int sorted)
+{
+	size_t i;
+	for (i = first; i < first + n; ++i) {
+		items[i].key = rand() % keys;
+		items[i].seq = i;
+		expected[i] = &items[i];
+	}
+
+	if (sorted) {
+		qsort(expected + first, n, sizeof(void *), compareItemsStable);
+	}
+
+	for (i = first; i < first + n; ++i) {
+		listPushTail(list, expected[i]);
+	}
+}
+
+/* threads 0 sorts serially, below two the parallel sort falls back */
+static void testSort(size_t n, int keys, size_t threads)
+{
+	List *list = listCreatePooled(malloc, free);
+	listSetCompareMethod(list, compareItems);
+	pushItems(list, 0, n, keys, 0);
+	qsort(expected, n, sizeof(void *), compareItemsStable);
+	if (threads == 0) {
+		listSort(list);
+	} else {
+		listSortParallel(list, threads);
+	}
+
+	checkValues(list, expected, n);
+	listDestroy(list);
+}
+
+/* ties go to the list merged into, so its lower seqs come first */
+static void testMerge(size_t n1, size_t n2, int pooled)
+{
+	List *list = listCreate(malloc, free);
+	List *other = pooled ? listCreatePooled(malloc, free)
+			     : listCreate(malloc, free);
+	listSetCompareMethod(list, compareItems);
+	listSetCompareMethod(other, compareItems);
+	pushItems(list, 0, n1, SORT_KEYS / 10, 1);
+	pushItems(other, n1, n2, SORT_KEYS / 10, 1);
+	qsort(expected, n1 + n2, sizeof(void *), compareItemsStable);
+	listMerge(list, other);
+	checkValues(list, expected, n1 + n2);
+	checkValues(other, NULL, 0);
+	listDestroy(list);
+	listDestroy(other);
+}
+
+/* runs of run_length equal keys, or of 1 to 4 when it is 0 */
+static void testUnique(size_t runs, size_t run_length)
+{
+	List *list = listCreatePooled(malloc, free);
+	size_t n = 0;
+	size_t run;
+	size_t i;
+
+	listSetCompareMethod(list, compareItems);
+	listSetFreeMethod(list, freeItem);
+	for (run = 0; run < runs; ++run) {
+		size_t length = run_length > 0 ? run_length : 1 + run % 4;
+		for (i = 0; i < length; ++i) {
+			items[n].key = (int)run;
+			items[n].seq = n;
+			listPushTail(list, &items[n++]);
+		}
+
+		/* the first of each run stays */
+		expected[run] = &items[n - length];
+	}
+
+	freed_items = 0;
+	listUnique(list);
+	checkValues(list, expected, runs);
+	assert(freed_items == n - runs);
+	listDestroy(list);
+}
 
 int main(int argc, char *argv[])
 {
-	printf("%s\n", "Hello world!");
+	size_t threads[] = { 1, 2, 3, 4, 5, 7, 64, 65 };
+	size_t t;
+
+	testMoves(POOLS_NONE);
+	testMoves(POOLS_SHARED);
+	testMoves(POOLS_SEPARATE);
+	testMoves(POOLS_MIXED);
+
+	testSort(0, SORT_KEYS, 0);
+	testSort(1, SORT_KEYS, 0);
+	testSort(2, 1, 0);
+	testSort(1000, 1, 0);
+	testSort(1000, SORT_KEYS, 0);
+	testSort(SORT_LENGTH, SORT_KEYS, 0);
+	/* odd thread counts leave a run out of some merge rounds */
+	for (t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+		testSort(1000, SORT_KEYS, threads[t]);
+		testSort(SORT_LENGTH, SORT_KEYS, threads[t]);
+		testSort(SORT_LENGTH, 1, threads[t]);
+	}
+
+	testMerge(0, 0, 0);
+	testMerge(0, 1, 1);
+	testMerge(1, 0, 0);
+	testMerge(1, 1, 1);
+	testMerge(1, 100, 0);
+	testMerge(100, 1, 1);
+	testMerge(0, 100, 0);
+	testMerge(100, 0, 1);
+	testMerge(500, 300, 1);
+
+	testUnique(0, 0);
+	testUnique(1, 1);
+	testUnique(1, 5);
+	testUnique(100, 1);
+	testUnique(100, 0);
+	printf("%s\n", "list_test ok");
 	return 0;
 }
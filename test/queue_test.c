@@ -0,0 +1,251 @@
+#include "queue.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define PRODUCER_OPS 200000
+#define BATCH_SIZE 16
+#define RING_CAPACITY 64
+#define TIMEOUT_US 20000
+
+/* a value carries its producer in the high bits and a sequence from 1 */
+#define VALUE_SHIFT 32
+#define valueProducer(value) ((uintptr_t)(value) >> VALUE_SHIFT)
+#define valueSequence(value) ((uintptr_t)(value) & 0xffffffffu)
+
+typedef struct Worker {
+	pthread_t thread;
+	Queue *queue;
+	size_t id;
+	unsigned int seed;
+	/* one flag per pushed value, set by whoever pops it */
+	unsigned char *popped;
+	size_t count;
+} Worker;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *producer(void *arg)
+{
+	Worker *worker = arg;
+	QueueHandle *handle = queueRegister(worker->queue);
+	void *values[BATCH_SIZE];
+	size_t next = 1;
+
+	while (next <= PRODUCER_OPS) {
+		size_t n = 1 + rand_r(&worker->seed) % BATCH_SIZE;
+		size_t i;
+		if (n > PRODUCER_OPS + 1 - next) {
+			n = PRODUCER_OPS + 1 - next;
+		}
+
+		for (i = 0; i < n; ++i) {
+			values[i] = (void *)(worker->id << VALUE_SHIFT |
+					     (next + i));
+		}
+
+		size_t pushed;
+		if (n == 1) {
+			pushed = queuePushTail(handle, values[0]) == 0;
+		} else {
+			pushed = queuePushTailMany(handle, values, n);
+		}
+
+		/* only a full ring pushes less */
+		assert(pushed == n || queueCapacity(worker->queue) > 0);
+		next += pushed;
+		if (pushed == 0) {
+			sched_yield();
+		}
+
+		/* exercises handing retired nodes over to the next handle */
+		if (rand_r(&worker->seed) % 4096 == 0) {
+			queueUnregister(handle);
+			handle = queueRegister(worker->queue);
+		}
+	}
+
+	queueUnregister(handle);
+	return NULL;
+}
+
+static void consume(Worker *worker, size_t *last, void *value)
+{
+	size_t producer = valueProducer(value);
+	size_t sequence = valueSequence(value);
+	assert(producer < PRODUCERS);
+	assert(sequence >= 1 && sequence <= PRODUCER_OPS);
+
+	/* values of one producer leave in the order they were pushed */
+	assert(sequence > last[producer]);
+	last[producer] = sequence;
+
+	size_t index = producer * PRODUCER_OPS + sequence - 1;
+	assert(__atomic_exchange_n(&worker->popped[index], 1,
+				   __ATOMIC_RELAXED) == 0);
+	++worker->count;
+}
+
+/* runs until the queue is closed and drained */
+static void *consumer(void *arg)
+{
+	Worker *worker = arg;
+	QueueHandle *handle = queueRegister(worker->queue);
+	size_t last[PRODUCERS] = { 0 };
+	void *values[BATCH_SIZE];
+	int closed = 0;
+
+	while (!closed) {
+		size_t n = 1 + rand_r(&worker->seed) % BATCH_SIZE;
+		size_t popped;
+		size_t i;
+		switch (rand_r(&worker->seed) % 4) {
+		case 0:
+			values[0] = queuePopHead(handle);
+			popped = values[0] != NULL;
+			break;
+		case 1:
+			popped = queuePopHeadMany(handle, values, n);
+			break;
+		case 2:
+			values[0] = queuePopHeadWait(handle, -1);
+			popped = values[0] != NULL;
+			closed = popped == 0;
+			break;
+		default:
+			popped = queuePopHeadManyWait(handle, values, n, -1);
+			closed = popped == 0;
+			break;
+		}
+
+		for (i = 0; i < popped; ++i) {
+			consume(worker, last, values[i]);
+		}
+	}
+
+	queueUnregister(handle);
+	return NULL;
+}
+
+static void testStress(Queue *queue)
+{
+	Worker producers[PRODUCERS];
+	Worker consumers[CONSUMERS];
+	unsigned char *popped = calloc(PRODUCERS * PRODUCER_OPS, 1);
+	size_t count = 0;
+	size_t i;
+
+	for (i = 0; i < CONSUMERS; ++i) {
+		consumers[i].queue = queue;
+		consumers[i].id = i;
+		consumers[i].seed = i + 1;
+		consumers[i].popped = popped;
+		consumers[i].count = 0;
+		pthread_create(&consumers[i].thread, NULL, consumer,
+			       &consumers[i]);
+	}
+
+	for (i = 0; i < PRODUCERS; ++i) {
+		producers[i].queue = queue;
+		producers[i].id = i;
+		producers[i].seed = CONSUMERS + i + 1;
+		pthread_create(&producers[i].thread, NULL, producer,
+			       &producers[i]);
+	}
+
+	for (i = 0; i < PRODUCERS; ++i) {
+		pthread_join(producers[i].thread, NULL);
+	}
+
+	/* wakes the consumers sleeping on an empty queue */
+	queueClose(queue);
+	for (i = 0; i < CONSUMERS; ++i) {
+		pthread_join(consumers[i].thread, NULL);
+		count += consumers[i].count;
+	}
+
+	/* every value was popped once, and only once */
+	assert(count == PRODUCERS * PRODUCER_OPS);
+	for (i = 0; i < PRODUCERS * PRODUCER_OPS; ++i) {
+		assert(popped[i]);
+	}
+
+	free(popped);
+}
+
+static void *sleeper(void *arg)
+{
+	QueueHandle *handle = queueRegister(arg);
+	void *value = queuePopHeadWait(handle, -1);
+	queueUnregister(handle);
+	return value;
+}
+
+static void testWait(Queue *queue)
+{
+	QueueHandle *handle = queueRegister(queue);
+	pthread_t thread;
+	void *value;
+
+	/* the timeout expires on an empty queue */
+	double start = now();
+	assert(queuePopHeadWait(handle, TIMEOUT_US) == NULL);
+	assert(now() - start >= TIMEOUT_US / 1e6 * 0.9);
+	assert(queuePopHeadWait(handle, 0) == NULL);
+
+	/* a push wakes a consumer sleeping without a timeout */
+	pthread_create(&thread, NULL, sleeper, queue);
+	usleep(TIMEOUT_US);
+	assert(queuePushTail(handle, (void *)1) == 0);
+	pthread_join(thread, &value);
+	assert(value == (void *)1);
+
+	/* so does closing, and waits return at once after it */
+	pthread_create(&thread, NULL, sleeper, queue);
+	usleep(TIMEOUT_US);
+	queueClose(queue);
+	pthread_join(thread, &value);
+	assert(value == NULL);
+	assert(queuePopHeadWait(handle, -1) == NULL);
+
+	/* pushes still work, and are drained before waits give up */
+	assert(queuePushTail(handle, (void *)2) == 0);
+	assert(queuePopHeadWait(handle, -1) == (void *)2);
+	assert(queuePopHeadWait(handle, -1) == NULL);
+	queueUnregister(handle);
+}
+
+int main(int argc, char *argv[])
+{
+	Queue *queue = queueCreate(malloc, free);
+	testStress(queue);
+	queueDestroy(queue);
+
+	queue = queueCreateBounded(malloc, free, RING_CAPACITY);
+	testStress(queue);
+	queueDestroy(queue);
+
+	queue = queueCreate(malloc, free);
+	testWait(queue);
+	queueDestroy(queue);
+
+	queue = queueCreateBounded(malloc, free, RING_CAPACITY);
+	testWait(queue);
+	queueDestroy(queue);
+
+	printf("%s\n", "queue_test ok");
+	return 0;
+}
@@ -0,0 +1,188 @@
+#include "rcuhashtable.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define READERS 4
+#define KEYS 2048
+#define WRITER_OPS 200000
+/* removed values the writer frees together after one grace period */
+#define REMOVED_BATCH 64
+/* lookups between the quiescent states of a reader */
+#define READER_BATCH 64
+#define OFFLINE_US 100
+
+/* values remember their key, so a reader can tell a stale or freed one */
+typedef struct Value {
+	uintptr_t key;
+} Value;
+
+typedef struct Reader {
+	pthread_t thread;
+	RCUHashTable *htable;
+	unsigned int seed;
+	/* every other reader naps offline now and then */
+	int napping;
+	size_t hits;
+} Reader;
+
+static int stop;
+static size_t freed_values;
+
+static size_t hashKey(void *key)
+{
+	uint64_t hash = (uintptr_t)key * 0x9E3779B97F4A7C15ULL;
+	return hash ^ hash >> 29;
+}
+
+static int compareKeys(void *key1, void *key2)
+{
+	return key1 != key2;
+}
+
+static void freeValue(void *value)
+{
+	((Value *)value)->key = 0;
+	free(value);
+	__atomic_add_fetch(&freed_values, 1, __ATOMIC_RELAXED);
+}
+
+static Value *valueCreate(uintptr_t key)
+{
+	Value *value = malloc(sizeof(Value));
+	value->key = key;
+	return value;
+}
+
+static void *reader(void *arg)
+{
+	Reader *self = arg;
+	RCUHashTableReader *handle = rcuHashTableRegisterReader(self->htable);
+	size_t i;
+
+	while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		for (i = 0; i < READER_BATCH; ++i) {
+			uintptr_t key = 1 + rand_r(&self->seed) % KEYS;
+			Value *value = rcuHashTableGet(self->htable,
+						       (void *)key);
+			if (value != NULL) {
+				/* a freed value would have its key wiped */
+				assert(value->key == key);
+				++self->hits;
+			}
+		}
+
+		if (self->napping && rand_r(&self->seed) % 16 == 0) {
+			rcuHashTableOffline(handle);
+			usleep(OFFLINE_US);
+			rcuHashTableOnline(handle);
+		} else {
+			rcuHashTableQuiescent(handle);
+		}
+	}
+
+	rcuHashTableUnregisterReader(handle);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	RCUHashTable *htable = rcuHashTableCreate(malloc, free);
+	rcuHashTableSetHashMethod(htable, hashKey);
+	rcuHashTableSetCompareMethod(htable, compareKeys);
+	rcuHashTableSetFreeValueMethod(htable, freeValue);
+
+	Reader readers[READERS];
+	size_t i;
+	for (i = 0; i < READERS; ++i) {
+		readers[i].htable = htable;
+		readers[i].seed = i + 1;
+		readers[i].napping = i % 2;
+		readers[i].hits = 0;
+		pthread_create(&readers[i].thread, NULL, reader, &readers[i]);
+	}
+
+	/* the writer keeps its own model to know what the table retires */
+	static unsigned char present[KEYS + 1];
+	Value *removed[REMOVED_BATCH];
+	size_t removed_count = 0;
+	size_t size = 0;
+	size_t retired = 0;
+	unsigned int seed = READERS + 1;
+	for (i = 0; i < WRITER_OPS; ++i) {
+		uintptr_t key = 1 + rand_r(&seed) % KEYS;
+		Value *value;
+		int op = rand_r(&seed) % 8;
+		if (op < 4) {
+			value = valueCreate(key);
+			rcuHashTableSet(htable, (void *)key, value);
+			retired += present[key];
+			size += !present[key];
+			present[key] = 1;
+		} else if (op < 7) {
+			rcuHashTableDel(htable, (void *)key);
+			retired += present[key];
+			size -= present[key];
+			present[key] = 0;
+		} else {
+			/* removed values are freed after a grace period */
+			value = rcuHashTableRemove(htable, (void *)key);
+			assert((value != NULL) == present[key]);
+			if (value != NULL) {
+				removed[removed_count++] = value;
+			}
+
+			if (removed_count == REMOVED_BATCH) {
+				rcuHashTableSynchronize(htable);
+				while (removed_count > 0) {
+					free(removed[--removed_count]);
+				}
+			}
+
+			size -= present[key];
+			present[key] = 0;
+		}
+
+		assert(rcuHashTableSize(htable) == size);
+		if (i == WRITER_OPS / 2) {
+			rcuHashTableClear(htable);
+			retired += size;
+			size = 0;
+			memset(present, 0, sizeof(present));
+		}
+	}
+
+	/* online readers passing quiescent states let writes free memory */
+	assert(__atomic_load_n(&freed_values, __ATOMIC_RELAXED) > 0);
+
+	/* a grace period ends with the readers still running */
+	rcuHashTableSynchronize(htable);
+	assert(__atomic_load_n(&freed_values, __ATOMIC_RELAXED) == retired);
+	while (removed_count > 0) {
+		free(removed[--removed_count]);
+	}
+
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+	size_t hits = 0;
+	for (i = 0; i < READERS; ++i) {
+		pthread_join(readers[i].thread, NULL);
+		hits += readers[i].hits;
+	}
+
+	assert(hits > 0);
+	for (i = 1; i <= KEYS; ++i) {
+		Value *value = rcuHashTableGet(htable, (void *)i);
+		assert((value != NULL) == present[i]);
+		assert(value == NULL || value->key == i);
+	}
+
+	rcuHashTableDestroy(htable);
+	assert(freed_values == retired + size);
+	printf("%s\n", "rcuhashtable_test ok");
+	return 0;
+}
@@ -1,9 +1,488 @@
+#include "btree.h"
 #include "rbtree.h"
 
+#include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODEL_KEYS 4096
+#define KEY_LENGTH 12
+/* range tests use the even keys 2 to 2 * RANGE_KEYS, odd ones fall between */
+#define RANGE_KEYS 256
+#define RANGE_QUERIES (2 * RANGE_KEYS + 3)
+
+/*
+ * The reference model is a plain array indexed by key number; key numbers
+ * map to keys of either kind in the same order, so the array order is the
+ * tree order too.
+ */
+typedef struct Model {
+	int integers;
+	char strings[MODEL_KEYS][KEY_LENGTH];
+	void *values[MODEL_KEYS];
+	size_t size;
+} Model;
+
+static size_t freed_values;
+
+static int compareStrings(void *key1, void *key2)
+{
+	return strcmp(key1, key2);
+}
+
+static int compareIntegers(void *key1, void *key2)
+{
+	uintptr_t k1 = (uintptr_t)key1;
+	uintptr_t k2 = (uintptr_t)key2;
+	return (k1 > k2) - (k1 < k2);
+}
+
+static void freeValue(void *value)
+{
+	++freed_values;
+}
+
+static void *modelKey(Model *model, size_t k)
+{
+	if (model->integers) {
+		/* spread the keys so they need all of their bits */
+		return (void *)((uintptr_t)k * ((uintptr_t)1 << 40 | 1));
+	}
+
+	return model->strings[k];
+}
+
+static void checkRange(BTree *tree, Model *model, size_t min, size_t max)
+{
+	int (*compare)(void *, void *) = btreeGetCompareMethod(tree);
+	BTreeIter iter;
+	void *key;
+	void *value;
+	size_t k;
+
+	btreeRangeIterInit(tree, &iter, modelKey(model, min),
+			   modelKey(model, max));
+	for (k = min; k < max; ++k) {
+		if (model->values[k] == NULL) {
+			continue;
+		}
+
+		assert(btreeIterHasNext(&iter));
+		btreeIterNext(&iter, &key, &value);
+		assert(compare(key, modelKey(model, k)) == 0);
+		assert(value == model->values[k]);
+	}
+
+	assert(!btreeIterHasNext(&iter));
+}
+
+static void checkAll(BTree *tree, Model *model)
+{
+	BTreeIter iter;
+	void *key;
+	void *value;
+	size_t k;
+
+	btreeIterInit(tree, &iter);
+	for (k = 0; k < MODEL_KEYS; ++k) {
+		assert(btreeGet(tree, modelKey(model, k)) == model->values[k]);
+		assert(btreeContains(tree, modelKey(model, k)) ==
+		       (model->values[k] != NULL));
+		if (model->values[k] == NULL) {
+			continue;
+		}
+
+		assert(btreeIterHasNext(&iter));
+		btreeIterNext(&iter, &key, &value);
+		assert(value == model->values[k]);
+	}
+
+	assert(!btreeIterHasNext(&iter));
+	assert(btreeSize(tree) == model->size);
+}
+
+static void testRandom(BTree *tree, Model *model, size_t keys, size_t ops)
+{
+	size_t i;
+	for (i = 1; i <= ops; ++i) {
+		size_t k = (size_t)rand() % keys;
+		void *key = modelKey(model, k);
+		void *value = (void *)(uintptr_t)i;
+		size_t freed = freed_values;
+		int op = rand() % 10;
+
+		if (op < 5) {
+			btreeSet(tree, key, value);
+			if (model->values[k] != NULL) {
+				assert(freed_values == freed + 1);
+			} else {
+				++model->size;
+			}
+
+			model->values[k] = value;
+		} else if (op < 8) {
+			assert(btreeRemove(tree, key) == model->values[k]);
+			model->size -= model->values[k] != NULL;
+			model->values[k] = NULL;
+			assert(freed_values == freed);
+		} else {
+			int hit = model->values[k] != NULL;
+			btreeDel(tree, key);
+			assert(freed_values == freed + hit);
+			model->size -= hit;
+			model->values[k] = NULL;
+		}
+
+		assert(btreeSize(tree) == model->size);
+		if (i % 1024 == 0) {
+			size_t min = (size_t)rand() % MODEL_KEYS;
+			size_t max = (size_t)rand() % MODEL_KEYS;
+			checkRange(tree, model, min, max > min ? max : min);
+		}
+	}
+
+	checkAll(tree, model);
+}
+
+static void testTree(int integers)
+{
+	static Model model;
+	size_t k;
+	size_t keys;
+
+	memset(&model, 0, sizeof(Model));
+	model.integers = integers;
+	for (k = 0; k < MODEL_KEYS; ++k) {
+		snprintf(model.strings[k], KEY_LENGTH, "%08zu", k);
+	}
+
+	BTree *tree;
+	if (integers) {
+		tree = btreeCreateWithIntegerKeys(malloc, free);
+	} else {
+		tree = btreeCreate(malloc, free);
+		btreeSetCompareMethod(tree, compareStrings);
+	}
+
+	btreeSetFreeValueMethod(tree, freeValue);
+
+	/* few keys keep one leaf busy, many keys split and merge inner nodes */
+	for (keys = 4; keys <= MODEL_KEYS; keys <<= 2) {
+		testRandom(tree, &model, keys, keys * 16);
+	}
+
+	/* drain from both ends so every leaf ends up merged away */
+	for (k = 0; k < MODEL_KEYS / 2; ++k) {
+		size_t ends[2] = { k, MODEL_KEYS - 1 - k };
+		int e;
+		for (e = 0; e < 2; ++e) {
+			void *key = modelKey(&model, ends[e]);
+			assert(btreeRemove(tree, key) == model.values[ends[e]]);
+			model.size -= model.values[ends[e]] != NULL;
+			model.values[ends[e]] = NULL;
+		}
+	}
+
+	checkAll(tree, &model);
+
+	testRandom(tree, &model, MODEL_KEYS, MODEL_KEYS * 4);
+	size_t freed = freed_values;
+	btreeClear(tree);
+	assert(freed_values == freed + model.size);
+	assert(btreeSize(tree) == 0);
+	btreeDestroy(tree);
+}
+
+/* every subtree size has to match its links, returns the root's */
+static unsigned int checkLinkSizes(RBLink *link)
+{
+	if (link == NULL) {
+		return 0;
+	}
+
+	unsigned int size = checkLinkSizes(link->left) +
+			    checkLinkSizes(link->right) + 1;
+	assert(link->size == size);
+	return size;
+}
+
+static void checkOrderStatistics(RBTree *tree, Model *model)
+{
+	RBTreeNode *node = rbtreeFirst(tree);
+	size_t rank = 0;
+	size_t k;
+
+	if (node != NULL) {
+		RBLink *root = &node->link;
+		while (root->parent != NULL) {
+			root = root->parent;
+		}
+
+		assert(checkLinkSizes(root) == model->size);
+	}
+
+	for (k = 0; k < MODEL_KEYS; ++k) {
+		void *key = modelKey(model, k);
+		assert(rbtreeRank(tree, key) == rank);
+		if (model->values[k] == NULL) {
+			continue;
+		}
+
+		node = rbtreeSelect(tree, rank++);
+		assert(node != NULL && node->key == key);
+		assert(node->value == model->values[k]);
+	}
+
+	assert(rank == model->size);
+	assert(rbtreeSelect(tree, rank) == NULL);
+	assert(rbtreePercentile(tree, 0) == rbtreeFirst(tree));
+	assert(rbtreePercentile(tree, 100) == rbtreeLast(tree));
+	if (rank > 0) {
+		/* the nearest rank of the median is ceil(n / 2) */
+		node = rbtreePercentile(tree, 50);
+		assert(node == rbtreeSelect(tree, (rank + 1) / 2 - 1));
+	}
+}
+
+static void testOrderStatistics(void)
+{
+	static Model model;
+	RBTree *tree = rbtreeCreatePooled(malloc, free);
+	size_t i;
+
+	memset(&model, 0, sizeof(Model));
+	model.integers = 1;
+	rbtreeSetCompareMethod(tree, compareIntegers);
+
+	/* enabled late, the sizes are counted over the existing links */
+	for (i = 1; i <= MODEL_KEYS / 2; ++i) {
+		size_t k = (size_t)rand() % MODEL_KEYS;
+		model.size += model.values[k] == NULL;
+		model.values[k] = (void *)(uintptr_t)i;
+		rbtreeSet(tree, modelKey(&model, k), model.values[k]);
+	}
+
+	assert(!rbtreeHasOrderStatistics(tree));
+	rbtreeEnableOrderStatistics(tree);
+	assert(rbtreeHasOrderStatistics(tree));
+	checkOrderStatistics(tree, &model);
+
+	for (i = 1; i <= MODEL_KEYS * 8; ++i) {
+		size_t k = (size_t)rand() % MODEL_KEYS;
+		void *key = modelKey(&model, k);
+		int op = rand() % 10;
+
+		if (op < 4) {
+			model.size += model.values[k] == NULL;
+			model.values[k] = (void *)(uintptr_t)i;
+			rbtreeSet(tree, key, model.values[k]);
+		} else if (op < 8) {
+			assert(rbtreeRemove(tree, key) == model.values[k]);
+			model.size -= model.values[k] != NULL;
+			model.values[k] = NULL;
+		} else {
+			rbtreeDel(tree, key);
+			model.size -= model.values[k] != NULL;
+			model.values[k] = NULL;
+		}
+
+		assert(rbtreeSize(tree) == model.size);
+		if (i % 256 == 0) {
+			checkOrderStatistics(tree, &model);
+		}
+	}
+
+	/* and removed down to nothing */
+	for (i = 0; i < MODEL_KEYS; ++i) {
+		rbtreeDel(tree, modelKey(&model, i));
+		model.size -= model.values[i] != NULL;
+		model.values[i] = NULL;
+		if (i % 512 == 0) {
+			checkOrderStatistics(tree, &model);
+		}
+	}
+
+	checkOrderStatistics(tree, &model);
+	assert(rbtreePercentile(tree, 50) == NULL);
+	rbtreeDestroy(tree);
+}
+
+/* the first present key above q, or not below it when equal, else 0 */
+static uintptr_t modelBound(unsigned char *present, uintptr_t q, int equal)
+{
+	uintptr_t j;
+	for (j = 1; j <= RANGE_KEYS; ++j) {
+		if (present[j] && (2 * j > q || (equal && 2 * j == q))) {
+			return 2 * j;
+		}
+	}
+
+	return 0;
+}
+
+/* the last present key not above q, else 0 */
+static uintptr_t modelFloor(unsigned char *present, uintptr_t q)
+{
+	uintptr_t j;
+	for (j = RANGE_KEYS; j >= 1; --j) {
+		if (present[j] && 2 * j <= q) {
+			return 2 * j;
+		}
+	}
+
+	return 0;
+}
+
+static uintptr_t nodeKey(RBTreeNode *node)
+{
+	return node != NULL ? (uintptr_t)node->key : 0;
+}
+
+static void checkBounds(RBTree *tree, unsigned char *present)
+{
+	uintptr_t q;
+	for (q = 0; q < RANGE_QUERIES; ++q) {
+		void *key = (void *)q;
+		assert(nodeKey(rbtreeLowerBound(tree, key)) ==
+		       modelBound(present, q, 1));
+		assert(nodeKey(rbtreeUpperBound(tree, key)) ==
+		       modelBound(present, q, 0));
+		assert(nodeKey(rbtreeCeiling(tree, key)) ==
+		       modelBound(present, q, 1));
+		assert(nodeKey(rbtreeFloor(tree, key)) ==
+		       modelFloor(present, q));
+	}
+}
+
+/* walks [min, max) both ways, on the stack and on the heap */
+static void checkRBRange(RBTree *tree, unsigned char *present,
+			 uintptr_t min, uintptr_t max)
+{
+	uintptr_t keys[RANGE_KEYS];
+	size_t n = 0;
+	size_t i;
+	uintptr_t j;
+	RBTreeIter stack_iters[2];
+	RBTreeIter *iters[4];
+	void *key;
+	void *value;
+	int it;
+
+	for (j = 1; j <= RANGE_KEYS; ++j) {
+		if (present[j] && 2 * j >= min && 2 * j < max) {
+			keys[n++] = 2 * j;
+		}
+	}
+
+	assert(rbtreeCountRange(tree, (void *)min, (void *)max) == n);
+	rbtreeRangeIterInit(tree, &stack_iters[0], (void *)min, (void *)max);
+	rbtreeReverseRangeIterInit(tree, &stack_iters[1], (void *)min,
+				   (void *)max);
+	iters[0] = &stack_iters[0];
+	iters[1] = &stack_iters[1];
+	iters[2] = rbtreeRangeIterator(tree, (void *)min, (void *)max);
+	iters[3] = rbtreeReverseRangeIterator(tree, (void *)min, (void *)max);
+	for (it = 0; it < 4; ++it) {
+		int reverse = it % 2;
+		for (i = 0; i < n; ++i) {
+			uintptr_t expected = keys[reverse ? n - 1 - i : i];
+			assert(rbtreeIterHasNext(iters[it]));
+			rbtreeIterNext(iters[it], &key, &value);
+			assert((uintptr_t)key == expected);
+			assert((uintptr_t)value == expected / 2);
+		}
+
+		assert(!rbtreeIterHasNext(iters[it]));
+		rbtreeIterDestroy(iters[it]);
+	}
+}
+
+static void checkRBRanges(RBTree *tree, unsigned char *present)
+{
+	uintptr_t past = 2 * RANGE_KEYS + 2;
+	uintptr_t first = modelBound(present, 0, 1);
+	uintptr_t last = modelFloor(present, past);
+	size_t i;
+
+	checkBounds(tree, present);
+
+	/* the whole tree, then ranges reaching past the last key */
+	checkRBRange(tree, present, 0, past);
+	checkRBRange(tree, present, last, past);
+	checkRBRange(tree, present, past, past + 2);
+	checkRBRange(tree, present, first + 1, past);
+
+	/* empty when max is not above min */
+	checkRBRange(tree, present, first, first);
+	checkRBRange(tree, present, last, first);
+	checkRBRange(tree, present, past, 0);
+
+	/* or when both bounds land on the same node */
+	checkRBRange(tree, present, first + 1, first + 2);
+	checkRBRange(tree, present, 0, first);
+	if (first != 0) {
+		uintptr_t next = modelBound(present, first, 0);
+		checkRBRange(tree, present, first + 1,
+			     next != 0 ? next : past);
+		checkRBRange(tree, present, first, first + 1);
+	}
+
+	for (i = 0; i < 64; ++i) {
+		uintptr_t min = (uintptr_t)rand() % RANGE_QUERIES;
+		uintptr_t max = (uintptr_t)rand() % RANGE_QUERIES;
+		checkRBRange(tree, present, min, max);
+	}
+}
+
+/* counts walk the range without order statistics and rank it with them */
+static void testRanges(int order_stats)
+{
+	static unsigned char present[RANGE_KEYS + 1];
+	RBTree *tree = rbtreeCreate(malloc, free);
+	size_t i;
+
+	memset(present, 0, sizeof(present));
+	rbtreeSetCompareMethod(tree, compareIntegers);
+	if (order_stats) {
+		rbtreeEnableOrderStatistics(tree);
+	}
+
+	checkRBRanges(tree, present);
+	for (i = 1; i <= RANGE_KEYS * 4; ++i) {
+		uintptr_t j = 1 + (uintptr_t)rand() % RANGE_KEYS;
+		/* fills up to about two thirds, then thins out again */
+		int set = rand() % 3 < (i <= RANGE_KEYS * 2 ? 2 : 1);
+		if (set) {
+			rbtreeSet(tree, (void *)(2 * j), (void *)j);
+		} else {
+			rbtreeDel(tree, (void *)(2 * j));
+		}
+
+		present[j] = set;
+		if (i % 64 == 0) {
+			checkRBRanges(tree, present);
+		}
+	}
+
+	/* a single key is first and last at once */
+	rbtreeClear(tree);
+	memset(present, 0, sizeof(present));
+	rbtreeSet(tree, (void *)(2 * RANGE_KEYS), (void *)RANGE_KEYS);
+	present[RANGE_KEYS] = 1;
+	checkRBRanges(tree, present);
+	rbtreeDestroy(tree);
+}
 
 int main(int argc, char *argv[])
 {
-	printf("%s\n", "Hello world!");
+	srand(argc > 1 ? (unsigned int)atoi(argv[1]) : 1);
+	testTree(1);
+	testTree(0);
+	testOrderStatistics();
+	testRanges(0);
+	testRanges(1);
+	printf("%s\n", "tree_test ok");
 	return 0;
 }
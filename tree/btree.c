@@ -0,0 +1,765 @@
+#include "btree.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) && UINTPTR_MAX == UINT64_MAX
+#include <immintrin.h>
+#define BTREE_AVX2
+#endif
+
+/* keys per node, a multiple of 4 for the vector search */
+#define BTREE_KEYS 32
+#define BTREE_MIN_KEYS (BTREE_KEYS / 2)
+/* enough levels for 2^64 keys with BTREE_MIN_KEYS keys per node */
+#define BTREE_MAX_DEPTH 24
+
+/*
+ * Both node kinds start with their keys, so searching a node scans one
+ * contiguous array. An inner node has count keys and count + 1 children,
+ * keys[i] being the smallest key under children[i + 1]. Every separator
+ * is a key still stored in a leaf, which keeps freed keys out of inner
+ * nodes. Leaves are linked in key order for scans.
+ */
+typedef struct BTreeNode {
+	unsigned int count;
+	int leaf;
+	void *keys[BTREE_KEYS];
+} BTreeNode;
+
+typedef struct BTreeInner {
+	BTreeNode node;
+	BTreeNode *children[BTREE_KEYS + 1];
+} BTreeInner;
+
+typedef struct BTreeLeaf {
+	BTreeNode node;
+	void *values[BTREE_KEYS];
+	struct BTreeLeaf *prev;
+	struct BTreeLeaf *next;
+} BTreeLeaf;
+
+struct BTree {
+	BTreeNode *root;
+	size_t size;
+	size_t leaves;
+	size_t inners;
+
+	void *(*alloc)(size_t);
+	void (*dealloc)(void *);
+	void (*free_key)(void *);
+	void (*free_value)(void *);
+	int (*compare)(void *, void *);
+	/* keys are uintptr_t values searched without calling compare */
+	int integer_keys;
+};
+
+/* the inner nodes passed on the way down and the child taken in each */
+typedef struct BTreePath {
+	BTreeInner *node;
+	unsigned int index;
+} BTreePath;
+
+static int btreeCompareInteger(void *key1, void *key2)
+{
+	return ((uintptr_t)key1 > (uintptr_t)key2) -
+	       ((uintptr_t)key1 < (uintptr_t)key2);
+}
+
+BTree *btreeCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
+{
+	BTree *tree = alloc(sizeof(BTree));
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	memset(tree, 0, sizeof(BTree));
+	tree->alloc = alloc;
+	tree->dealloc = dealloc;
+	return tree;
+}
+
+BTree *btreeCreateWithIntegerKeys(void *(*alloc)(size_t),
+				  void (*dealloc)(void *))
+{
+	BTree *tree = btreeCreate(alloc, dealloc);
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	btreeSetCompareMethod(tree, btreeCompareInteger);
+	return tree;
+}
+
+void (*btreeGetFreeKeyMethod(BTree *tree))(void *key)
+{
+	return tree->free_key;
+}
+
+void btreeSetFreeKeyMethod(BTree *tree, void (*free_key)(void *))
+{
+	tree->free_key = free_key;
+}
+
+void (*btreeGetFreeValueMethod(BTree *tree))(void *value)
+{
+	return tree->free_value;
+}
+
+void btreeSetFreeValueMethod(BTree *tree, void (*free_value)(void *))
+{
+	tree->free_value = free_value;
+}
+
+int (*btreeGetCompareMethod(BTree *tree))(void *key1, void *key2)
+{
+	return tree->compare;
+}
+
+void btreeSetCompareMethod(BTree *tree, int (*compare)(void *, void *))
+{
+	tree->compare = compare;
+	tree->integer_keys = compare == btreeCompareInteger;
+}
+
+size_t btreeSize(BTree *tree) { return tree->size; }
+
+size_t btreeMemory(BTree *tree)
+{
+	return sizeof(BTree) + tree->leaves * sizeof(BTreeLeaf) +
+	       tree->inners * sizeof(BTreeInner);
+}
+
+#ifdef BTREE_AVX2
+/*
+ * Counts the keys before key, four at a time. Flipping the sign bits
+ * turns the signed 64-bit compare into an unsigned one, lanes past count
+ * are masked off.
+ */
+static inline unsigned int btreeSearchInteger(void **keys, unsigned int count,
+					      uintptr_t key, int upper)
+{
+	const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+	__m256i pivot = _mm256_xor_si256(_mm256_set1_epi64x(key), bias);
+	unsigned int rank = 0;
+	unsigned int i;
+	for (i = 0; i < count; i += 4) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(keys + i));
+		chunk = _mm256_xor_si256(chunk, bias);
+		unsigned int mask;
+		if (upper) {
+			mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(
+			    _mm256_cmpgt_epi64(chunk, pivot)));
+		} else {
+			mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+			    _mm256_cmpgt_epi64(pivot, chunk)));
+		}
+
+		if (count - i < 4) {
+			mask &= (1u << (count - i)) - 1;
+		}
+
+		rank += __builtin_popcount(mask & 0xF);
+	}
+
+	return rank;
+}
+#else
+/* branch free, so the compiler may vectorize it */
+static inline unsigned int btreeSearchInteger(void **keys, unsigned int count,
+					      uintptr_t key, int upper)
+{
+	unsigned int rank = 0;
+	unsigned int i;
+	if (upper) {
+		for (i = 0; i < count; ++i) {
+			rank += (uintptr_t)keys[i] <= key;
+		}
+	} else {
+		for (i = 0; i < count; ++i) {
+			rank += (uintptr_t)keys[i] < key;
+		}
+	}
+
+	return rank;
+}
+#endif
+
+/* the index of the first key not less than key, or greater when upper */
+static inline unsigned int btreeSearch(BTree *tree, BTreeNode *node,
+				       void *key, int upper)
+{
+	if (tree->integer_keys) {
+		return btreeSearchInteger(node->keys, node->count,
+					  (uintptr_t)key, upper);
+	}
+
+	unsigned int low = 0;
+	unsigned int high = node->count;
+	while (low < high) {
+		unsigned int mid = (low + high) / 2;
+		int cmp = tree->compare(node->keys[mid], key);
+		if (cmp < 0 || (upper && cmp == 0)) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static inline int btreeEqual(BTree *tree, void *key1, void *key2)
+{
+	if (tree->integer_keys) {
+		return key1 == key2;
+	}
+
+	return tree->compare(key1, key2) == 0;
+}
+
+/* the leaf that holds key if it is present, the path is optional */
+static BTreeLeaf *btreeFindLeaf(BTree *tree, void *key, BTreePath *path,
+				size_t *depth)
+{
+	BTreeNode *node = tree->root;
+	size_t level = 0;
+	while (!node->leaf) {
+		unsigned int index = btreeSearch(tree, node, key, 1);
+		if (path != NULL) {
+			path[level].node = (BTreeInner *)node;
+			path[level].index = index;
+		}
+
+		++level;
+		node = ((BTreeInner *)node)->children[index];
+	}
+
+	if (depth != NULL) {
+		*depth = level;
+	}
+
+	return (BTreeLeaf *)node;
+}
+
+static BTreeLeaf *btreeLookup(BTree *tree, void *key, unsigned int *index)
+{
+	if (tree->root == NULL) {
+		return NULL;
+	}
+
+	BTreeLeaf *leaf = btreeFindLeaf(tree, key, NULL, NULL);
+	*index = btreeSearch(tree, &leaf->node, key, 0);
+	if (*index == leaf->node.count ||
+	    !btreeEqual(tree, leaf->node.keys[*index], key)) {
+		return NULL;
+	}
+
+	return leaf;
+}
+
+int btreeContains(BTree *tree, void *key)
+{
+	unsigned int index;
+	return btreeLookup(tree, key, &index) != NULL;
+}
+
+void *btreeGet(BTree *tree, void *key)
+{
+	unsigned int index;
+	BTreeLeaf *leaf = btreeLookup(tree, key, &index);
+	if (leaf == NULL) {
+		return NULL;
+	}
+
+	return leaf->values[index];
+}
+
+static BTreeLeaf *btreeAllocLeaf(BTree *tree)
+{
+	BTreeLeaf *leaf = tree->alloc(sizeof(BTreeLeaf));
+	leaf->node.count = 0;
+	leaf->node.leaf = 1;
+	leaf->prev = NULL;
+	leaf->next = NULL;
+	++tree->leaves;
+	return leaf;
+}
+
+static BTreeInner *btreeAllocInner(BTree *tree)
+{
+	BTreeInner *inner = tree->alloc(sizeof(BTreeInner));
+	inner->node.count = 0;
+	inner->node.leaf = 0;
+	++tree->inners;
+	return inner;
+}
+
+static void btreeFreeNode(BTree *tree, BTreeNode *node)
+{
+	if (node->leaf) {
+		--tree->leaves;
+	} else {
+		--tree->inners;
+	}
+
+	tree->dealloc(node);
+}
+
+static void btreeLeafInsert(BTreeLeaf *leaf, unsigned int index, void *key,
+			    void *value)
+{
+	unsigned int tail = leaf->node.count - index;
+	memmove(leaf->node.keys + index + 1, leaf->node.keys + index,
+		tail * sizeof(void *));
+	memmove(leaf->values + index + 1, leaf->values + index,
+		tail * sizeof(void *));
+	leaf->node.keys[index] = key;
+	leaf->values[index] = value;
+	++leaf->node.count;
+}
+
+static void btreeInnerInsert(BTreeInner *inner, unsigned int index,
+			     void *key, BTreeNode *child)
+{
+	unsigned int tail = inner->node.count - index;
+	memmove(inner->node.keys + index + 1, inner->node.keys + index,
+		tail * sizeof(void *));
+	memmove(inner->children + index + 2, inner->children + index + 1,
+		tail * sizeof(BTreeNode *));
+	inner->node.keys[index] = key;
+	inner->children[index + 1] = child;
+	++inner->node.count;
+}
+
+/* moves the upper half of a full leaf into a new right neighbour */
+static BTreeLeaf *btreeSplitLeaf(BTree *tree, BTreeLeaf *leaf)
+{
+	BTreeLeaf *right = btreeAllocLeaf(tree);
+	unsigned int keep = BTREE_KEYS / 2;
+	right->node.count = BTREE_KEYS - keep;
+	memcpy(right->node.keys, leaf->node.keys + keep,
+	       right->node.count * sizeof(void *));
+	memcpy(right->values, leaf->values + keep,
+	       right->node.count * sizeof(void *));
+	leaf->node.count = keep;
+
+	right->prev = leaf;
+	right->next = leaf->next;
+	if (leaf->next != NULL) {
+		leaf->next->prev = right;
+	}
+
+	leaf->next = right;
+	return right;
+}
+
+/*
+ * Adds key and child at index of a full inner node by splitting it. The
+ * middle key moves up and is returned through key.
+ */
+static BTreeInner *btreeSplitInner(BTree *tree, BTreeInner *inner,
+				   unsigned int index, void **key,
+				   BTreeNode *child)
+{
+	void *keys[BTREE_KEYS + 1];
+	BTreeNode *children[BTREE_KEYS + 2];
+	memcpy(keys, inner->node.keys, index * sizeof(void *));
+	keys[index] = *key;
+	memcpy(keys + index + 1, inner->node.keys + index,
+	       (BTREE_KEYS - index) * sizeof(void *));
+	memcpy(children, inner->children, (index + 1) * sizeof(BTreeNode *));
+	children[index + 1] = child;
+	memcpy(children + index + 2, inner->children + index + 1,
+	       (BTREE_KEYS - index) * sizeof(BTreeNode *));
+
+	BTreeInner *right = btreeAllocInner(tree);
+	unsigned int keep = (BTREE_KEYS + 1) / 2;
+	inner->node.count = keep;
+	memcpy(inner->node.keys, keys, keep * sizeof(void *));
+	memcpy(inner->children, children, (keep + 1) * sizeof(BTreeNode *));
+
+	*key = keys[keep];
+	right->node.count = BTREE_KEYS - keep;
+	memcpy(right->node.keys, keys + keep + 1,
+	       right->node.count * sizeof(void *));
+	memcpy(right->children, children + keep + 1,
+	       (right->node.count + 1) * sizeof(BTreeNode *));
+	return right;
+}
+
+void btreeSet(BTree *tree, void *key, void *value)
+{
+	if (tree->root == NULL) {
+		tree->root = &btreeAllocLeaf(tree)->node;
+	}
+
+	BTreePath path[BTREE_MAX_DEPTH];
+	size_t depth;
+	BTreeLeaf *leaf = btreeFindLeaf(tree, key, path, &depth);
+	unsigned int index = btreeSearch(tree, &leaf->node, key, 0);
+	if (index < leaf->node.count &&
+	    btreeEqual(tree, leaf->node.keys[index], key)) {
+		if (tree->free_value != NULL) {
+			tree->free_value(leaf->values[index]);
+		}
+
+		leaf->values[index] = value;
+		return;
+	}
+
+	++tree->size;
+	if (leaf->node.count < BTREE_KEYS) {
+		btreeLeafInsert(leaf, index, key, value);
+		return;
+	}
+
+	BTreeLeaf *right = btreeSplitLeaf(tree, leaf);
+	if (index <= leaf->node.count) {
+		btreeLeafInsert(leaf, index, key, value);
+	} else {
+		btreeLeafInsert(right, index - leaf->node.count, key, value);
+	}
+
+	void *separator = right->node.keys[0];
+	BTreeNode *child = &right->node;
+	while (depth > 0) {
+		--depth;
+		BTreeInner *parent = path[depth].node;
+		if (parent->node.count < BTREE_KEYS) {
+			btreeInnerInsert(parent, path[depth].index, separator,
+					 child);
+			return;
+		}
+
+		child = &btreeSplitInner(tree, parent, path[depth].index,
+					 &separator, child)->node;
+	}
+
+	BTreeInner *root = btreeAllocInner(tree);
+	root->node.count = 1;
+	root->node.keys[0] = separator;
+	root->children[0] = tree->root;
+	root->children[1] = child;
+	tree->root = &root->node;
+}
+
+static void btreeInnerRemove(BTreeInner *inner, unsigned int index)
+{
+	unsigned int tail = inner->node.count - index - 1;
+	memmove(inner->node.keys + index, inner->node.keys + index + 1,
+		tail * sizeof(void *));
+	memmove(inner->children + index + 1, inner->children + index + 2,
+		tail * sizeof(BTreeNode *));
+	--inner->node.count;
+}
+
+/* moves the last entry of the left sibling to the front of node */
+static void btreeBorrowLeft(BTreeInner *parent, unsigned int index)
+{
+	BTreeNode *left = parent->children[index - 1];
+	BTreeNode *node = parent->children[index];
+	memmove(node->keys + 1, node->keys, node->count * sizeof(void *));
+	if (node->leaf) {
+		BTreeLeaf *from = (BTreeLeaf *)left;
+		BTreeLeaf *to = (BTreeLeaf *)node;
+		memmove(to->values + 1, to->values,
+			node->count * sizeof(void *));
+		node->keys[0] = left->keys[left->count - 1];
+		to->values[0] = from->values[left->count - 1];
+		parent->node.keys[index - 1] = node->keys[0];
+	} else {
+		BTreeInner *from = (BTreeInner *)left;
+		BTreeInner *to = (BTreeInner *)node;
+		memmove(to->children + 1, to->children,
+			(node->count + 1) * sizeof(BTreeNode *));
+		node->keys[0] = parent->node.keys[index - 1];
+		to->children[0] = from->children[left->count];
+		parent->node.keys[index - 1] = left->keys[left->count - 1];
+	}
+
+	--left->count;
+	++node->count;
+}
+
+/* moves the first entry of the right sibling to the end of node */
+static void btreeBorrowRight(BTreeInner *parent, unsigned int index)
+{
+	BTreeNode *node = parent->children[index];
+	BTreeNode *right = parent->children[index + 1];
+	if (node->leaf) {
+		BTreeLeaf *to = (BTreeLeaf *)node;
+		BTreeLeaf *from = (BTreeLeaf *)right;
+		node->keys[node->count] = right->keys[0];
+		to->values[node->count] = from->values[0];
+		memmove(from->values, from->values + 1,
+			(right->count - 1) * sizeof(void *));
+		memmove(right->keys, right->keys + 1,
+			(right->count - 1) * sizeof(void *));
+		parent->node.keys[index] = right->keys[0];
+	} else {
+		BTreeInner *to = (BTreeInner *)node;
+		BTreeInner *from = (BTreeInner *)right;
+		node->keys[node->count] = parent->node.keys[index];
+		to->children[node->count + 1] = from->children[0];
+		parent->node.keys[index] = right->keys[0];
+		memmove(right->keys, right->keys + 1,
+			(right->count - 1) * sizeof(void *));
+		memmove(from->children, from->children + 1,
+			right->count * sizeof(BTreeNode *));
+	}
+
+	--right->count;
+	++node->count;
+}
+
+/* folds the child right of the separator at index into its left one */
+static void btreeMerge(BTree *tree, BTreeInner *parent, unsigned int index)
+{
+	BTreeNode *left = parent->children[index];
+	BTreeNode *right = parent->children[index + 1];
+	if (left->leaf) {
+		BTreeLeaf *to = (BTreeLeaf *)left;
+		BTreeLeaf *from = (BTreeLeaf *)right;
+		memcpy(left->keys + left->count, right->keys,
+		       right->count * sizeof(void *));
+		memcpy(to->values + left->count, from->values,
+		       right->count * sizeof(void *));
+		left->count += right->count;
+		to->next = from->next;
+		if (from->next != NULL) {
+			from->next->prev = to;
+		}
+	} else {
+		BTreeInner *to = (BTreeInner *)left;
+		BTreeInner *from = (BTreeInner *)right;
+		left->keys[left->count] = parent->node.keys[index];
+		memcpy(left->keys + left->count + 1, right->keys,
+		       right->count * sizeof(void *));
+		memcpy(to->children + left->count + 1, from->children,
+		       (right->count + 1) * sizeof(BTreeNode *));
+		left->count += right->count + 1;
+	}
+
+	btreeInnerRemove(parent, index);
+	btreeFreeNode(tree, right);
+}
+
+/* refills node from a sibling or merges it, going up while nodes underflow */
+static void btreeRebalance(BTree *tree, BTreePath *path, size_t depth,
+			   BTreeNode *node)
+{
+	while (depth > 0 && node->count < BTREE_MIN_KEYS) {
+		--depth;
+		BTreeInner *parent = path[depth].node;
+		unsigned int index = path[depth].index;
+		if (index > 0 &&
+		    parent->children[index - 1]->count > BTREE_MIN_KEYS) {
+			btreeBorrowLeft(parent, index);
+			return;
+		}
+
+		if (index < parent->node.count &&
+		    parent->children[index + 1]->count > BTREE_MIN_KEYS) {
+			btreeBorrowRight(parent, index);
+			return;
+		}
+
+		btreeMerge(tree, parent, index > 0 ? index - 1 : index);
+		node = &parent->node;
+	}
+
+	node = tree->root;
+	if (node->count == 0) {
+		tree->root =
+		    node->leaf ? NULL : ((BTreeInner *)node)->children[0];
+		btreeFreeNode(tree, node);
+	}
+}
+
+void *btreeRemove(BTree *tree, void *key)
+{
+	if (tree->root == NULL) {
+		return NULL;
+	}
+
+	BTreePath path[BTREE_MAX_DEPTH];
+	size_t depth;
+	BTreeLeaf *leaf = btreeFindLeaf(tree, key, path, &depth);
+	unsigned int index = btreeSearch(tree, &leaf->node, key, 0);
+	if (index == leaf->node.count ||
+	    !btreeEqual(tree, leaf->node.keys[index], key)) {
+		return NULL;
+	}
+
+	void *removed = leaf->node.keys[index];
+	void *value = leaf->values[index];
+	unsigned int tail = leaf->node.count - index - 1;
+	memmove(leaf->node.keys + index, leaf->node.keys + index + 1,
+		tail * sizeof(void *));
+	memmove(leaf->values + index, leaf->values + index + 1,
+		tail * sizeof(void *));
+	--leaf->node.count;
+	--tree->size;
+
+	/*
+	 * The first key of a leaf is also the separator where the path last
+	 * turned right, its successor in the leaf takes that place.
+	 */
+	if (index == 0 && leaf->node.count > 0) {
+		size_t level = depth;
+		while (level > 0 && path[level - 1].index == 0) {
+			--level;
+		}
+
+		if (level > 0) {
+			BTreeInner *inner = path[level - 1].node;
+			assert(inner->node.keys[path[level - 1].index - 1] ==
+			       removed);
+			inner->node.keys[path[level - 1].index - 1] =
+			    leaf->node.keys[0];
+		}
+	}
+
+	btreeRebalance(tree, path, depth, &leaf->node);
+	if (tree->free_key != NULL) {
+		tree->free_key(removed);
+	}
+
+	return value;
+}
+
+void btreeDel(BTree *tree, void *key)
+{
+	void *value = btreeRemove(tree, key);
+	if (value != NULL && tree->free_value != NULL) {
+		tree->free_value(value);
+	}
+}
+
+static void btreeClearNode(BTree *tree, BTreeNode *node)
+{
+	unsigned int i;
+	if (node->leaf) {
+		BTreeLeaf *leaf = (BTreeLeaf *)node;
+		for (i = 0; i < node->count; ++i) {
+			if (tree->free_key != NULL) {
+				tree->free_key(node->keys[i]);
+			}
+
+			if (tree->free_value != NULL) {
+				tree->free_value(leaf->values[i]);
+			}
+		}
+	} else {
+		for (i = 0; i <= node->count; ++i) {
+			btreeClearNode(tree, ((BTreeInner *)node)->children[i]);
+		}
+	}
+
+	btreeFreeNode(tree, node);
+}
+
+void btreeClear(BTree *tree)
+{
+	if (tree->root != NULL) {
+		btreeClearNode(tree, tree->root);
+	}
+
+	tree->root = NULL;
+	tree->size = 0;
+}
+
+void btreeDestroy(BTree *tree)
+{
+	btreeClear(tree);
+	tree->dealloc(tree);
+}
+
+/* the position of the first key not less than key */
+static void btreeSeek(BTree *tree, void *key, BTreeLeaf **leaf,
+		      unsigned int *index)
+{
+	if (tree->root == NULL) {
+		*leaf = NULL;
+		*index = 0;
+		return;
+	}
+
+	*leaf = btreeFindLeaf(tree, key, NULL, NULL);
+	*index = btreeSearch(tree, &(*leaf)->node, key, 0);
+	if (*index == (*leaf)->node.count) {
+		*leaf = (*leaf)->next;
+		*index = 0;
+	}
+}
+
+void btreeIterInit(BTree *tree, BTreeIter *iter)
+{
+	BTreeNode *node = tree->root;
+	while (node != NULL && !node->leaf) {
+		node = ((BTreeInner *)node)->children[0];
+	}
+
+	iter->leaf = (BTreeLeaf *)node;
+	iter->index = 0;
+	iter->end_leaf = NULL;
+	iter->end_index = 0;
+	iter->dealloc = NULL;
+}
+
+/* iterates the keys in [min, max) ascending */
+void btreeRangeIterInit(BTree *tree, BTreeIter *iter, void *min, void *max)
+{
+	iter->leaf = NULL;
+	iter->index = 0;
+	iter->end_leaf = NULL;
+	iter->end_index = 0;
+	iter->dealloc = NULL;
+	if (tree->compare(min, max) < 0) {
+		btreeSeek(tree, min, &iter->leaf, &iter->index);
+		btreeSeek(tree, max, &iter->end_leaf, &iter->end_index);
+	}
+}
+
+BTreeIter *btreeIterator(BTree *tree)
+{
+	BTreeIter *iter = tree->alloc(sizeof(BTreeIter));
+	btreeIterInit(tree, iter);
+	iter->dealloc = tree->dealloc;
+	return iter;
+}
+
+BTreeIter *btreeRangeIterator(BTree *tree, void *min, void *max)
+{
+	BTreeIter *iter = tree->alloc(sizeof(BTreeIter));
+	btreeRangeIterInit(tree, iter, min, max);
+	iter->dealloc = tree->dealloc;
+	return iter;
+}
+
+int btreeIterHasNext(BTreeIter *iter)
+{
+	return iter->leaf != NULL &&
+	       (iter->leaf != iter->end_leaf || iter->index != iter->end_index);
+}
+
+void btreeIterNext(BTreeIter *iter, void **key_ptr, void **value_ptr)
+{
+	*key_ptr = iter->leaf->node.keys[iter->index];
+	*value_ptr = iter->leaf->values[iter->index];
+	if (++iter->index == iter->leaf->node.count) {
+		iter->leaf = iter->leaf->next;
+		iter->index = 0;
+	}
+}
+
+/* a no-op for iterators set up by btreeIterInit */
+void btreeIterDestroy(BTreeIter *iter)
+{
+	if (iter->dealloc != NULL) {
+		iter->dealloc(iter);
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stddef.h>
+
+typedef struct BTree BTree;
+typedef struct BTreeIter BTreeIter;
+
+/* set up by btreeIterInit it can live on the stack and needs no destroy */
+struct BTreeIter {
+	struct BTreeLeaf *leaf;
+	unsigned int index;
+	/* iteration stops at this position, a NULL leaf runs to the end */
+	struct BTreeLeaf *end_leaf;
+	unsigned int end_index;
+	void (*dealloc)(void *);
+};
+
+BTree *btreeCreate(void *(*alloc)(size_t), void (*dealloc)(void *));
+BTree *btreeCreateWithIntegerKeys(void *(*alloc)(size_t),
+				  void (*dealloc)(void *));
+void (*btreeGetFreeKeyMethod(BTree *tree))(void *key);
+void btreeSetFreeKeyMethod(BTree *tree, void (*free_key)(void *));
+void (*btreeGetFreeValueMethod(BTree *tree))(void *value);
+void btreeSetFreeValueMethod(BTree *tree, void (*free_value)(void *));
+int (*btreeGetCompareMethod(BTree *tree))(void *key1, void *key2);
+void btreeSetCompareMethod(BTree *tree, int (*compare)(void *, void *));
+size_t btreeSize(BTree *tree);
+size_t btreeMemory(BTree *tree);
+int btreeContains(BTree *tree, void *key);
+void *btreeGet(BTree *tree, void *key);
+void btreeSet(BTree *tree, void *key, void *value);
+void *btreeRemove(BTree *tree, void *key);
+void btreeDel(BTree *tree, void *key);
+void btreeClear(BTree *tree);
+void btreeDestroy(BTree *tree);
+void btreeIterInit(BTree *tree, BTreeIter *iter);
+void btreeRangeIterInit(BTree *tree, BTreeIter *iter, void *min, void *max);
+BTreeIter *btreeIterator(BTree *tree);
+BTreeIter *btreeRangeIterator(BTree *tree, void *min, void *max);
+
+int btreeIterHasNext(BTreeIter *iter);
+void btreeIterNext(BTreeIter *iter, void **key_ptr, void **value_ptr);
+void btreeIterDestroy(BTreeIter *iter);
+
+#endif
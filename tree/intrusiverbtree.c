@@ -0,0 +1,400 @@
+#include "intrusiverbtree.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stddef.h>
+
+#define RB_COLOR_RED 0
+#define RB_COLOR_BLACK 1
+
+/*
+ * The red-black tree core, with the links embedded in the caller's
+ * objects. Nothing is allocated or freed here: compare orders two linked
+ * objects and compare_key finds an object from a lookup key, both
+ * recovering the objects with containerOf. A link can be removed without
+ * searching for it.
+ *
+ * RBTree and CDS_DEFINE_RBTREE embed an RBLink in their nodes too. They
+ * search with their own compare and hand the slot they found to
+ * intrusiveRBTreeLink, so all of them share one set of rotations and
+ * fixups.
+ */
+#define rbIsRed(link) ((link) != NULL && (link)->color == RB_COLOR_RED)
+
+void intrusiveRBTreeInit(IntrusiveRBTree *tree,
+			 int (*compare)(RBLink *link1, RBLink *link2),
+			 int (*compare_key)(void *key, RBLink *link))
+{
+	tree->root = NULL;
+	tree->size = 0;
+	tree->compare = compare;
+	tree->compare_key = compare_key;
+	tree->order_stats = 0;
+}
+
+size_t intrusiveRBTreeSize(IntrusiveRBTree *tree) { return tree->size; }
+
+static unsigned int rbCountLinks(RBLink *link)
+{
+	if (link == NULL) {
+		return 0;
+	}
+
+	link->size = rbCountLinks(link->left) + rbCountLinks(link->right) + 1;
+	return link->size;
+}
+
+/*
+ * Keeps subtree sizes from now on, for select and rank in O(log n).
+ * Counting the links already in the tree takes O(n) once, and the tree
+ * may then hold up to UINT_MAX links.
+ */
+void intrusiveRBTreeEnableOrderStatistics(IntrusiveRBTree *tree)
+{
+	assert(tree->size < UINT_MAX);
+
+	if (!tree->order_stats) {
+		rbCountLinks(tree->root);
+		tree->order_stats = 1;
+	}
+}
+
+/* adjusts the subtree sizes from link up to the root */
+static void rbAddToPath(RBLink *link, unsigned int delta)
+{
+	for (; link != NULL; link = link->parent) {
+		link->size += delta;
+	}
+}
+
+static void rotateLeft(IntrusiveRBTree *tree, RBLink *link)
+{
+	RBLink *parent = link->parent;
+	RBLink *right = link->right;
+
+	link->right = right->left;
+	if (right->left != NULL) {
+		right->left->parent = link;
+	}
+
+	right->parent = parent;
+	if (parent == NULL) {
+		tree->root = right;
+	} else if (link == parent->left) {
+		parent->left = right;
+	} else {
+		parent->right = right;
+	}
+
+	right->left = link;
+	link->parent = right;
+
+	if (tree->order_stats) {
+		unsigned int moved =
+		    right->size - intrusiveRBTreeLinkSize(link->right);
+		right->size = link->size;
+		link->size -= moved;
+	}
+}
+
+static void rotateRight(IntrusiveRBTree *tree, RBLink *link)
+{
+	RBLink *parent = link->parent;
+	RBLink *left = link->left;
+
+	link->left = left->right;
+	if (left->right != NULL) {
+		left->right->parent = link;
+	}
+
+	left->parent = parent;
+	if (parent == NULL) {
+		tree->root = left;
+	} else if (link == parent->left) {
+		parent->left = left;
+	} else {
+		parent->right = left;
+	}
+
+	left->right = link;
+	link->parent = left;
+
+	if (tree->order_stats) {
+		unsigned int moved =
+		    left->size - intrusiveRBTreeLinkSize(link->left);
+		left->size = link->size;
+		link->size -= moved;
+	}
+}
+
+RBLink *intrusiveRBTreeFind(IntrusiveRBTree *tree, void *key)
+{
+	RBLink *link = tree->root;
+	int cmp;
+	while (link != NULL) {
+		cmp = tree->compare_key(key, link);
+		if (cmp == 0) {
+			return link;
+		}
+
+		link = cmp < 0 ? link->left : link->right;
+	}
+
+	return NULL;
+}
+
+static void insertFixUp(IntrusiveRBTree *tree, RBLink *link)
+{
+	RBLink *parent = NULL;
+	RBLink *grandparent = NULL;
+	RBLink *uncle = NULL;
+
+	while (rbIsRed(link->parent)) {
+		parent = link->parent;
+		grandparent = parent->parent;
+
+		if (grandparent->left == parent) {
+			uncle = grandparent->right;
+			if (rbIsRed(uncle)) {
+				parent->color = RB_COLOR_BLACK;
+				uncle->color = RB_COLOR_BLACK;
+				grandparent->color = RB_COLOR_RED;
+				link = grandparent;
+				continue;
+			}
+
+			if (link == parent->right) {
+				rotateLeft(tree, parent);
+				link = parent;
+				parent = link->parent;
+			}
+
+			parent->color = RB_COLOR_BLACK;
+			grandparent->color = RB_COLOR_RED;
+			rotateRight(tree, grandparent);
+		} else {
+			uncle = grandparent->left;
+			if (rbIsRed(uncle)) {
+				parent->color = RB_COLOR_BLACK;
+				uncle->color = RB_COLOR_BLACK;
+				grandparent->color = RB_COLOR_RED;
+				link = grandparent;
+				continue;
+			}
+
+			if (link == parent->left) {
+				rotateRight(tree, parent);
+				link = parent;
+				parent = link->parent;
+			}
+
+			parent->color = RB_COLOR_BLACK;
+			grandparent->color = RB_COLOR_RED;
+			rotateLeft(tree, grandparent);
+		}
+	}
+
+	tree->root->color = RB_COLOR_BLACK;
+}
+
+/*
+ * Links link into the empty slot found by a search, &tree->root or a
+ * child pointer of parent, and rebalances.
+ */
+void intrusiveRBTreeLink(IntrusiveRBTree *tree, RBLink *link, RBLink *parent,
+			 RBLink **slot)
+{
+	link->color = RB_COLOR_RED;
+	link->size = 1;
+	link->parent = parent;
+	link->left = NULL;
+	link->right = NULL;
+	*slot = link;
+
+	if (tree->order_stats) {
+		assert(tree->size < UINT_MAX);
+		rbAddToPath(parent, 1);
+	}
+
+	insertFixUp(tree, link);
+	++tree->size;
+}
+
+/* returns the already linked equal object instead of inserting, or NULL */
+RBLink *intrusiveRBTreeInsert(IntrusiveRBTree *tree, RBLink *link)
+{
+	RBLink *parent = NULL;
+	RBLink **slot = &tree->root;
+	int cmp;
+	while (*slot != NULL) {
+		parent = *slot;
+		cmp = tree->compare(link, parent);
+		if (cmp == 0) {
+			return parent;
+		}
+
+		slot = cmp < 0 ? &parent->left : &parent->right;
+	}
+
+	intrusiveRBTreeLink(tree, link, parent, slot);
+	return NULL;
+}
+
+static void transplant(IntrusiveRBTree *tree, RBLink *dest, RBLink *src)
+{
+	if (dest->parent == NULL) {
+		tree->root = src;
+	} else if (dest == dest->parent->left) {
+		dest->parent->left = src;
+	} else {
+		dest->parent->right = src;
+	}
+
+	if (src != NULL) {
+		src->parent = dest->parent;
+	}
+}
+
+/* link may be NULL, so its parent is passed explicitly */
+static void delFixUp(IntrusiveRBTree *tree, RBLink *link, RBLink *parent)
+{
+	RBLink *brother = NULL;
+	while (link != tree->root && !rbIsRed(link)) {
+		if (link == parent->left) {
+			brother = parent->right;
+			if (rbIsRed(brother)) {
+				brother->color = RB_COLOR_BLACK;
+				parent->color = RB_COLOR_RED;
+				rotateLeft(tree, parent);
+				brother = parent->right;
+			}
+
+			if (!rbIsRed(brother->left) &&
+			    !rbIsRed(brother->right)) {
+				brother->color = RB_COLOR_RED;
+				link = parent;
+				parent = link->parent;
+				continue;
+			}
+
+			if (!rbIsRed(brother->right)) {
+				brother->left->color = RB_COLOR_BLACK;
+				brother->color = RB_COLOR_RED;
+				rotateRight(tree, brother);
+				brother = parent->right;
+			}
+
+			brother->color = parent->color;
+			parent->color = RB_COLOR_BLACK;
+			brother->right->color = RB_COLOR_BLACK;
+			rotateLeft(tree, parent);
+			link = tree->root;
+		} else {
+			brother = parent->left;
+			if (rbIsRed(brother)) {
+				brother->color = RB_COLOR_BLACK;
+				parent->color = RB_COLOR_RED;
+				rotateRight(tree, parent);
+				brother = parent->left;
+			}
+
+			if (!rbIsRed(brother->left) &&
+			    !rbIsRed(brother->right)) {
+				brother->color = RB_COLOR_RED;
+				link = parent;
+				parent = link->parent;
+				continue;
+			}
+
+			if (!rbIsRed(brother->left)) {
+				brother->right->color = RB_COLOR_BLACK;
+				brother->color = RB_COLOR_RED;
+				rotateLeft(tree, brother);
+				brother = parent->left;
+			}
+
+			brother->color = parent->color;
+			parent->color = RB_COLOR_BLACK;
+			brother->left->color = RB_COLOR_BLACK;
+			rotateRight(tree, parent);
+			link = tree->root;
+		}
+	}
+
+	if (link != NULL) {
+		link->color = RB_COLOR_BLACK;
+	}
+}
+
+void intrusiveRBTreeRemove(IntrusiveRBTree *tree, RBLink *link)
+{
+	int color = link->color;
+	RBLink *fixUpLink = NULL;
+	RBLink *fixUpParent = NULL;
+	RBLink *next = NULL;
+	if (link->left != NULL && link->right != NULL) {
+		next = intrusiveRBTreeMin(link->right);
+	}
+
+	/* sizes shrink above the position that goes, rotations keep them */
+	if (tree->order_stats) {
+		rbAddToPath(next != NULL ? next->parent : link->parent, -1u);
+	}
+
+	if (link->left == NULL) {
+		fixUpLink = link->right;
+		fixUpParent = link->parent;
+		transplant(tree, link, fixUpLink);
+	} else if (link->right == NULL) {
+		fixUpLink = link->left;
+		fixUpParent = link->parent;
+		transplant(tree, link, fixUpLink);
+	} else {
+		color = next->color;
+		fixUpLink = next->right;
+		if (next->parent == link) {
+			fixUpParent = next;
+		} else {
+			fixUpParent = next->parent;
+			transplant(tree, next, next->right);
+			next->right = link->right;
+			next->right->parent = next;
+		}
+
+		transplant(tree, link, next);
+		next->left = link->left;
+		next->left->parent = next;
+		next->color = link->color;
+		next->size = link->size;
+	}
+
+	if (color == RB_COLOR_BLACK) {
+		delFixUp(tree, fixUpLink, fixUpParent);
+	}
+
+	link->parent = NULL;
+	link->left = NULL;
+	link->right = NULL;
+	--tree->size;
+}
+
+/* the link with index smaller links, NULL when index is out of range */
+RBLink *intrusiveRBTreeSelect(IntrusiveRBTree *tree, size_t index)
+{
+	assert(tree->order_stats);
+
+	RBLink *link = tree->root;
+	while (link != NULL) {
+		size_t left = intrusiveRBTreeLinkSize(link->left);
+		if (index < left) {
+			link = link->left;
+		} else if (index == left) {
+			break;
+		} else {
+			index -= left + 1;
+			link = link->right;
+		}
+	}
+
+	return link;
+}
@@ -0,0 +1,102 @@
+#ifndef INTRUSIVERBTREE_H
+#define INTRUSIVERBTREE_H
+
+#include <stddef.h>
+
+#ifndef containerOf
+#define containerOf(ptr, type, member)					\
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+typedef struct RBLink {
+	struct RBLink *parent;
+	struct RBLink *left;
+	struct RBLink *right;
+	int color;
+	/* links in this subtree, only kept up to date with order statistics */
+	unsigned int size;
+} RBLink;
+
+typedef struct IntrusiveRBTree {
+	RBLink *root;
+	size_t size;
+	int (*compare)(RBLink *link1, RBLink *link2);
+	int (*compare_key)(void *key, RBLink *link);
+	int order_stats;
+} IntrusiveRBTree;
+
+#define intrusiveRBTreeLinkSize(link) ((link) != NULL ? (link)->size : 0)
+
+void intrusiveRBTreeInit(IntrusiveRBTree *tree,
+			 int (*compare)(RBLink *link1, RBLink *link2),
+			 int (*compare_key)(void *key, RBLink *link));
+size_t intrusiveRBTreeSize(IntrusiveRBTree *tree);
+void intrusiveRBTreeEnableOrderStatistics(IntrusiveRBTree *tree);
+RBLink *intrusiveRBTreeFind(IntrusiveRBTree *tree, void *key);
+RBLink *intrusiveRBTreeInsert(IntrusiveRBTree *tree, RBLink *link);
+void intrusiveRBTreeLink(IntrusiveRBTree *tree, RBLink *link, RBLink *parent,
+			 RBLink **slot);
+void intrusiveRBTreeRemove(IntrusiveRBTree *tree, RBLink *link);
+RBLink *intrusiveRBTreeSelect(IntrusiveRBTree *tree, size_t index);
+
+static inline RBLink *intrusiveRBTreeMin(RBLink *link)
+{
+	while (link->left != NULL) {
+		link = link->left;
+	}
+
+	return link;
+}
+
+static inline RBLink *intrusiveRBTreeMax(RBLink *link)
+{
+	while (link->right != NULL) {
+		link = link->right;
+	}
+
+	return link;
+}
+
+static inline RBLink *intrusiveRBTreeFirst(IntrusiveRBTree *tree)
+{
+	return tree->root != NULL ? intrusiveRBTreeMin(tree->root) : NULL;
+}
+
+static inline RBLink *intrusiveRBTreeLast(IntrusiveRBTree *tree)
+{
+	return tree->root != NULL ? intrusiveRBTreeMax(tree->root) : NULL;
+}
+
+/* in order successor, NULL after the last link */
+static inline RBLink *intrusiveRBTreeNext(RBLink *link)
+{
+	if (link->right != NULL) {
+		return intrusiveRBTreeMin(link->right);
+	}
+
+	RBLink *parent = link->parent;
+	while (parent != NULL && link == parent->right) {
+		link = parent;
+		parent = parent->parent;
+	}
+
+	return parent;
+}
+
+/* in order predecessor, NULL before the first link */
+static inline RBLink *intrusiveRBTreePrev(RBLink *link)
+{
+	if (link->left != NULL) {
+		return intrusiveRBTreeMax(link->left);
+	}
+
+	RBLink *parent = link->parent;
+	while (parent != NULL && link == parent->left) {
+		link = parent;
+		parent = parent->parent;
+	}
+
+	return parent;
+}
+
+#endif
@@ -1,49 +1,69 @@
 #include "rbtree.h"
+#include "pool.h"
 
+#include <assert.h>
 #include <stddef.h>
 #include <string.h>
 
-#define RB_COLOR_RED 0
-#define RB_COLOR_BLACK 1
-
-typedef struct RBTreeNode RBTreeNode;
-
-struct RBTreeNode {
-	void *key;
-	void *value;
-	int color;
-	RBTreeNode *parent;
-	RBTreeNode *left;
-	RBTreeNode *right;
-};
+#define DIRECTION_ASCENDING 1
+#define DIRECTION_DESCENDING 0
 
+/*
+ * Balancing and order statistics are left to the intrusive core, the
+ * tree only searches with its compare method and owns the nodes.
+ */
 struct RBTree {
-	RBTreeNode *root;
-	size_t size;
+	IntrusiveRBTree links;
 
 	void *(*alloc)(size_t);
 	void (*dealloc)(void *);
 	void (*free_key)(void *);
 	void (*free_value)(void *);
 	int (*compare)(void *, void *);
-};
 
-struct RBTreeIter {
-	RBTreeNode *next;
-	void (*dealloc)(void *);
+	Pool *pool;
 };
 
-#define rbtreeIsRed(node) ((node) != NULL && (node)->color == RB_COLOR_RED)
+#define rbtreeRoot(tree) rbtreeNodeOf((tree)->links.root)
+#define rbtreeLeft(node) rbtreeNodeOf((node)->link.left)
+#define rbtreeRight(node) rbtreeNodeOf((node)->link.right)
 
 RBTree *rbtreeCreate(void *(*alloc)(size_t), void (*dealloc)(void *))
 {
 	RBTree *tree = alloc(sizeof(RBTree));
 	memset(tree, 0, sizeof(RBTree));
+	intrusiveRBTreeInit(&tree->links, NULL, NULL);
 	tree->alloc = alloc;
 	tree->dealloc = dealloc;
 	return tree;
 }
 
+RBTree *rbtreeCreatePooled(void *(*alloc)(size_t), void (*dealloc)(void *))
+{
+	RBTree *tree = rbtreeCreate(alloc, dealloc);
+	tree->pool = poolCreate(alloc, dealloc, sizeof(RBTreeNode),
+				POOL_DEFAULT_SLAB_NODES);
+	return tree;
+}
+
+static inline RBTreeNode *rbtreeAllocNode(RBTree *tree)
+{
+	if (tree->pool != NULL) {
+		return poolAlloc(tree->pool);
+	}
+
+	return tree->alloc(sizeof(RBTreeNode));
+}
+
+static inline void rbtreeDeallocNode(RBTree *tree, RBTreeNode *node)
+{
+	if (tree->pool != NULL) {
+		poolFree(tree->pool, node);
+	} else {
+		tree->dealloc(node);
+	}
+}
+
 void (*rbtreeGetFreeKeyMethod(RBTree *tree))(void *key)
 {
 	return tree->free_key;
@@ -74,444 +94,378 @@ void rbtreeSetCompareMethod(RBTree *tree, int (*compare)(void *, void *))
 	tree->compare = compare;
 }
 
-static void rotateLeft(RBTree *tree, RBTreeNode *node)
+/*
+ * Keeps subtree sizes from now on, for select, rank and percentiles in
+ * O(log n). Counting the nodes already in the tree takes O(n) once, and
+ * the tree may then hold up to UINT_MAX nodes.
+ */
+void rbtreeEnableOrderStatistics(RBTree *tree)
 {
-	RBTreeNode *parent = node->parent;
-	RBTreeNode *right = node->right;
-	if (tree->root == node) {
-		tree->root = right;
-	}
-	node->parent = right;
-	right->parent = parent;
-	node->right = right->left;
-	right->left = node;
+	intrusiveRBTreeEnableOrderStatistics(&tree->links);
 }
 
-static void rotateRight(RBTree *tree, RBTreeNode *node)
-{
-	RBTreeNode *parent = node->parent;
-	RBTreeNode *left = node->left;
-	if (tree->root == node) {
-		tree->root = left;
-	}
-	node->parent = left;
-	left->parent = parent;
-	node->left = left->right;
-	left->right = node;
-}
+int rbtreeHasOrderStatistics(RBTree *tree) { return tree->links.order_stats; }
 
-size_t rbtreeSize(RBTree *tree) { return tree->size; }
+size_t rbtreeSize(RBTree *tree) { return tree->links.size; }
 
-static RBTreeNode *successor(RBTreeNode *node)
+int rbtreeContains(RBTree *tree, void *key)
 {
-	if (node == NULL) {
-		return NULL;
-	}
-
-	if (node->right != NULL) {
-		node = node->right;
-		while (node->left != NULL) {
-			node = node->left;
-		}
-	} else {
-		RBTreeNode *parent = node->parent;
-		while (parent != NULL && node == parent->right) {
-			node = parent;
-			parent = parent->parent;
-		}
+	return rbtreeGet(tree, key) != NULL;
+}
 
-		node = parent;
+static inline RBTreeNode *rbtreeFindNode(RBTree *tree, void *key)
+{
+	RBTreeNode *node = rbtreeRoot(tree);
+	int cmp;
+	while (node != NULL && (cmp = tree->compare(key, node->key)) != 0) {
+		node = cmp < 0 ? rbtreeLeft(node) : rbtreeRight(node);
 	}
 
 	return node;
 }
 
-int rbtreeContains(RBTree *tree, void *key)
+void *rbtreeGet(RBTree *tree, void *key)
 {
-	return rbtreeGet(tree, key) != NULL;
+	RBTreeNode *node = rbtreeFindNode(tree, key);
+	return node != NULL ? node->value : NULL;
 }
 
-void *rbtreeGet(RBTree *tree, void *key)
+void rbtreeSet(RBTree *tree, void *key, void *value)
 {
-	RBTreeNode *node = tree->root;
+	RBLink *parent = NULL;
+	RBLink **slot = &tree->links.root;
+	RBTreeNode *node;
 	int cmp;
-	while (node != NULL) {
+	while (*slot != NULL) {
+		parent = *slot;
+		node = rbtreeNodeOf(parent);
 		cmp = tree->compare(key, node->key);
 		if (cmp == 0) {
-			break;
-		} else if (cmp < 0) {
-			node = node->left;
-		} else {
-			node = node->right;
+			if (tree->free_value != NULL) {
+				tree->free_value(node->value);
+			}
+			node->value = value;
+			return;
 		}
-	}
 
-	if (node == NULL) {
-		return NULL;
+		slot = cmp < 0 ? &parent->left : &parent->right;
 	}
 
-	return node->value;
+	node = rbtreeAllocNode(tree);
+	node->key = key;
+	node->value = value;
+	intrusiveRBTreeLink(&tree->links, &node->link, parent, slot);
 }
 
-static void insertFixUp(RBTree *tree, RBTreeNode *node)
+static void rbtreeFreeNode(RBTree *tree, RBTreeNode *node)
 {
-	RBTreeNode *parent = NULL;
-	RBTreeNode *grandparent = NULL;
-	RBTreeNode *uncle = NULL;
-	RBTreeNode *tmpNode = NULL;
+	if (tree->free_key != NULL) {
+		tree->free_key(node->key);
+	}
 
-	while (rbtreeIsRed(node)) {
-		parent = node->parent;
-		if (parent == NULL || !rbtreeIsRed(parent)) {
-			break;
-		}
+	if (tree->free_value != NULL) {
+		tree->free_value(node->value);
+	}
 
-		grandparent = parent->parent;
-		if (grandparent == NULL) {
-			break;
-		}
+	rbtreeDeallocNode(tree, node);
+}
 
-		if (grandparent->left == parent) {
-			uncle = grandparent->right;
-			if (node == parent->right) {
-				rotateLeft(tree, parent);
-				tmpNode = node;
-				node = parent;
-				parent = tmpNode;
-			}
+void *rbtreeRemove(RBTree *tree, void *key)
+{
+	RBTreeNode *node = rbtreeFindNode(tree, key);
+	if (node == NULL) {
+		return NULL;
+	}
 
-			if (rbtreeIsRed(uncle)) {
-				parent->color = RB_COLOR_BLACK;
-				uncle->color = RB_COLOR_BLACK;
-				grandparent->color = RB_COLOR_RED;
-				node = grandparent;
-			} else {
-				rotateRight(tree, grandparent);
-				parent->color = RB_COLOR_BLACK;
-				grandparent->color = RB_COLOR_RED;
-				node = parent;
-			}
-		} else {
-			uncle = grandparent->left;
-			if (node == parent->left) {
-				rotateRight(tree, parent);
-				tmpNode = node;
-				node = parent;
-				parent = tmpNode;
-			}
+	intrusiveRBTreeRemove(&tree->links, &node->link);
 
-			if (rbtreeIsRed(uncle)) {
-				parent->color = RB_COLOR_BLACK;
-				uncle->color = RB_COLOR_BLACK;
-				grandparent->color = RB_COLOR_RED;
-				node = grandparent;
-			} else {
-				rotateLeft(tree, grandparent);
-				parent->color = RB_COLOR_BLACK;
-				grandparent->color = RB_COLOR_RED;
-				node = parent;
-			}
-		}
+	void *value = node->value;
+
+	if (tree->free_key != NULL) {
+		tree->free_key(node->key);
 	}
 
-	tree->root->color = RB_COLOR_BLACK;
+	rbtreeDeallocNode(tree, node);
+	return value;
 }
 
-void rbtreeSet(RBTree *tree, void *key, void *value)
+void rbtreeDel(RBTree *tree, void *key)
 {
-	RBTreeNode *later = NULL;
-	RBTreeNode *current = tree->root;
-	int cmp;
-	while (current != NULL) {
-		cmp = tree->compare(key, current->key);
-		if (cmp == 0) {
-			if (tree->free_value != NULL) {
-				tree->free_value(current->value);
-			}
-			current->value = value;
-			return;
-		}
-
-		if (cmp < 0) {
-			later = current;
-			current = current->left;
-		} else {
-			later = current;
-			current = current->right;
-		}
+	void *value = rbtreeRemove(tree, key);
+	if (value != NULL && tree->free_value != NULL) {
+		tree->free_value(value);
 	}
+}
 
-	current = tree->alloc(sizeof(RBTreeNode));
-	current->key = key;
-	current->value = value;
-	current->color = RB_COLOR_RED;
-	current->parent = later;
-	current->left = NULL;
-	current->right = NULL;
+void rbtreeClear(RBTree *tree)
+{
+	RBLink *link = tree->links.root;
+	RBLink *parent = NULL;
+	/* pooled nodes go with their slabs unless keys/values need freeing */
+	if (tree->pool != NULL && tree->free_key == NULL &&
+	    tree->free_value == NULL) {
+		link = NULL;
+	}
 
-	if (tree->root == NULL) {
-		tree->root = current;
-	} else {
-		if (cmp < 0) {
-			later->left = current;
+	while (link != NULL) {
+		if (link->left != NULL) {
+			link = link->left;
+		} else if (link->right != NULL) {
+			link = link->right;
 		} else {
-			later->right = current;
+			parent = link->parent;
+			if (parent != NULL) {
+				if (parent->left == link) {
+					parent->left = NULL;
+				} else {
+					parent->right = NULL;
+				}
+			}
+
+			rbtreeFreeNode(tree, rbtreeNodeOf(link));
+			link = parent;
 		}
 	}
 
-	insertFixUp(tree, current);
+	if (tree->pool != NULL) {
+		poolClear(tree->pool);
+	}
 
-	++tree->size;
+	tree->links.root = NULL;
+	tree->links.size = 0;
 }
 
-static void transplant(RBTree *tree, RBTreeNode *dest, RBTreeNode *src)
+void rbtreeDestroy(RBTree *tree)
 {
-	if (dest->parent == NULL) {
-		tree->root = src;
-	} else if (dest == dest->parent->left) {
-		dest->parent->left = src;
-	} else {
-		dest->parent->right = src;
+	rbtreeClear(tree);
+	if (tree->pool != NULL) {
+		poolDestroy(tree->pool);
 	}
 
-	if (src != NULL) {
-		src->color = dest->color;
-		src->parent = dest->parent;
-	}
+	tree->dealloc(tree);
 }
 
-static RBTreeNode *rbtreeMinNode(RBTree *tree, RBTreeNode *root)
+RBTreeNode *rbtreeFirst(RBTree *tree)
 {
-	while (root->left != NULL) {
-		root = root->left;
-	}
-
-	return root;
+	return rbtreeNodeOf(intrusiveRBTreeFirst(&tree->links));
 }
 
-static void rbtreeFreeNode(RBTree *tree, RBTreeNode *node)
+RBTreeNode *rbtreeLast(RBTree *tree)
 {
-	if (tree->free_key != NULL) {
-		tree->free_key(node->key);
-	}
+	return rbtreeNodeOf(intrusiveRBTreeLast(&tree->links));
+}
 
-	if (tree->free_value != NULL) {
-		tree->free_value(node->value);
+/* the first node whose key is greater than key, or not less when equal */
+static RBTreeNode *rbtreeBound(RBTree *tree, void *key, int equal)
+{
+	RBTreeNode *node = rbtreeRoot(tree);
+	RBTreeNode *bound = NULL;
+	while (node != NULL) {
+		int cmp = tree->compare(key, node->key);
+		if (cmp < 0 || (cmp == 0 && equal)) {
+			bound = node;
+			node = rbtreeLeft(node);
+		} else {
+			node = rbtreeRight(node);
+		}
 	}
 
-	tree->dealloc(node);
+	return bound;
 }
 
-static void delFixUp(RBTree *tree, RBTreeNode *node)
+/* the first node not less than key */
+RBTreeNode *rbtreeLowerBound(RBTree *tree, void *key)
 {
-	RBTreeNode *parent = NULL;
-	while (node != tree->root) {
-		if (rbtreeIsRed(node)) {
-			node->color = RB_COLOR_BLACK;
-			break;
-		}
+	return rbtreeBound(tree, key, 1);
+}
 
-		parent = node->parent;
-		if (parent == NULL) {
-			break;
-		}
+/* the first node greater than key */
+RBTreeNode *rbtreeUpperBound(RBTree *tree, void *key)
+{
+	return rbtreeBound(tree, key, 0);
+}
 
-		RBTreeNode *brother = NULL;
-		if (node == parent->left) {
-			brother = parent->right;
-			if (rbtreeIsRed(brother)) {
-				rotateLeft(tree, parent);
-				parent->color = RB_COLOR_RED;
-				brother->color = RB_COLOR_BLACK;
-				brother = parent->right;
-			}
+/* the last node not greater than key */
+RBTreeNode *rbtreeFloor(RBTree *tree, void *key)
+{
+	RBTreeNode *node = rbtreeUpperBound(tree, key);
+	return node != NULL ? rbtreeNodePrev(node) : rbtreeLast(tree);
+}
 
-			if (!rbtreeIsRed(brother->left) &&
-			    !rbtreeIsRed(brother->right)) {
-				brother->color = RB_COLOR_RED;
-				node = parent;
-			} else {
-				if (rbtreeIsRed(node->left)) {
-					brother->left->color = RB_COLOR_BLACK;
-					brother->color = RB_COLOR_RED;
-					rotateRight(tree, brother);
-					brother = parent->right;
-				}
+RBTreeNode *rbtreeCeiling(RBTree *tree, void *key)
+{
+	return rbtreeLowerBound(tree, key);
+}
 
-				brother->right->color = RB_COLOR_BLACK;
-				brother->color = parent->color;
-				parent->color = RB_COLOR_BLACK;
-				rotateLeft(tree, parent);
-				node = tree->root;
-			}
-		} else {
-			brother = parent->left;
-			if (rbtreeIsRed(brother)) {
-				rotateRight(tree, parent);
-				parent->color = RB_COLOR_RED;
-				brother->color = RB_COLOR_BLACK;
-				brother = parent->left;
-			}
+/* keys in [min, max), O(log n) with order statistics, O(log n + k) without */
+size_t rbtreeCountRange(RBTree *tree, void *min, void *max)
+{
+	if (tree->links.order_stats) {
+		if (tree->compare(min, max) >= 0) {
+			return 0;
+		}
 
-			if (!rbtreeIsRed(brother->left) &&
-			    !rbtreeIsRed(brother->right)) {
-				brother->left->color = RB_COLOR_RED;
-				node = parent;
-			} else {
-				if (rbtreeIsRed(brother->right)) {
-					brother->right->color = RB_COLOR_BLACK;
-					brother->color = RB_COLOR_RED;
-					rotateLeft(tree, brother);
-					brother = parent->left;
-				}
+		return rbtreeRank(tree, max) - rbtreeRank(tree, min);
+	}
 
-				brother->color = parent->color;
-				parent->color = RB_COLOR_BLACK;
-				brother->left->color = RB_COLOR_BLACK;
-				rotateRight(tree, parent);
-				node = tree->root;
-			}
-		}
+	RBTreeIter iter;
+	size_t count = 0;
+	rbtreeRangeIterInit(tree, &iter, min, max);
+	for (; iter.next != iter.end; iter.next = rbtreeNodeNext(iter.next)) {
+		++count;
 	}
 
-	tree->root->color = RB_COLOR_BLACK;
+	return count;
 }
 
-void *rbtreeRemove(RBTree *tree, void *key)
+/* the node with index smaller keys, NULL when index is out of range */
+RBTreeNode *rbtreeSelect(RBTree *tree, size_t index)
 {
-	RBTreeNode *node = tree->root;
-	int cmp;
-	while (node != NULL && (cmp = tree->compare(key, node->key)) != 0) {
-		if (cmp < 0) {
-			node = node->left;
-		} else {
-			node = node->right;
-		}
-	}
-
-	if (node == NULL) {
-		return tree;
-	}
+	return rbtreeNodeOf(intrusiveRBTreeSelect(&tree->links, index));
+}
 
-	int color = node->color;
-	RBTreeNode *fixUpNode = NULL;
+/* the number of keys less than key, its index when present */
+size_t rbtreeRank(RBTree *tree, void *key)
+{
+	assert(tree->links.order_stats);
 
-	if (node->left == NULL) {
-		fixUpNode = node->right;
-	} else if (node->right == NULL) {
-		fixUpNode = node->left;
-	} else {
-		RBTreeNode *tmpNode = rbtreeMinNode(tree, node->right);
-		if (tmpNode->parent == node) {
-			fixUpNode = tmpNode;
+	RBTreeNode *node = rbtreeRoot(tree);
+	size_t rank = 0;
+	while (node != NULL) {
+		if (tree->compare(key, node->key) <= 0) {
+			node = rbtreeLeft(node);
 		} else {
-			void *tmp = NULL;
-			tmp = node->key;
-			node->key = tmpNode->key;
-			tmpNode->key = tmp;
-
-			tmp = node->value;
-			node->value = tmpNode->value;
-			tmpNode->value = tmp;
-
-			node = tmpNode;
-			color = node->color;
-			fixUpNode = node->right;
+			rank += intrusiveRBTreeLinkSize(node->link.left) + 1;
+			node = rbtreeRight(node);
 		}
 	}
 
-	if (color != RB_COLOR_BLACK || fixUpNode != NULL) {
-		transplant(tree, node, fixUpNode);
-	}
+	return rank;
+}
 
-	if (color == RB_COLOR_BLACK) {
-		delFixUp(tree, fixUpNode);
+/* nearest rank percentile for percentile in [0, 100], NULL when empty */
+RBTreeNode *rbtreePercentile(RBTree *tree, double percentile)
+{
+	if (tree->links.size == 0) {
+		return NULL;
 	}
 
-	if (color == RB_COLOR_BLACK && fixUpNode == NULL) {
-		// delay
-		transplant(tree, node, NULL);
+	double exact = percentile / 100 * tree->links.size;
+	size_t rank = exact > 0 ? (size_t)exact : 0;
+	if (rank < exact) {
+		++rank;
 	}
 
-	void *value = node->value;
-
-	if (tree->free_key != NULL) {
-		tree->free_key(node->key);
+	size_t index = rank > 0 ? rank - 1 : 0;
+	if (index >= tree->links.size) {
+		index = tree->links.size - 1;
 	}
 
-	tree->dealloc(node);
+	return rbtreeSelect(tree, index);
+}
 
-	--tree->size;
-	return value;
+void rbtreeIterInitAt(RBTreeIter *iter, RBTreeNode *node)
+{
+	iter->next = node;
+	iter->end = NULL;
+	iter->direction = DIRECTION_ASCENDING;
+	iter->dealloc = NULL;
 }
 
-void rbtreeDel(RBTree *tree, void *key)
+void rbtreeReverseIterInitAt(RBTreeIter *iter, RBTreeNode *node)
 {
-	void *value = rbtreeRemove(tree, key);
-	if (tree->free_value != NULL) {
-		tree->free_value(value);
-	}
+	iter->next = node;
+	iter->end = NULL;
+	iter->direction = DIRECTION_DESCENDING;
+	iter->dealloc = NULL;
 }
 
-// Morris Postorder Traversal
-void rbtreeClear(RBTree *tree)
+void rbtreeIterInit(RBTree *tree, RBTreeIter *iter)
 {
-	RBTreeNode node;
-	node.left = tree->root;
-	node.right = NULL;
-	node.parent = NULL;
-
-	RBTreeNode *current = &node;
-	RBTreeNode *tmp = NULL;
-	while (current != NULL) {
-		if ((tmp = current->left) != NULL) {
-			while (tmp->right != NULL && tmp->right != current) {
-				tmp = tmp->right;
-			}
+	rbtreeIterInitAt(iter, rbtreeFirst(tree));
+}
 
-			if (tmp->right == NULL) {
-				tmp->right = current;
-				current = current->left;
-			} else {
-				RBTreeNode *tmpParent = NULL;
-				while (tmp != current) {
-					tmpParent = tmp->parent;
-					rbtreeFreeNode(tree, tmp);
-					tmp = tmpParent;
-				}
+void rbtreeReverseIterInit(RBTree *tree, RBTreeIter *iter)
+{
+	rbtreeReverseIterInitAt(iter, rbtreeLast(tree));
+}
 
-				current = current->right;
-			}
-		} else {
-			current = current->right;
+/* iterates the keys in [min, max) ascending */
+void rbtreeRangeIterInit(RBTree *tree, RBTreeIter *iter, void *min,
+			 void *max)
+{
+	rbtreeIterInitAt(iter, NULL);
+	if (tree->compare(min, max) < 0) {
+		iter->next = rbtreeLowerBound(tree, min);
+		iter->end = rbtreeLowerBound(tree, max);
+	}
+}
+
+/* iterates the keys in [min, max) descending */
+void rbtreeReverseRangeIterInit(RBTree *tree, RBTreeIter *iter, void *min,
+				void *max)
+{
+	rbtreeReverseIterInitAt(iter, NULL);
+	if (tree->compare(min, max) < 0) {
+		RBTreeNode *last = rbtreeLowerBound(tree, max);
+		RBTreeNode *first = rbtreeLowerBound(tree, min);
+		if (first != last) {
+			iter->next = last != NULL ? rbtreeNodePrev(last)
+						  : rbtreeLast(tree);
+			iter->end = rbtreeNodePrev(first);
 		}
 	}
+}
 
-	tree->root = NULL;
-	tree->size = 0;
+RBTreeIter *rbtreeIterator(RBTree *tree)
+{
+	RBTreeIter *iter = tree->alloc(sizeof(RBTreeIter));
+	rbtreeIterInit(tree, iter);
+	iter->dealloc = tree->dealloc;
+	return iter;
 }
 
-void rbtreeDestroy(RBTree *tree)
+RBTreeIter *rbtreeReverseIterator(RBTree *tree)
 {
-	rbtreeClear(tree);
-	tree->dealloc(tree);
+	RBTreeIter *iter = tree->alloc(sizeof(RBTreeIter));
+	rbtreeReverseIterInit(tree, iter);
+	iter->dealloc = tree->dealloc;
+	return iter;
 }
 
-RBTreeIter *rbtreeIterator(RBTree *tree)
+RBTreeIter *rbtreeRangeIterator(RBTree *tree, void *min, void *max)
+{
+	RBTreeIter *iter = tree->alloc(sizeof(RBTreeIter));
+	rbtreeRangeIterInit(tree, iter, min, max);
+	iter->dealloc = tree->dealloc;
+	return iter;
+}
+
+RBTreeIter *rbtreeReverseRangeIterator(RBTree *tree, void *min, void *max)
 {
 	RBTreeIter *iter = tree->alloc(sizeof(RBTreeIter));
+	rbtreeReverseRangeIterInit(tree, iter, min, max);
 	iter->dealloc = tree->dealloc;
-	iter->next = rbtreeMinNode(tree, tree->root);
 	return iter;
 }
 
-int rbtreeIterHasNext(RBTreeIter *iter) { return iter->next != NULL; }
+int rbtreeIterHasNext(RBTreeIter *iter) { return iter->next != iter->end; }
 
 void rbtreeIterNext(RBTreeIter *iter, void **key_ptr, void **value_ptr)
 {
 	*key_ptr = iter->next->key;
 	*value_ptr = iter->next->value;
-	iter->next = successor(iter->next);
+	if (iter->direction) {
+		iter->next = rbtreeNodeNext(iter->next);
+	} else {
+		iter->next = rbtreeNodePrev(iter->next);
+	}
 }
 
-void rbtreeIterDestroy(RBTreeIter *iter) { iter->dealloc(iter); }
+/* a no-op for iterators set up by rbtreeIterInit */
+void rbtreeIterDestroy(RBTreeIter *iter)
+{
+	if (iter->dealloc != NULL) {
+		iter->dealloc(iter);
+	}
+}
@@ -1,18 +1,71 @@
 #ifndef RBTREE_H
 #define RBTREE_H
 
+#include "intrusiverbtree.h"
+
 #include <stddef.h>
 
 typedef struct RBTree RBTree;
+typedef struct RBTreeNode RBTreeNode;
 typedef struct RBTreeIter RBTreeIter;
 
+/* the tree is kept by the intrusive core through the embedded link */
+struct RBTreeNode {
+	/* first, so getting from a link to its node costs nothing */
+	RBLink link;
+	void *key;
+	void *value;
+};
+
+/* set up by rbtreeIterInit it can live on the stack and needs no destroy */
+struct RBTreeIter {
+	RBTreeNode *next;
+	/* iteration stops on reaching end, NULL runs to the last node */
+	RBTreeNode *end;
+	int direction;
+	void (*dealloc)(void *);
+};
+
+static inline RBTreeNode *rbtreeNodeOf(RBLink *link)
+{
+	return link != NULL ? containerOf(link, RBTreeNode, link) : NULL;
+}
+
+/* in order successor, NULL after the last node */
+static inline RBTreeNode *rbtreeNodeNext(RBTreeNode *node)
+{
+	if (node == NULL) {
+		return NULL;
+	}
+
+	return rbtreeNodeOf(intrusiveRBTreeNext(&node->link));
+}
+
+/* in order predecessor, NULL before the first node */
+static inline RBTreeNode *rbtreeNodePrev(RBTreeNode *node)
+{
+	if (node == NULL) {
+		return NULL;
+	}
+
+	return rbtreeNodeOf(intrusiveRBTreePrev(&node->link));
+}
+
+/* the loop body must not change the tree, break leaves early */
+#define rbtreeForEach(tree, node)					\
+	for ((node) = rbtreeFirst(tree); (node) != NULL;		\
+	     (node) = rbtreeNodeNext(node))
+
 RBTree *rbtreeCreate(void *(*alloc)(size_t), void (*dealloc)(void *));
+RBTree *rbtreeCreatePooled(void *(*alloc)(size_t), void (*dealloc)(void *));
 void (*rbtreeGetFreeKeyMethod(RBTree *tree))(void *key);
 void rbtreeSetFreeKeyMethod(RBTree *tree, void (*free_key)(void *));
 void (*rbtreeGetFreeValueMethod(RBTree *tree))(void *value);
 void rbtreeSetFreeValueMethod(RBTree *tree, void (*free_value)(void *));
 int (*rbtreeGetCompareMethod(RBTree *tree))(void *key1, void *key2);
 void rbtreeSetCompareMethod(RBTree *tree, int (*compare)(void *, void *));
+void rbtreeEnableOrderStatistics(RBTree *tree);
+int rbtreeHasOrderStatistics(RBTree *tree);
 size_t rbtreeSize(RBTree *tree);
 int rbtreeContains(RBTree *tree, void *key);
 void *rbtreeGet(RBTree *tree, void *key);
@@ -21,10 +74,48 @@ void *rbtreeRemove(RBTree *tree, void *key);
 void rbtreeDel(RBTree *tree, void *key);
 void rbtreeClear(RBTree *tree);
 void rbtreeDestroy(RBTree *tree);
+RBTreeNode *rbtreeFirst(RBTree *tree);
+RBTreeNode *rbtreeLast(RBTree *tree);
+RBTreeNode *rbtreeLowerBound(RBTree *tree, void *key);
+RBTreeNode *rbtreeUpperBound(RBTree *tree, void *key);
+RBTreeNode *rbtreeFloor(RBTree *tree, void *key);
+RBTreeNode *rbtreeCeiling(RBTree *tree, void *key);
+size_t rbtreeCountRange(RBTree *tree, void *min, void *max);
+RBTreeNode *rbtreeSelect(RBTree *tree, size_t index);
+size_t rbtreeRank(RBTree *tree, void *key);
+RBTreeNode *rbtreePercentile(RBTree *tree, double percentile);
+void rbtreeIterInit(RBTree *tree, RBTreeIter *iter);
+void rbtreeReverseIterInit(RBTree *tree, RBTreeIter *iter);
+void rbtreeIterInitAt(RBTreeIter *iter, RBTreeNode *node);
+void rbtreeReverseIterInitAt(RBTreeIter *iter, RBTreeNode *node);
+void rbtreeRangeIterInit(RBTree *tree, RBTreeIter *iter, void *min,
+			 void *max);
+void rbtreeReverseRangeIterInit(RBTree *tree, RBTreeIter *iter, void *min,
+				void *max);
 RBTreeIter *rbtreeIterator(RBTree *tree);
+RBTreeIter *rbtreeReverseIterator(RBTree *tree);
+RBTreeIter *rbtreeRangeIterator(RBTree *tree, void *min, void *max);
+RBTreeIter *rbtreeReverseRangeIterator(RBTree *tree, void *min, void *max);
 
 int rbtreeIterHasNext(RBTreeIter *iter);
 void rbtreeIterNext(RBTreeIter *iter, void **key_ptr, void **value_ptr);
 void rbtreeIterDestroy(RBTreeIter *iter);
 
+/* visits every entry in key order until visit returns non-zero */
+static inline int rbtreeVisit(RBTree *tree,
+			      int (*visit)(void *key, void *value,
+					   void *privdata),
+			      void *privdata)
+{
+	RBTreeNode *node;
+	rbtreeForEach(tree, node) {
+		int ret = visit(node->key, node->value, privdata);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
 #endif
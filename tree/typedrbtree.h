@@ -0,0 +1,167 @@
+#ifndef TYPEDRBTREE_H
+#define TYPEDRBTREE_H
+
+#include "intrusiverbtree.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Generates a red-black tree named name with keys of type K and values of
+ * type V stored by value in the nodes. cmp(key1, key2) returns a negative,
+ * zero or positive int and is expanded in place, so it gets inlined when
+ * it is a static inline function or a macro. Iteration is in key order.
+ * Searches are generated here, balancing is the intrusive core's, so
+ * users link intrusiverbtree.o.
+ */
+#define CDS_DEFINE_RBTREE(name, K, V, cmp)				\
+typedef struct name##Node {						\
+	RBLink link;							\
+	K key;								\
+	V value;							\
+} name##Node;								\
+									\
+typedef struct name {							\
+	IntrusiveRBTree links;						\
+									\
+	void *(*alloc)(size_t);						\
+	void (*dealloc)(void *);					\
+} name;									\
+									\
+typedef struct name##Iter {						\
+	RBLink *next;							\
+} name##Iter;								\
+									\
+static inline name *name##Create(void *(*alloc)(size_t),		\
+				 void (*dealloc)(void *))		\
+{									\
+	name *tree = alloc(sizeof(name));				\
+	memset(tree, 0, sizeof(name));					\
+	intrusiveRBTreeInit(&tree->links, NULL, NULL);			\
+	tree->alloc = alloc;						\
+	tree->dealloc = dealloc;					\
+	return tree;							\
+}									\
+									\
+static inline size_t name##Size(name *tree) { return tree->links.size; } \
+									\
+static inline name##Node *name##NodeOf(RBLink *link)			\
+{									\
+	return containerOf(link, name##Node, link);			\
+}									\
+									\
+static inline name##Node *name##FindNode(name *tree, K key)		\
+{									\
+	RBLink *link = tree->links.root;				\
+	int c;								\
+	while (link != NULL &&						\
+	       (c = cmp(key, name##NodeOf(link)->key)) != 0) {		\
+		link = c < 0 ? link->left : link->right;		\
+	}								\
+									\
+	return link != NULL ? name##NodeOf(link) : NULL;		\
+}									\
+									\
+static inline V *name##Get(name *tree, K key)				\
+{									\
+	name##Node *node = name##FindNode(tree, key);			\
+	return node != NULL ? &node->value : NULL;			\
+}									\
+									\
+static inline int name##Contains(name *tree, K key)			\
+{									\
+	return name##FindNode(tree, key) != NULL;			\
+}									\
+									\
+static inline void name##Set(name *tree, K key, V value)		\
+{									\
+	RBLink *parent = NULL;						\
+	RBLink **slot = &tree->links.root;				\
+	name##Node *node;						\
+	int c;								\
+	while (*slot != NULL) {						\
+		parent = *slot;						\
+		node = name##NodeOf(parent);				\
+		c = cmp(key, node->key);				\
+		if (c == 0) {						\
+			node->value = value;				\
+			return;						\
+		}							\
+									\
+		slot = c < 0 ? &parent->left : &parent->right;		\
+	}								\
+									\
+	node = tree->alloc(sizeof(name##Node));				\
+	node->key = key;						\
+	node->value = value;						\
+	intrusiveRBTreeLink(&tree->links, &node->link, parent, slot);	\
+}									\
+									\
+static inline int name##Remove(name *tree, K key, V *value_ptr)		\
+{									\
+	name##Node *node = name##FindNode(tree, key);			\
+	if (node == NULL) {						\
+		return 0;						\
+	}								\
+									\
+	intrusiveRBTreeRemove(&tree->links, &node->link);		\
+	if (value_ptr != NULL) {					\
+		*value_ptr = node->value;				\
+	}								\
+									\
+	tree->dealloc(node);						\
+	return 1;							\
+}									\
+									\
+static inline void name##Clear(name *tree)				\
+{									\
+	RBLink *link = tree->links.root;				\
+	RBLink *parent;							\
+	while (link != NULL) {						\
+		if (link->left != NULL) {				\
+			link = link->left;				\
+		} else if (link->right != NULL) {			\
+			link = link->right;				\
+		} else {						\
+			parent = link->parent;				\
+			if (parent != NULL && parent->left == link) {	\
+				parent->left = NULL;			\
+			} else if (parent != NULL) {			\
+				parent->right = NULL;			\
+			}						\
+									\
+			tree->dealloc(name##NodeOf(link));		\
+			link = parent;					\
+		}							\
+	}								\
+									\
+	tree->links.root = NULL;					\
+	tree->links.size = 0;						\
+}									\
+									\
+static inline void name##Destroy(name *tree)				\
+{									\
+	name##Clear(tree);						\
+	tree->dealloc(tree);						\
+}									\
+									\
+static inline void name##IterInit(name##Iter *iter, name *tree)		\
+{									\
+	iter->next = intrusiveRBTreeFirst(&tree->links);		\
+}									\
+									\
+static inline int name##IterHasNext(name##Iter *iter)			\
+{									\
+	return iter->next != NULL;					\
+}									\
+									\
+static inline void name##IterNext(name##Iter *iter, K *key_ptr,		\
+				  V *value_ptr)				\
+{									\
+	name##Node *node = name##NodeOf(iter->next);			\
+	*key_ptr = node->key;						\
+	*value_ptr = node->value;					\
+	iter->next = intrusiveRBTreeNext(iter->next);			\
+}
+
+#endif